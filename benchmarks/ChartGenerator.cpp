@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2010-2022 by Stephen Allewell
+ * steve.allewell@gmail.com
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+
+/** @file
+ * This file implements the generation of synthetic patterns for the benchmarks.
+ */
+
+
+#include "ChartGenerator.h"
+
+#include <algorithm>
+#include <random>
+
+#include <QDir>
+#include <QImage>
+#include <QSharedPointer>
+#include <QUrl>
+
+#include "BackgroundImage.h"
+#include "configuration.h"
+#include "Document.h"
+#include "DocumentFloss.h"
+#include "Floss.h"
+#include "FlossScheme.h"
+#include "SchemeManager.h"
+#include "Stitch.h"
+#include "SymbolLibrary.h"
+#include "SymbolManager.h"
+
+
+// the fractional stitches placed in a cell, quarters and halves in either direction
+static const Stitch::Type fractionalTypes[] = {
+    Stitch::TLQtr,
+    Stitch::TRQtr,
+    Stitch::BLQtr,
+    Stitch::BRQtr,
+    Stitch::BTHalf,
+    Stitch::TBHalf,
+    Stitch::TL3Qtr,
+    Stitch::BR3Qtr
+};
+
+
+void ChartGenerator::generate(Document *document, const ChartParameters &parameters, const QString &imageDirectory)
+{
+    std::mt19937 random(parameters.width * 31 + parameters.height);
+
+    FlossScheme *scheme = SchemeManager::scheme(document->pattern()->palette().schemeName());
+    QList<qint16> symbolIndexes = SymbolManager::library(Configuration::palette_DefaultSymbolLibrary())->indexes();
+    int colors = std::min({parameters.colors, scheme->flosses().count(), symbolIndexes.count()});
+
+    for (int i = 0 ; i < colors ; ++i) {
+        const Floss *floss = scheme->flosses().at(i);
+        DocumentFloss *documentFloss = new DocumentFloss(floss->name(), symbolIndexes.at(i), Qt::SolidLine, Configuration::palette_StitchStrands(), Configuration::palette_BackstitchStrands());
+        documentFloss->setFlossColor(floss->color());
+        document->pattern()->palette().add(i, documentFloss);
+    }
+
+    StitchData &stitches = document->pattern()->stitches();
+    stitches.resize(parameters.width, parameters.height);
+
+    std::uniform_int_distribution<int> colorDistribution(0, colors - 1);
+    std::uniform_int_distribution<int> runDistribution(1, 24);
+    std::uniform_int_distribution<int> fractionalDistribution(0, sizeof(fractionalTypes) / sizeof(fractionalTypes[0]) - 1);
+    std::uniform_real_distribution<double> densityDistribution(0.0, 1.0);
+
+    for (int y = 0 ; y < parameters.height ; ++y) {
+        for (int x = 0 ; x < parameters.width ;) {
+            int color = colorDistribution(random);
+            int run = std::min(runDistribution(random), parameters.width - x);
+
+            for (int end = x + run ; x < end ; ++x) {
+                if (densityDistribution(random) < parameters.fractionalDensity) {
+                    stitches.addStitch(QPoint(x, y), fractionalTypes[fractionalDistribution(random)], color);
+                    stitches.addStitch(QPoint(x, y), fractionalTypes[fractionalDistribution(random)], colorDistribution(random));
+                } else {
+                    stitches.addStitch(QPoint(x, y), Stitch::Full, color);
+                }
+            }
+        }
+    }
+
+    // backstitches and knots are in snap coordinates, twice the cell coordinates
+    std::uniform_int_distribution<int> snapX(0, parameters.width * 2);
+    std::uniform_int_distribution<int> snapY(0, parameters.height * 2);
+    std::uniform_int_distribution<int> lengthDistribution(-4, 4);
+    int cells = parameters.width * parameters.height;
+
+    for (int i = int(cells * parameters.backstitchDensity) ; i > 0 ; --i) {
+        QPoint start(snapX(random), snapY(random));
+        QPoint end(qBound(0, start.x() + lengthDistribution(random), parameters.width * 2), qBound(0, start.y() + lengthDistribution(random), parameters.height * 2));
+
+        if (start != end) {
+            stitches.addBackstitch(start, end, colorDistribution(random));
+        }
+    }
+
+    for (int i = int(cells * parameters.knotDensity) ; i > 0 ; --i) {
+        stitches.addFrenchKnot(QPoint(snapX(random), snapY(random)), colorDistribution(random));
+    }
+
+    // background images are noise, the worst case for their compression
+    std::uniform_int_distribution<int> byteDistribution(0, 255);
+
+    for (int i = 0 ; i < parameters.backgroundImages ; ++i) {
+        QImage image(parameters.backgroundImageSize, parameters.backgroundImageSize, QImage::Format_RGB32);
+
+        for (int y = 0 ; y < image.height() ; ++y) {
+            QRgb *pixel = reinterpret_cast<QRgb *>(image.scanLine(y));
+
+            for (int x = 0 ; x < image.width() ; ++x) {
+                pixel[x] = qRgb(byteDistribution(random), byteDistribution(random), byteDistribution(random));
+            }
+        }
+
+        QString path = QDir(imageDirectory).filePath(QStringLiteral("background%1.png").arg(i));
+        image.save(path);
+
+        QSharedPointer<BackgroundImage> backgroundImage(new BackgroundImage(QUrl::fromLocalFile(path), QRect(0, 0, parameters.width, parameters.height)));
+        document->backgroundImages().addBackgroundImage(backgroundImage);
+    }
+}
@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2010-2022 by Stephen Allewell
+ * steve.allewell@gmail.com
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+
+/** @file
+ * This file defines the generation of synthetic patterns for the benchmarks.
+ */
+
+
+#ifndef ChartGenerator_H
+#define ChartGenerator_H
+
+
+#include <QString>
+
+
+class Document;
+
+
+/**
+ * The parameters of a generated pattern.
+ */
+struct ChartParameters {
+    int     width;                  /**< the width of the pattern in cells */
+    int     height;                 /**< the height of the pattern in cells */
+    int     colors;                 /**< the number of flosses used */
+    double  fractionalDensity;      /**< the proportion of cells of fractional stitches */
+    double  backstitchDensity;      /**< the number of backstitches per cell */
+    double  knotDensity;            /**< the number of french knots per cell */
+    int     backgroundImages;       /**< the number of background images */
+    int     backgroundImageSize;    /**< the width and height of the background images in pixels */
+};
+
+
+/**
+ * Fills a Document with a pattern resembling a converted image. Colors are
+ * placed in horizontal runs of random length, as found in most charts, so the
+ * results reflect the run length encoding of the file format. The pattern is
+ * generated from a fixed seed so the same parameters always give the same
+ * pattern.
+ */
+class ChartGenerator
+{
+public:
+    /**
+     * Generate a pattern.
+     *
+     * @param document is a pointer to the Document to fill, it should be newly initialised
+     * @param parameters is a const reference to the ChartParameters
+     * @param imageDirectory is the directory the background image files are written to
+     */
+    static void generate(Document *document, const ChartParameters &parameters, const QString &imageDirectory);
+};
+
+
+#endif // ChartGenerator_H
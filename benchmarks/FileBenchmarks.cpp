@@ -0,0 +1,330 @@
+/*
+ * Copyright (C) 2010-2022 by Stephen Allewell
+ * steve.allewell@gmail.com
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+
+/** @file
+ * This file implements the benchmarks of reading and writing patterns.
+ *
+ * The results are reported by QtTest, use -csv or -o file,xml for results that
+ * can be compared between builds. The size of the data read or written and the
+ * peak resident memory of each case are printed as lines of the form
+ * "bytes,<function>,<tag>,<value>" and "peak-rss-kb,<function>,<tag>,<value>"
+ * from which the throughput can be found.
+ *
+ * The PC Stitch cases read the files of the directory named by the
+ * KXSTITCH_BENCHMARK_PCSTITCH environment variable and are skipped if it is
+ * not set, as no PC Stitch files are distributed with KXStitch.
+ */
+
+
+#include <QBuffer>
+#include <QCoreApplication>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QTemporaryDir>
+#include <QTest>
+
+#include "BackgroundImage.h"
+#include "ChartGenerator.h"
+#include "Document.h"
+
+
+Q_DECLARE_METATYPE(ChartParameters)
+
+
+class FileBenchmarks : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void init();
+    void cleanup();
+
+    void readKXStitch_data();
+    void readKXStitch();
+    void write_data();
+    void write();
+    void writeStitchData_data();
+    void writeStitchData();
+    void readStitchData_data();
+    void readStitchData();
+    void readPCStitch_data();
+    void readPCStitch();
+
+private:
+    void addCharts();
+    QByteArray generate(const ChartParameters &);
+    void report(const char *, qint64);
+
+    QTemporaryDir   m_directory;
+};
+
+
+// the peak resident memory is reset before each case where the kernel allows it
+static void resetPeakMemory()
+{
+    QFile file(QStringLiteral("/proc/self/clear_refs"));
+
+    if (file.open(QIODevice::WriteOnly)) {
+        file.write("5");
+    }
+}
+
+
+// the peak resident memory in kB, -1 if it is not available
+static qint64 peakMemory()
+{
+    QFile file(QStringLiteral("/proc/self/status"));
+
+    if (file.open(QIODevice::ReadOnly)) {
+        for (QByteArray line = file.readLine() ; !line.isEmpty() ; line = file.readLine()) {
+            if (line.startsWith("VmHWM:")) {
+                return line.mid(6).trimmed().split(' ').first().toLongLong();
+            }
+        }
+    }
+
+    return -1;
+}
+
+
+// wait for the stitches and background images decoded in the background after reading
+static void finishLoading(Document &document)
+{
+    document.pattern()->stitches().load();
+
+    auto backgroundImages = document.backgroundImages().backgroundImages();
+
+    while (backgroundImages.hasNext()) {
+        backgroundImages.next()->decoding().waitForFinished();
+    }
+}
+
+
+void FileBenchmarks::initTestCase()
+{
+    // the configuration and the floss schemes are found from the application name
+    QCoreApplication::setApplicationName(QStringLiteral("kxstitch"));
+    QVERIFY(m_directory.isValid());
+}
+
+
+void FileBenchmarks::init()
+{
+    resetPeakMemory();
+}
+
+
+void FileBenchmarks::cleanup()
+{
+    report("peak-rss-kb", peakMemory());
+}
+
+
+void FileBenchmarks::addCharts()
+{
+    QTest::addColumn<ChartParameters>("parameters");
+
+    // width, height, colors, fractional density, backstitch density, knot density, background images, background image size
+    QTest::newRow("small") << ChartParameters{100, 100, 20, 0.05, 0.05, 0.01, 0, 0};
+    QTest::newRow("medium") << ChartParameters{500, 500, 60, 0.1, 0.05, 0.01, 1, 1000};
+    QTest::newRow("large") << ChartParameters{2000, 2000, 120, 0.1, 0.05, 0.01, 2, 4000};
+    QTest::newRow("fractional") << ChartParameters{500, 500, 60, 1.0, 0.0, 0.0, 0, 0};
+    QTest::newRow("backstitched") << ChartParameters{500, 500, 60, 0.0, 2.0, 0.5, 0, 0};
+}
+
+
+// generate a pattern and return the file written for it
+QByteArray FileBenchmarks::generate(const ChartParameters &parameters)
+{
+    Document document;
+    ChartGenerator::generate(&document, parameters, m_directory.path());
+
+    QByteArray data;
+    QBuffer buffer(&data);
+    buffer.open(QIODevice::WriteOnly);
+    QDataStream stream(&buffer);
+    document.write(stream);
+
+    return data;
+}
+
+
+void FileBenchmarks::report(const char *measure, qint64 value)
+{
+    qInfo("%s,%s,%s,%lld", measure, QTest::currentTestFunction(), QTest::currentDataTag() ? QTest::currentDataTag() : "", value);
+}
+
+
+void FileBenchmarks::readKXStitch_data()
+{
+    addCharts();
+}
+
+
+void FileBenchmarks::readKXStitch()
+{
+    QFETCH(ChartParameters, parameters);
+
+    // read from a file so the cost of the device is included
+    QString path = QDir(m_directory.path()).filePath(QStringLiteral("pattern.kxs"));
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write(generate(parameters));
+    file.close();
+    report("bytes", file.size());
+
+    Document document;
+
+    QBENCHMARK {
+        QVERIFY(file.open(QIODevice::ReadOnly));
+        QDataStream stream(&file);
+        document.readKXStitch(stream);
+        finishLoading(document);
+        file.close();
+    }
+}
+
+
+void FileBenchmarks::write_data()
+{
+    addCharts();
+}
+
+
+void FileBenchmarks::write()
+{
+    QFETCH(ChartParameters, parameters);
+
+    Document document;
+    ChartGenerator::generate(&document, parameters, m_directory.path());
+    QByteArray data;
+
+    QBENCHMARK {
+        data.clear();
+        QBuffer buffer(&data);
+        buffer.open(QIODevice::WriteOnly);
+        QDataStream stream(&buffer);
+        document.write(stream);
+    }
+
+    report("bytes", data.size());
+}
+
+
+void FileBenchmarks::writeStitchData_data()
+{
+    addCharts();
+}
+
+
+void FileBenchmarks::writeStitchData()
+{
+    QFETCH(ChartParameters, parameters);
+
+    Document document;
+    ChartGenerator::generate(&document, parameters, m_directory.path());
+    QByteArray data;
+
+    QBENCHMARK {
+        data.clear();
+        QBuffer buffer(&data);
+        buffer.open(QIODevice::WriteOnly);
+        QDataStream stream(&buffer);
+        stream << document.pattern()->stitches();
+    }
+
+    report("bytes", data.size());
+}
+
+
+void FileBenchmarks::readStitchData_data()
+{
+    addCharts();
+}
+
+
+void FileBenchmarks::readStitchData()
+{
+    QFETCH(ChartParameters, parameters);
+
+    QByteArray data;
+
+    {
+        Document document;
+        ChartGenerator::generate(&document, parameters, m_directory.path());
+        QBuffer buffer(&data);
+        buffer.open(QIODevice::WriteOnly);
+        QDataStream stream(&buffer);
+        stream << document.pattern()->stitches();
+    }
+
+    report("bytes", data.size());
+
+    StitchData stitchData;
+
+    QBENCHMARK {
+        QBuffer buffer(&data);
+        buffer.open(QIODevice::ReadOnly);
+        QDataStream stream(&buffer);
+        stream >> stitchData;
+        stitchData.load();
+    }
+}
+
+
+void FileBenchmarks::readPCStitch_data()
+{
+    QTest::addColumn<QString>("path");
+
+    QString corpus = qEnvironmentVariable("KXSTITCH_BENCHMARK_PCSTITCH");
+
+    if (corpus.isEmpty()) {
+        return;
+    }
+
+    QDir directory(corpus);
+    const QStringList files = directory.entryList(QStringList(QStringLiteral("*.pat")), QDir::Files, QDir::Name);
+
+    for (const QString &file : files) {
+        QTest::newRow(file.toUtf8().constData()) << directory.filePath(file);
+    }
+}
+
+
+void FileBenchmarks::readPCStitch()
+{
+    if (qEnvironmentVariableIsEmpty("KXSTITCH_BENCHMARK_PCSTITCH")) {
+        QSKIP("Set KXSTITCH_BENCHMARK_PCSTITCH to a directory of PC Stitch files");
+    }
+
+    QFETCH(QString, path);
+
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    report("bytes", file.size());
+    file.close();
+
+    Document document;
+
+    QBENCHMARK {
+        QVERIFY(file.open(QIODevice::ReadOnly));
+        QDataStream stream(&file);
+        document.readPCStitch(stream);
+        finishLoading(document);
+        file.close();
+    }
+}
+
+QTEST_MAIN(FileBenchmarks)
+
+#include "FileBenchmarks.moc"
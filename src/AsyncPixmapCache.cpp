@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2010-2022 by Stephen Allewell
+ * steve.allewell@gmail.com
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+
+/** @file
+ * This file implements a cache of pixmaps generated on the global thread pool.
+ */
+
+
+#include "AsyncPixmapCache.h"
+
+#include <QtConcurrent>
+
+
+AsyncPixmapCache::AsyncPixmapCache(int maximumCost, QObject *parent)
+    :   QObject(parent),
+        m_pixmaps(maximumCost)
+{
+}
+
+
+QPixmap AsyncPixmapCache::pixmap(const QString &key, const std::function<QImage()> &generate)
+{
+    if (QPixmap *pixmap = m_pixmaps.object(key)) {
+        return *pixmap;
+    }
+
+    if (!m_pending.contains(key)) {
+        QFutureWatcher<QImage> *watcher = new QFutureWatcher<QImage>(this);
+        m_pending.insert(key, watcher);
+
+        connect(watcher, &QFutureWatcher<QImage>::finished, this, [this, watcher, key]() {
+            // pixmaps can only be created on the user interface thread
+            QImage image = watcher->result();
+            m_pixmaps.insert(key, new QPixmap(QPixmap::fromImage(image)), image.sizeInBytes() / 1024 + 1);
+            m_pending.remove(key);
+            watcher->deleteLater();
+            emit pixmapReady();
+        });
+
+        watcher->setFuture(QtConcurrent::run(generate));
+    }
+
+    return QPixmap();
+}
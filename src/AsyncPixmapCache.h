@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2010-2022 by Stephen Allewell
+ * steve.allewell@gmail.com
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+
+/** @file
+ * This file defines a cache of pixmaps generated on the global thread pool.
+ */
+
+
+#ifndef AsyncPixmapCache_H
+#define AsyncPixmapCache_H
+
+
+#include <functional>
+
+#include <QCache>
+#include <QFutureWatcher>
+#include <QHash>
+#include <QImage>
+#include <QObject>
+#include <QPixmap>
+#include <QString>
+
+
+/**
+ * Holds the most recently used pixmaps in memory, generating those that are
+ * not as QImages on the global thread pool so the user interface thread is
+ * never delayed by them.
+ *
+ * A pixmap is requested with its key and the function generating its image.
+ * If it is not in memory a null QPixmap is returned, the function is run in
+ * the background unless it is already running for that key, and pixmapReady()
+ * is emitted when the pixmap is available. A null image is kept as well, so a
+ * pixmap that can not be generated is not tried again.
+ */
+class AsyncPixmapCache : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * Constructor.
+     *
+     * @param maximumCost is the size of the pixmaps kept in memory in kB
+     * @param parent is a pointer to the parent QObject
+     */
+    explicit AsyncPixmapCache(int maximumCost, QObject *parent = nullptr);
+
+    /**
+     * Destructor, pixmaps still being generated are discarded.
+     */
+    virtual ~AsyncPixmapCache() = default;
+
+    /**
+     * Get a pixmap. If it is not in memory, it is generated in the background
+     * and a null QPixmap is returned.
+     *
+     * @param key is a const reference to the QString identifying the pixmap
+     * @param generate is the function generating the image of the pixmap, this
+     * is run on a worker thread so it should only use values it has captured
+     *
+     * @return a QPixmap
+     */
+    QPixmap pixmap(const QString &key, const std::function<QImage()> &generate);
+
+signals:
+    /**
+     * Emitted when a pixmap generated in the background is available.
+     */
+    void pixmapReady();
+
+private:
+    QCache<QString, QPixmap>                    m_pixmaps;
+    QHash<QString, QFutureWatcher<QImage> *>    m_pending;
+};
+
+
+#endif // AsyncPixmapCache_H
@@ -19,7 +19,11 @@
 #include "BackgroundImage.h"
 
 // Qt includes
+#include <QBuffer>
 #include <QDataStream>
+#include <QFile>
+#include <QImageReader>
+#include <QtConcurrent>
 
 // KF5 includes
 #include <KLocalizedString>
@@ -33,10 +37,14 @@ BackgroundImage::BackgroundImage(const QUrl &url, const QRect &location)
         m_location(location),
         m_visible(true)
 {
-    m_status = m_image.load(m_url.path());
+    QFile file(m_url.path());
+    m_status = file.open(QIODevice::ReadOnly);
 
     if (m_status) {
-        generateIcon();
+        m_data = file.readAll();
+        QImage icon = decode(m_data, iconSize);
+        m_icon = icon.isNull() ? QIcon() : QIcon(QPixmap::fromImage(icon));
+        m_status = !m_icon.isNull();
     }
 }
 
@@ -67,16 +75,44 @@ bool BackgroundImage::isValid() const
 
 const QImage &BackgroundImage::image() const
 {
+    if (m_image.isNull()) {
+        if (!m_decoding.isFinished()) {
+            // still being decoded in the background, painted when it finishes
+            return m_image;
+        }
+
+        m_image = (m_decoding.resultCount()) ? m_decoding.result() : decode(m_data, displaySize);
+        m_decoding = QFuture<QImage>();
+    }
+
     return m_image;
 }
 
 
 const QIcon &BackgroundImage::icon() const
 {
+    if (m_icon.isNull() && isDecoded()) {
+        // hidden images are not kept decoded, so only decode them at the icon size
+        QImage icon = (m_visible) ? image().scaled(iconSize, iconSize, Qt::KeepAspectRatio, Qt::SmoothTransformation) : decode(m_data, iconSize);
+        m_icon = icon.isNull() ? QIcon() : QIcon(QPixmap::fromImage(icon));
+    }
+
     return m_icon;
 }
 
 
+bool BackgroundImage::isDecoded() const
+{
+    return m_decoding.isFinished();
+}
+
+
+QFuture<QImage> BackgroundImage::decoding() const
+{
+    return m_decoding;
+}
+
+
 void BackgroundImage::setLocation(const QRect &location)
 {
     m_location = location;
@@ -86,12 +122,73 @@ void BackgroundImage::setLocation(const QRect &location)
 void BackgroundImage::setVisible(bool visible)
 {
     m_visible = visible;
+
+    if (!m_visible) {
+        m_image = QImage();
+    }
+}
+
+
+BackgroundImage BackgroundImage::snapshot() const
+{
+    BackgroundImage backgroundImage;
+
+    backgroundImage.m_url = m_url;
+    backgroundImage.m_location = m_location;
+    backgroundImage.m_visible = m_visible;
+    backgroundImage.m_status = m_status;
+    backgroundImage.m_data = m_data;
+
+    return backgroundImage;
 }
 
 
-void BackgroundImage::generateIcon()
+void BackgroundImage::startDecoding()
 {
-    m_icon = QPixmap::fromImage(m_image).scaled(64, 64, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+    m_image = QImage();
+    m_icon = QIcon();
+
+    if (m_visible) {
+        m_decoding = QtConcurrent::run(&BackgroundImage::decode, m_data, int(displaySize));
+    }
+}
+
+
+QImage BackgroundImage::decode(const QByteArray &data, int size)
+{
+    QBuffer buffer;
+    buffer.setData(data);
+    buffer.open(QIODevice::ReadOnly);
+
+    QImageReader reader(&buffer);
+    QSize imageSize = reader.size();
+    QImage image;
+
+    // decoders supporting scaled reading avoid holding the full resolution image
+    if (imageSize.isValid() && ((imageSize.width() > size) || (imageSize.height() > size)) && reader.supportsOption(QImageIOHandler::ScaledSize)) {
+        reader.setScaledSize(imageSize.scaled(size, size, Qt::KeepAspectRatio));
+        image = reader.read();
+    } else {
+        image = reader.read();
+
+        if ((image.width() > size) || (image.height() > size)) {
+            image = image.scaled(size, size, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+        }
+    }
+
+    return image;
+}
+
+
+void BackgroundImage::setImage(const QImage &image)
+{
+    m_data.clear();
+
+    QBuffer buffer(&m_data);
+    buffer.open(QIODevice::WriteOnly);
+    image.save(&buffer, "PNG");
+
+    m_image = QImage();
 }
 
 
@@ -102,7 +199,7 @@ QDataStream &operator<<(QDataStream &stream, const BackgroundImage &backgroundIm
     stream << backgroundImage.m_location;
     stream << backgroundImage.m_visible;
     stream << backgroundImage.m_status;
-    stream << backgroundImage.m_image;
+    stream << backgroundImage.m_data;
     return stream;
 }
 
@@ -110,17 +207,27 @@ QDataStream &operator<<(QDataStream &stream, const BackgroundImage &backgroundIm
 QDataStream &operator>>(QDataStream &stream, BackgroundImage &backgroundImage)
 {
     qint32 version;
+    QImage image;
 
     stream >> version;
 
     switch (version) {
+    case 102:
+        stream >> backgroundImage.m_url;
+        stream >> backgroundImage.m_location;
+        stream >> backgroundImage.m_visible;
+        stream >> backgroundImage.m_status;
+        stream >> backgroundImage.m_data;
+        backgroundImage.startDecoding();
+        break;
+
     case 101:
         stream >> backgroundImage.m_url;
         stream >> backgroundImage.m_location;
         stream >> backgroundImage.m_visible;
         stream >> backgroundImage.m_status;
-        stream >> backgroundImage.m_image;
-        backgroundImage.generateIcon();
+        stream >> image;
+        backgroundImage.setImage(image);
         break;
 
     case 100:
@@ -128,8 +235,9 @@ QDataStream &operator>>(QDataStream &stream, BackgroundImage &backgroundImage)
         stream >> backgroundImage.m_location;
         stream >> backgroundImage.m_visible;
         stream >> backgroundImage.m_status;
-        stream >> backgroundImage.m_image;
+        stream >> image;
         stream >> backgroundImage.m_icon;
+        backgroundImage.setImage(image);
         break;
 
     default:
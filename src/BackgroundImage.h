@@ -20,6 +20,8 @@
 
 
 // Qt includes
+#include <QByteArray>
+#include <QFuture>
 #include <QIcon>
 #include <QImage>
 #include <QRect>
@@ -35,6 +37,14 @@ class QDataStream;
  * canvas, its visibility state and its original source url.  It also stores an
  * icon for display in the menus and a Qimage which is scaled to fit the canvas
  * zoom factor.
+ *
+ * The encoded data of the source file is kept and streamed unchanged, the QImage
+ * is only decoded when it is first needed for painting and is limited to a
+ * display resolution. It is released again when the image is hidden.
+ *
+ * Images read from a file are decoded on the global thread pool so opening a
+ * document is not delayed by large images, until decoding has finished image()
+ * returns a null image and icon() a null icon.
  */
 class BackgroundImage
 {
@@ -86,9 +96,11 @@ public:
 
     /**
      * Get the QImage of the background image. This will be used to paint onto
-     * the canvas.
+     * the canvas. The image is decoded from the file data the first time it is
+     * requested, reduced to no more than displaySize in either direction.
      *
-     * @return a const reference to a QImage representing the image
+     * @return a const reference to a QImage representing the image, a null image
+     * while it is being decoded in the background
      */
     const QImage &image() const;
 
@@ -96,10 +108,26 @@ public:
      * Get the QIcon of the background image. This is used in the menus to show
      * which image any action would apply to.
      *
-     * @return a const reference to a QIcon representing the image
+     * @return a const reference to a QIcon representing the image, a null icon
+     * while it is being decoded in the background
      */
     const QIcon &icon() const;
 
+    /**
+     * Get the decoded status of the background image.
+     *
+     * @return @c true if the image is not being decoded in the background, @c false otherwise
+     */
+    bool isDecoded() const;
+
+    /**
+     * Get the background decoding of the image, this can be monitored with a
+     * QFutureWatcher to update the canvas and menus when it finishes.
+     *
+     * @return a QFuture for the decoded image
+     */
+    QFuture<QImage> decoding() const;
+
     /**
      * Set the target area of the canvas that the background image should occupy.
      *
@@ -109,11 +137,21 @@ public:
 
     /**
      * Set the visibility status of the background image to show or hide it.
+     * Hiding the image releases the decoded QImage.
      *
      * @param visible @c true to show the image, @c false to hide it
      */
     void setVisible(bool visible);
 
+    /**
+     * Get a copy of the background image for writing to a file on a worker thread.
+     * The copy shares the encoded data but not the decoded image or the icon, which
+     * can only be released on the user interface thread.
+     *
+     * @return a BackgroundImage with the url, location, visibility and data of this one
+     */
+    BackgroundImage snapshot() const;
+
     /**
      * Operator to stream out the class instance to a QDataStream.
      *
@@ -137,19 +175,45 @@ public:
 
 private:
     /**
-     * Generate the QIcon from the image data. Used after reading from a file.
+     * Start decoding the image data in the background if the image is visible.
+     * Used after reading from a file.
+     */
+    void startDecoding();
+
+    /**
+     * Decode image data, reducing it to fit within a square of the given size.
+     * This may be called on a worker thread.
+     *
+     * @param data is a const reference to the encoded image data
+     * @param size is the largest width or height of the decoded image
+     *
+     * @return a QImage of the decoded data, a null image if it can't be decoded
+     */
+    static QImage decode(const QByteArray &data, int size);
+
+    /**
+     * Set the image data from a QImage, used for versions of the file that stored
+     * the decoded image. The image is encoded as PNG.
+     *
+     * @param image is a const reference to the QImage
      */
-    void generateIcon();
+    void setImage(const QImage &image);
 
-    static const int version = 101; /**< The version of the streamed object */
+    static const int version = 102; /**< The version of the streamed object */
     // no longer store m_icon, generate it on loading
+    // store the encoded file data rather than the decoded image
+
+    static const int displaySize = 2048;    /**< The largest width or height of the decoded image */
+    static const int iconSize = 64;         /**< The largest width or height of the icon */
 
     QUrl    m_url;      /**< The URL of the source file */
     QRect   m_location; /**< The area of the canvas occupied by the image */
     bool    m_visible;  /**< The visibility state, @c true if visible, @c false otherwise */
     bool    m_status;   /**< The validity state of the class instance, @c true if valid, @c false otherwise */
-    QImage  m_image;    /**< The image read from the URL */
-    QIcon   m_icon;     /**< An icon of the image */
+    QByteArray      m_data;     /**< The encoded data read from the URL */
+    mutable QImage  m_image;    /**< The image decoded from m_data at display resolution */
+    mutable QFuture<QImage> m_decoding; /**< The background decoding of m_image */
+    mutable QIcon   m_icon;     /**< An icon of the image, generated from m_image */
 };
 
 
@@ -71,12 +71,26 @@ bool BackgroundImages::showBackgroundImage(QSharedPointer<BackgroundImage> backg
 }
 
 
-QDataStream &operator<<(QDataStream &stream, const BackgroundImages &backgroundImages)
+BackgroundImagesSnapshot BackgroundImages::snapshot() const
+{
+    BackgroundImagesSnapshot snapshot;
+
+    snapshot.m_version = version;
+
+    for (auto backgroundImage : m_backgroundImages) {
+        snapshot.m_backgroundImages.append(QSharedPointer<const BackgroundImage>(new BackgroundImage(backgroundImage->snapshot())));
+    }
+
+    return snapshot;
+}
+
+
+QDataStream &operator<<(QDataStream &stream, const BackgroundImagesSnapshot &snapshot)
 {
-    stream << qint32(backgroundImages.version);
-    stream << qint32(backgroundImages.m_backgroundImages.count());
+    stream << snapshot.m_version;
+    stream << qint32(snapshot.m_backgroundImages.count());
 
-    for (auto backgroundImage : backgroundImages.m_backgroundImages) {
+    for (auto backgroundImage : snapshot.m_backgroundImages) {
         stream << *backgroundImage;
     }
 
@@ -88,6 +102,12 @@ QDataStream &operator<<(QDataStream &stream, const BackgroundImages &backgroundI
 }
 
 
+QDataStream &operator<<(QDataStream &stream, const BackgroundImages &backgroundImages)
+{
+    return stream << backgroundImages.snapshot();
+}
+
+
 QDataStream &operator>>(QDataStream &stream, BackgroundImages &backgroundImages)
 {
     qint32 version;
@@ -32,6 +32,33 @@ class QDataStream;
 class BackgroundImage;
 
 
+/**
+ * This class holds copies of the background images of a document taken when it
+ * is saved, so they can be written on a worker thread while the images are
+ * changed. The copies share the encoded data of the images.
+ */
+class BackgroundImagesSnapshot
+{
+public:
+    /**
+     * Operator to stream out the class instance to a QDataStream in the same way
+     * as the BackgroundImages it was taken from.
+     *
+     * @param stream a reference to the QDataStream to write to
+     * @param snapshot a const reference to the class instance to write
+     *
+     * @return a reference to the QDataStream allowing chaining
+     */
+    friend QDataStream &operator<<(QDataStream &stream, const BackgroundImagesSnapshot &snapshot);
+
+private:
+    friend class BackgroundImages;
+
+    qint32  m_version;  /**< The version of the BackgroundImages streamed object */
+    QList<QSharedPointer<const BackgroundImage>> m_backgroundImages;  /**< The copies of the background images */
+};
+
+
 /**
  * This class defines a collection of background images allowing the addition
  * and removal of background images, setting the area occupied by an image and
@@ -102,6 +129,13 @@ public:
      */
     bool showBackgroundImage(QSharedPointer<BackgroundImage> backgroundImage, bool show);
 
+    /**
+     * Get a snapshot of the background images for writing on a worker thread.
+     *
+     * @return a BackgroundImagesSnapshot of the images in the list
+     */
+    BackgroundImagesSnapshot snapshot() const;
+
     /**
      * Operator to stream out the class instance to a QDataStream. This will
      * stream the instance of the BackgroundImage contained in the list.
@@ -133,6 +167,7 @@ private:
 };
 
 
+QDataStream &operator<<(QDataStream &, const BackgroundImagesSnapshot &);
 QDataStream &operator<<(QDataStream &, const BackgroundImages &);
 QDataStream &operator>>(QDataStream &, BackgroundImages &);
 
@@ -0,0 +1,340 @@
+/*
+ * Copyright (C) 2010-2022 by Stephen Allewell
+ * steve.allewell@gmail.com
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+
+/** @file
+ * This file implements the conversion of files from the command line without
+ * opening any windows.
+ */
+
+
+#include "BatchConverter.h"
+
+#include <algorithm>
+
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QPainter>
+#include <QPdfWriter>
+#include <QSaveFile>
+#include <QTextStream>
+#include <QtConcurrent>
+
+#include <KLocalizedString>
+
+#include "BackgroundImage.h"
+#include "ChartExporter.h"
+#include "configuration.h"
+#include "Document.h"
+#include "DocumentFloss.h"
+#include "Exceptions.h"
+#include "FlossScheme.h"
+#include "ImageConverter.h"
+#include "Page.h"
+#include "PaperSizes.h"
+#include "SchemeManager.h"
+#include "SymbolLibrary.h"
+#include "SymbolManager.h"
+
+
+/**
+ * Function object used by QtConcurrent::mapped to convert a file, QtConcurrent
+ * requires the result_type to be defined.
+ */
+class FileConverter
+{
+public:
+    typedef QString result_type;
+
+    explicit FileConverter(const BatchConverter *converter)
+        :   m_converter(converter)
+    {
+    }
+
+    QString operator()(const QString &source) const
+    {
+        return m_converter->convert(source);
+    }
+
+private:
+    const BatchConverter    *m_converter;
+};
+
+
+BatchConverter::BatchConverter(Format format, const QString &outputDirectory)
+    :   m_format(format),
+        m_outputDirectory(outputDirectory),
+        m_resolution(300)
+{
+}
+
+
+void BatchConverter::setResolution(int resolution)
+{
+    m_resolution = resolution;
+}
+
+
+int BatchConverter::run(const QStringList &files) const
+{
+    // the schemes and symbol libraries can be read on the worker threads when first used,
+    // the defaults are read now so their errors are reported once, before any file is converted
+    QString scheme = Configuration::palette_DefaultScheme();
+
+    if (SchemeManager::scheme(scheme) == nullptr) {
+        scheme = SchemeManager::schemes().at(scheme.toInt());
+    }
+
+    SchemeManager::scheme(scheme)->createImageMap();
+    SymbolManager::library(Configuration::palette_DefaultSymbolLibrary());
+
+    QTextStream errorStream(stderr);
+    QFuture<QString> future = QtConcurrent::mapped(files, FileConverter(this));
+    int failed = 0;
+
+    for (int i = 0 ; i < files.count() ; ++i) {
+        QString error = future.resultAt(i);
+
+        if (error.isEmpty()) {
+            errorStream << files.at(i) << " -> " << target(files.at(i)) << '\n';
+        } else {
+            errorStream << files.at(i) << ": " << error << '\n';
+            ++failed;
+        }
+
+        // each file is reported as soon as it has been converted
+        errorStream.flush();
+    }
+
+    return (failed) ? 1 : 0;
+}
+
+
+QString BatchConverter::convert(const QString &source) const
+{
+    Document document;
+
+    try {
+        read(document, source);
+    } catch (const InvalidFileVersion &e) {
+        return QString(i18n("This version of the file is not supported.\n%1", e.version));
+    } catch (const FailedReadFile &e) {
+        return QString(i18n("Failed to read the file.\n%1.", e.status));
+    } catch (const Magick::Exception &e) {
+        return QString(i18n("The file does not appear to be a recognized cross stitch file or image.\n%1", QString::fromLocal8Bit(e.what())));
+    }
+
+    // the stitches are decoded as the file is read, a chunk that could not be decoded fails the file
+    // rather than writing a pattern with empty rows
+    if (document.pattern()->stitches().takeLoadFailure()) {
+        return QString(i18n("Failed to read the file.\n%1.", i18n("Failed reading stitch data")));
+    }
+
+    switch (m_format) {
+    case Chart:
+        return writeChart(document, target(source));
+
+    case PNGImage:
+    case SVGImage:
+        return ChartExporter(&document, m_resolution).write(target(source));
+
+    default:
+        return writePattern(document, target(source));
+    }
+}
+
+
+QString BatchConverter::target(const QString &source) const
+{
+    QFileInfo sourceInfo(source);
+    QDir directory = (m_outputDirectory.isEmpty()) ? sourceInfo.dir() : QDir(m_outputDirectory);
+
+    QString extension;
+
+    switch (m_format) {
+    case Chart:
+        extension = QStringLiteral(".pdf");
+        break;
+
+    case PNGImage:
+        extension = QStringLiteral(".png");
+        break;
+
+    case SVGImage:
+        extension = QStringLiteral(".svg");
+        break;
+
+    default:
+        extension = QStringLiteral(".kxs");
+        break;
+    }
+
+    return directory.filePath(sourceInfo.completeBaseName() + extension);
+}
+
+
+// read a pattern in the same way as MainWindow::fileOpen, any other file is imported as an image
+void BatchConverter::read(Document &document, const QString &source) const
+{
+    QFile file(source);
+
+    if (!file.open(QIODevice::ReadOnly)) {
+        throw FailedReadFile(file.errorString());
+    }
+
+    QDataStream stream(&file);
+
+    try {
+        document.readKXStitch(stream);
+    } catch (const InvalidFile &e) {
+        stream.device()->seek(0);
+
+        try {
+            document.readPCStitch(stream);
+        } catch (const InvalidFile &e) {
+            file.close();
+            document.initialiseNew();
+            importImage(document, source);
+        }
+    }
+}
+
+
+// import an image with the defaults the import image dialog starts with, the image
+// is scaled to fit the default size of a new document
+void BatchConverter::importImage(Document &document, const QString &source) const
+{
+    QSize sourceSize;
+    Magick::Image image = ImageConverter::load(source, Configuration::import_MaximumImageSize(), sourceSize);
+
+    bool useFractionals = Configuration::import_UseFractionals();
+    QSize documentSize = sourceSize.scaled(document.pattern()->stitches().width(), document.pattern()->stitches().height(), Qt::KeepAspectRatio);
+    QSize imageSize = (useFractionals) ? documentSize * 2 : documentSize;
+
+    if (documentSize.isEmpty()) {
+        throw FailedReadFile(QString(i18n("The image is empty")));
+    }
+
+    Magick::Geometry geometry(imageSize.width(), imageSize.height());
+    geometry.percent(false);
+    geometry.aspect(true);      // set to true to ignore maintaining the aspect ratio
+    image.sample(geometry);
+
+    FlossScheme *flossScheme = SchemeManager::scheme(document.pattern()->palette().schemeName());
+    int colors = SymbolManager::library(Configuration::palette_DefaultSymbolLibrary())->indexes().count();
+
+    if (Configuration::import_UseMaximumColors()) {
+        colors = std::min(colors, Configuration::import_MaximumColors());
+    }
+
+    image = ImageConverter::mapColors(image, *(flossScheme->createImageMap()), colors, Configuration::import_Dithering());
+
+    // the files are already converted in parallel, so the rows are converted on this thread
+    QImage pixels = ImageConverter::pixels(image, false, Magick::ColorRGB());
+    QList<ImageConverter::Runs> runs;
+
+    for (int row = 0 ; row < pixels.height() ; ++row) {
+        runs.append(ImageConverter::convertRow(pixels, row));
+    }
+
+    QList<DocumentFloss *> flosses;
+    QVector<QPoint> cells;
+    QVector<StitchQueue *> queues;
+
+    ImageConverter::createStitches(runs, pixels.width(), useFractionals, flossScheme, flosses, cells, queues);
+
+    document.pattern()->stitches().resize(documentSize.width(), documentSize.height());
+
+    for (int flossIndex = 0 ; flossIndex < flosses.count() ; ++flossIndex) {
+        document.pattern()->palette().add(flossIndex, flosses.at(flossIndex));
+    }
+
+    for (int i = 0 ; i < cells.count() ; ++i) {
+        document.pattern()->stitches().replaceStitchQueueAt(cells.at(i), queues.at(i));
+    }
+}
+
+
+QString BatchConverter::writePattern(Document &document, const QString &fileName) const
+{
+    QSaveFile file(fileName);
+
+    if (!file.open(QIODevice::WriteOnly)) {
+        return QString(i18n("Failed to open the file.\n%1", file.errorString()));
+    }
+
+    QDataStream stream(&file);
+
+    try {
+        document.write(stream);
+
+        if (!file.commit()) {
+            throw FailedWriteFile(stream.status());
+        }
+    } catch (const FailedWriteFile &e) {
+        file.cancelWriting();
+        return QString(i18n("Failed to save the file.\n%1", file.errorString()));
+    }
+
+    return QString();
+}
+
+
+// print the pages in the same way as MainWindow::printPages
+QString BatchConverter::writeChart(Document &document, const QString &fileName) const
+{
+    QList<Page *> pages = document.printerConfiguration().pages();
+
+    if (pages.isEmpty()) {
+        return QString(i18n("There is nothing to print"));
+    }
+
+    // background images read from the file are decoded on the thread pool
+    auto backgroundImages = document.backgroundImages().backgroundImages();
+
+    while (backgroundImages.hasNext()) {
+        backgroundImages.next()->decoding().waitForFinished();
+    }
+
+    QPdfWriter writer(fileName);
+    writer.setTitle(document.property(QStringLiteral("title")).toString());
+    writer.setPageSize(pages.first()->pageSize());
+    writer.setPageOrientation(pages.first()->orientation());
+
+    QPainter painter;
+
+    if (!painter.begin(&writer)) {
+        return QString(i18n("Failed to open the file.\n%1", fileName));
+    }
+
+    painter.setRenderHint(QPainter::Antialiasing, true);
+
+    for (int p = 0 ; p < pages.count() ;) {
+        const Page *page = pages.at(p);
+        int paperWidth = PageSizes::width(page->pageSize().id(), page->orientation());
+        int paperHeight = PageSizes::height(page->pageSize().id(), page->orientation());
+
+        painter.setWindow(0, 0, paperWidth, paperHeight);
+
+        page->render(&document, &painter);
+
+        if (++p < pages.count()) {
+            writer.setPageSize(pages.at(p)->pageSize());
+            writer.setPageOrientation(pages.at(p)->orientation());
+            writer.newPage();
+        }
+    }
+
+    painter.end();
+
+    return QString();
+}
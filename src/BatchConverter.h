@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2010-2022 by Stephen Allewell
+ * steve.allewell@gmail.com
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+
+/** @file
+ * This file defines the conversion of files from the command line without
+ * opening any windows.
+ */
+
+
+#ifndef BatchConverter_H
+#define BatchConverter_H
+
+
+#include <QString>
+#include <QStringList>
+
+
+class Document;
+
+
+/**
+ * Converts cross stitch patterns and images into KXStitch patterns, PDF charts
+ * or PNG and SVG chart images so large numbers of files can be processed
+ * unattended, usually with the offscreen platform plugin as no display is
+ * required.
+ *
+ * Each file is read into its own Document and converted on the global thread
+ * pool, so as many files are converted at the same time as there are threads in
+ * the pool. Files are read as KXStitch or PC Stitch patterns, any other file is
+ * imported as an image using the import settings of the configuration in place
+ * of the choices made in the import image dialog. Charts are printed using the
+ * printer configuration stored in the pattern, chart images are exported by a
+ * ChartExporter using the default render modes of the configuration.
+ */
+class BatchConverter
+{
+public:
+    enum Format {
+        Pattern,    /**< a KXStitch pattern */
+        Chart,      /**< a PDF of the printer configuration */
+        PNGImage,   /**< a PNG image of the chart */
+        SVGImage    /**< an SVG image of the chart */
+    };
+
+    /**
+     * Constructor.
+     *
+     * @param format is the Format of the converted files
+     * @param outputDirectory is the directory the converted files are written to,
+     * if empty they are written to the directory of each source file
+     */
+    BatchConverter(Format format, const QString &outputDirectory);
+
+    /**
+     * Set the resolution of exported chart images.
+     *
+     * @param resolution is the resolution in dots per inch
+     */
+    void setResolution(int resolution);
+
+    /**
+     * Convert a list of files, reporting the result of each file on the standard
+     * error in the order of the list. This blocks until all the files have been
+     * converted.
+     *
+     * @param files is a QStringList of the paths of the files to convert
+     *
+     * @return @c 0 if all the files were converted, @c 1 otherwise
+     */
+    int run(const QStringList &files) const;
+
+    /**
+     * Convert a single file, this may be called on a worker thread.
+     *
+     * @param source is the path of the file to convert
+     *
+     * @return an error message, an empty QString if the file was converted
+     */
+    QString convert(const QString &source) const;
+
+    /**
+     * Get the path of the converted file for a source file.
+     *
+     * @param source is the path of the file to convert
+     *
+     * @return the path of the converted file
+     */
+    QString target(const QString &source) const;
+
+private:
+    void read(Document &, const QString &) const;
+    void importImage(Document &, const QString &) const;
+    QString writePattern(Document &, const QString &) const;
+    QString writeChart(Document &, const QString &) const;
+
+    Format  m_format;
+    QString m_outputDirectory;
+    int     m_resolution;
+};
+
+
+#endif // BatchConverter_H
@@ -211,6 +211,7 @@ void CalibrateFlossDlg::on_DialogButtonBox_accepted()
                 }
             }
 
+            scheme->updateIndexes();
             SchemeManager::writeScheme(mapIterator.key());
         }
     }
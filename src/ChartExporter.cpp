@@ -0,0 +1,343 @@
+/*
+ * Copyright (C) 2010-2022 by Stephen Allewell
+ * steve.allewell@gmail.com
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+
+/** @file
+ * This file implements the export of the chart of a pattern as a PNG or SVG image.
+ */
+
+
+#include "ChartExporter.h"
+
+#include <algorithm>
+
+#include <QByteArray>
+#include <QColor>
+#include <QImage>
+#include <QPainter>
+#include <QSaveFile>
+#include <QSvgGenerator>
+#include <QtEndian>
+
+#include <KLocalizedString>
+
+#include <zlib.h>
+
+#include "configuration.h"
+#include "Document.h"
+#include "Exceptions.h"
+
+
+/**
+ * Write a PNG image a number of rows at a time. The rows are filtered and
+ * compressed as they are written, only the compressed data not yet written
+ * as an IDAT chunk being held in memory.
+ */
+class PngWriter
+{
+public:
+    PngWriter(QIODevice *device, const QSize &size, int resolution)
+        :   m_device(device),
+            m_width(size.width()),
+            m_ok(true)
+    {
+        m_stream.zalloc = Z_NULL;
+        m_stream.zfree = Z_NULL;
+        m_stream.opaque = Z_NULL;
+        m_ok = (deflateInit(&m_stream, Z_DEFAULT_COMPRESSION) == Z_OK);
+
+        m_buffer.resize(chunkSize);
+        m_stream.next_out = reinterpret_cast<Bytef *>(m_buffer.data());
+        m_stream.avail_out = chunkSize;
+
+        write("\x89PNG\r\n\x1a\n", 8);
+
+        QByteArray header;
+        appendInt(header, size.width());
+        appendInt(header, size.height());
+        header.append(char(8));     // bit depth
+        header.append(char(2));     // color type, RGB
+        header.append(char(0));     // compression method
+        header.append(char(0));     // filter method
+        header.append(char(0));     // interlace method
+        writeChunk("IHDR", header);
+
+        QByteArray physical;
+        quint32 pixelsPerMeter = qRound(resolution / 0.0254);
+        appendInt(physical, pixelsPerMeter);
+        appendInt(physical, pixelsPerMeter);
+        physical.append(char(1));   // units are meters
+        writeChunk("pHYs", physical);
+    }
+
+    ~PngWriter()
+    {
+        deflateEnd(&m_stream);
+    }
+
+    bool writeRows(const QImage &image)
+    {
+        QByteArray row(1 + m_width * 3, 0);
+
+        for (int y = 0 ; m_ok && (y < image.height()) ; ++y) {
+            const QRgb *pixel = reinterpret_cast<const QRgb *>(image.constScanLine(y));
+            uchar *data = reinterpret_cast<uchar *>(row.data());
+            *data++ = 1;    // the sub filter, each byte less the corresponding byte of the previous pixel
+            QRgb previous = 0;
+
+            for (int x = 0 ; x < m_width ; ++x) {
+                *data++ = uchar(qRed(pixel[x]) - qRed(previous));
+                *data++ = uchar(qGreen(pixel[x]) - qGreen(previous));
+                *data++ = uchar(qBlue(pixel[x]) - qBlue(previous));
+                previous = pixel[x];
+            }
+
+            m_stream.next_in = reinterpret_cast<Bytef *>(row.data());
+            m_stream.avail_in = row.size();
+            deflateData(Z_NO_FLUSH);
+        }
+
+        return m_ok;
+    }
+
+    bool finish()
+    {
+        m_stream.next_in = Z_NULL;
+        m_stream.avail_in = 0;
+        deflateData(Z_FINISH);
+
+        if (m_ok && (m_stream.avail_out < chunkSize)) {
+            writeChunk("IDAT", QByteArray(m_buffer.constData(), chunkSize - m_stream.avail_out));
+        }
+
+        writeChunk("IEND", QByteArray());
+
+        return m_ok;
+    }
+
+private:
+    static const uInt chunkSize = 256 * 1024;
+
+    void deflateData(int flush)
+    {
+        int result;
+
+        do {
+            result = deflate(&m_stream, flush);
+
+            if (result == Z_STREAM_ERROR) {
+                m_ok = false;
+                return;
+            }
+
+            if (m_stream.avail_out == 0) {
+                writeChunk("IDAT", m_buffer);
+                m_stream.next_out = reinterpret_cast<Bytef *>(m_buffer.data());
+                m_stream.avail_out = chunkSize;
+            }
+        } while (m_ok && (m_stream.avail_in || ((flush == Z_FINISH) && (result != Z_STREAM_END))));
+    }
+
+    void writeChunk(const char *type, const QByteArray &data)
+    {
+        QByteArray length;
+        appendInt(length, data.size());
+        write(length.constData(), 4);
+        write(type, 4);
+        write(data.constData(), data.size());
+
+        uLong crc = crc32(0, reinterpret_cast<const Bytef *>(type), 4);
+        crc = crc32(crc, reinterpret_cast<const Bytef *>(data.constData()), data.size());
+        QByteArray checksum;
+        appendInt(checksum, crc);
+        write(checksum.constData(), 4);
+    }
+
+    void write(const char *data, qint64 size)
+    {
+        if (m_ok && (m_device->write(data, size) != size)) {
+            m_ok = false;
+        }
+    }
+
+    static void appendInt(QByteArray &data, quint32 value)
+    {
+        value = qToBigEndian(value);
+        data.append(reinterpret_cast<const char *>(&value), 4);
+    }
+
+    QIODevice   *m_device;
+    int         m_width;
+    bool        m_ok;
+    z_stream    m_stream;
+    QByteArray  m_buffer;   /**< the compressed data of the next IDAT chunk */
+};
+
+
+// the number of cells per inch for a cloth count property of the document
+static double cellsPerInch(Document *document, const QString &property)
+{
+    double clothCount = document->property(property).toDouble();
+
+    if (static_cast<Configuration::EnumEditor_ClothCountUnits::type>(document->property(QStringLiteral("clothCountUnits")).toInt()) == Configuration::EnumEditor_ClothCountUnits::Centimeters) {
+        clothCount *= 2.54;
+    }
+
+    return clothCount;
+}
+
+
+ChartExporter::ChartExporter(Document *document, int resolution)
+    :   m_document(document),
+        m_resolution(resolution)
+{
+    m_renderer.setCellGrouping(m_document->property(QStringLiteral("cellHorizontalGrouping")).toInt(), m_document->property(QStringLiteral("cellVerticalGrouping")).toInt());
+    m_renderer.setGridLineWidths(Configuration::editor_ThinLineWidth(), Configuration::editor_ThickLineWidth());
+    m_renderer.setGridLineColors(m_document->property(QStringLiteral("thinLineColor")).value<QColor>(), m_document->property(QStringLiteral("thickLineColor")).value<QColor>());
+    m_renderer.setRenderStitchesAs(Configuration::renderer_RenderStitchesAs());
+    m_renderer.setRenderBackstitchesAs(Configuration::renderer_RenderBackstitchesAs());
+    m_renderer.setRenderKnotsAs(Configuration::renderer_RenderKnotsAs());
+
+    m_cellWidth = std::max(1, qRound(m_resolution / cellsPerInch(m_document, QStringLiteral("horizontalClothCount"))));
+    m_cellHeight = std::max(1, qRound(m_resolution / cellsPerInch(m_document, QStringLiteral("verticalClothCount"))));
+}
+
+
+void ChartExporter::setRenderer(const Renderer &renderer)
+{
+    m_renderer = renderer;
+}
+
+
+QSize ChartExporter::imageSize() const
+{
+    return QSize(m_document->pattern()->stitches().width() * m_cellWidth, m_document->pattern()->stitches().height() * m_cellHeight);
+}
+
+
+QString ChartExporter::write(const QString &fileName)
+{
+    if (imageSize().isEmpty()) {
+        return QString(i18n("There is nothing to export"));
+    }
+
+    // this is run on a worker thread, so a chunk that can not be decoded is reported rather than thrown
+    try {
+        m_document->pattern()->stitches().load();
+    } catch (const FailedReadFile &e) {
+        return QString(i18n("Failed to read the file.\n%1.", e.status));
+    }
+
+    if (fileName.endsWith(QLatin1String(".svg"), Qt::CaseInsensitive)) {
+        return writeSvg(fileName);
+    }
+
+    return writePng(fileName);
+}
+
+
+QString ChartExporter::writePng(const QString &fileName)
+{
+    QSaveFile file(fileName);
+
+    if (!file.open(QIODevice::WriteOnly)) {
+        return QString(i18n("Failed to open the file.\n%1", file.errorString()));
+    }
+
+    int width = m_document->pattern()->stitches().width();
+    int height = m_document->pattern()->stitches().height();
+    int rows = stripRows();
+
+    PngWriter writer(&file, imageSize(), m_resolution);
+    QImage strip(imageSize().width(), rows * m_cellHeight, QImage::Format_RGB32);
+    bool ok = true;
+
+    for (int firstRow = 0 ; ok && (firstRow < height) ; firstRow += rows) {
+        QRect cells(0, firstRow, width, std::min(rows, height - firstRow));
+
+        QPainter painter(&strip);
+        painter.setViewport(0, 0, strip.width(), cells.height() * m_cellHeight);
+        renderCells(&painter, cells);
+        painter.end();
+
+        ok = writer.writeRows((cells.height() == rows) ? strip : strip.copy(0, 0, strip.width(), cells.height() * m_cellHeight));
+    }
+
+    if (!ok || !writer.finish() || !file.commit()) {
+        file.cancelWriting();
+        return QString(i18n("Failed to save the file.\n%1", file.errorString()));
+    }
+
+    return QString();
+}
+
+
+QString ChartExporter::writeSvg(const QString &fileName)
+{
+    QSaveFile file(fileName);
+
+    if (!file.open(QIODevice::WriteOnly)) {
+        return QString(i18n("Failed to open the file.\n%1", file.errorString()));
+    }
+
+    int width = m_document->pattern()->stitches().width();
+    int height = m_document->pattern()->stitches().height();
+
+    QSvgGenerator generator;
+    generator.setOutputDevice(&file);
+    generator.setSize(imageSize());
+    generator.setViewBox(QRect(QPoint(0, 0), imageSize()));
+    generator.setResolution(m_resolution);
+    generator.setTitle(m_document->property(QStringLiteral("title")).toString());
+
+    QPainter painter;
+
+    if (!painter.begin(&generator)) {
+        file.cancelWriting();
+        return QString(i18n("Failed to save the file.\n%1", file.errorString()));
+    }
+
+    // the generator writes the elements as they are painted, so the chart is painted in one pass
+    renderCells(&painter, QRect(0, 0, width, height));
+    painter.end();
+
+    if (!file.commit()) {
+        return QString(i18n("Failed to save the file.\n%1", file.errorString()));
+    }
+
+    return QString();
+}
+
+
+// the number of rows of cells in each strip, limited by the memory used for a strip of a PNG image
+int ChartExporter::stripRows() const
+{
+    qint64 rowBytes = qint64(imageSize().width()) * m_cellHeight * 4;
+
+    return int(std::max(qint64(1), std::min(qint64(m_document->pattern()->stitches().height()), stripBytes / rowBytes)));
+}
+
+
+// render a strip of cells into the viewport of the painter
+void ChartExporter::renderCells(QPainter *painter, const QRect &cells)
+{
+    painter->setRenderHint(QPainter::Antialiasing, true);
+    painter->setWindow(cells);
+    painter->fillRect(cells, m_document->property(QStringLiteral("fabricColor")).value<QColor>());
+
+    m_renderer.render(painter,
+                      m_document->pattern(),
+                      cells,
+                      true,     // grid
+                      true,     // stitches
+                      true,     // backstitches
+                      true,     // knots
+                      -1);      // no color highlight
+}
@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2010-2022 by Stephen Allewell
+ * steve.allewell@gmail.com
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+
+/** @file
+ * This file defines the export of the chart of a pattern as a PNG or SVG image.
+ */
+
+
+#ifndef ChartExporter_H
+#define ChartExporter_H
+
+
+#include <QRect>
+#include <QSize>
+#include <QString>
+
+#include "Renderer.h"
+
+
+class QPainter;
+
+class Document;
+
+
+/**
+ * The chart is rendered with a Renderer in strips of rows of cells, each strip
+ * being drawn on its own so the memory used depends on the width of the chart
+ * and not its area. For PNG images each strip is rendered into a QImage and its
+ * scanlines are compressed and written to the file before the next strip is
+ * rendered, allowing charts of hundreds of megapixels to be exported. Only the
+ * backstitches and knots within a strip are rendered for it. SVG images are
+ * vector elements written as they are painted, so the chart is painted onto a
+ * QSvgGenerator in one pass.
+ *
+ * The size of a cell is found from the resolution and the cloth count of the
+ * document, so the image prints at the size of the stitched pattern.
+ */
+class ChartExporter
+{
+public:
+    /**
+     * Constructor. The renderer is configured from the document properties and
+     * the default render modes of the configuration.
+     *
+     * @param document is a pointer to the Document to export
+     * @param resolution is the resolution of the image in dots per inch
+     */
+    ChartExporter(Document *document, int resolution);
+
+    /**
+     * Set the renderer used to draw the chart, for example to use the render
+     * modes selected in the editor.
+     *
+     * @param renderer is a const reference to the Renderer to copy
+     */
+    void setRenderer(const Renderer &renderer);
+
+    /**
+     * Get the size of the exported image.
+     *
+     * @return a QSize in pixels
+     */
+    QSize imageSize() const;
+
+    /**
+     * Export the chart to a file. The format is chosen from the file extension,
+     * files ending in .svg are written as SVG, anything else as PNG.
+     *
+     * @param fileName is the path of the file to write
+     *
+     * @return an error message, an empty QString if the chart was exported
+     */
+    QString write(const QString &fileName);
+
+private:
+    QString writePng(const QString &);
+    QString writeSvg(const QString &);
+    int stripRows() const;
+    void renderCells(QPainter *, const QRect &);
+
+    static const int stripBytes = 32 * 1024 * 1024;  /**< the largest size of a strip rendered for PNG */
+
+    Document    *m_document;
+    Renderer    m_renderer;
+    int         m_resolution;
+    int         m_cellWidth;    /**< the width of a cell in pixels */
+    int         m_cellHeight;   /**< the height of a cell in pixels */
+};
+
+
+#endif // ChartExporter_H
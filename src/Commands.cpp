@@ -22,6 +22,7 @@
 #include "Editor.h"
 #include "Floss.h"
 #include "FlossScheme.h"
+#include "Glyph.h"
 #include "MainWindow.h"
 #include "Palette.h"
 #include "Preview.h"
@@ -364,6 +365,45 @@ void DeleteStitchCommand::undo()
 }
 
 
+ReplaceStitchQueuesCommand::ReplaceStitchQueuesCommand(Document *document, const QString &text, const QVector<QPoint> &cells, const QVector<StitchQueue *> &queues, QUndoCommand *parent)
+    :   QUndoCommand(text, parent),
+        m_document(document),
+        m_cells(cells),
+        m_queues(queues)
+{
+}
+
+
+ReplaceStitchQueuesCommand::~ReplaceStitchQueuesCommand()
+{
+    qDeleteAll(m_queues);
+}
+
+
+void ReplaceStitchQueuesCommand::redo()
+{
+    swapQueues();
+}
+
+
+void ReplaceStitchQueuesCommand::undo()
+{
+    swapQueues();
+}
+
+
+void ReplaceStitchQueuesCommand::swapQueues()
+{
+    // the command owns whichever set of queues is not in the document, exchanging them
+    // is the same for redo and undo and only touches the cells that changed
+    StitchData &stitches = m_document->pattern()->stitches();
+
+    for (int i = 0 ; i < m_cells.count() ; ++i) {
+        m_queues[i] = stitches.replaceStitchQueueAt(m_cells.at(i), m_queues.at(i));
+    }
+}
+
+
 AddBackstitchCommand::AddBackstitchCommand(Document *document, const QPoint &start, const QPoint &end, int colorIndex)
     :   QUndoCommand(i18n("Add Backstitch")),
         m_document(document),
@@ -894,6 +934,31 @@ void InsertRowsCommand::undo()
 }
 
 
+RemoveConfettiCommand::RemoveConfettiCommand(Document *document)
+    :   QUndoCommand(i18n("Remove Confetti")),
+        m_document(document)
+{
+}
+
+
+void RemoveConfettiCommand::redo()
+{
+    QUndoCommand::redo();
+    m_document->editor()->drawContents();
+    m_document->preview()->drawContents();
+    m_document->palette()->update();
+}
+
+
+void RemoveConfettiCommand::undo()
+{
+    QUndoCommand::undo();
+    m_document->editor()->drawContents();
+    m_document->preview()->drawContents();
+    m_document->palette()->update();
+}
+
+
 ExtendPatternCommand::ExtendPatternCommand(Document *document, int top, int left, int right, int bottom)
     :   QUndoCommand(i18n("Extend Pattern")),
         m_document(document),
@@ -1141,6 +1206,8 @@ void PaletteReplaceColorCommand::redo()
         }
     }
 
+    // the stitches are changed through pointers, not through the stitch data
+    m_document->pattern()->stitches().setModified();
     m_document->editor()->drawContents();
     m_document->preview()->drawContents();
     m_document->palette()->update();
@@ -1167,6 +1234,7 @@ void PaletteReplaceColorCommand::undo()
         knotIterator.next()->colorIndex = m_originalIndex;
     }
 
+    m_document->pattern()->stitches().setModified();
     m_document->editor()->drawContents();
     m_document->preview()->drawContents();
     m_document->palette()->update();
@@ -1302,6 +1370,160 @@ void EditPasteCommand::undo()
 }
 
 
+AddGlyphCommand::AddGlyphCommand(Document *document, const QSharedPointer<const Glyph> &glyph, const QPoint &cursor)
+    :   QUndoCommand(i18n("Add Character")),
+        m_document(document),
+        m_glyph(glyph),
+        m_cursor(cursor),
+        m_stamped(false),
+        m_applied(false),
+        m_stitchQueues(nullptr)
+{
+}
+
+
+AddGlyphCommand::~AddGlyphCommand()
+{
+    if (!m_applied) {
+        qDeleteAll(m_backstitches);
+        qDeleteAll(m_knots);
+        qDeleteAll(m_flosses);
+    }
+}
+
+
+// only the cells of the character are changed and kept for undo, rather than the whole pattern
+void AddGlyphCommand::redo()
+{
+    if (!m_stamped) {
+        stamp();
+    } else {
+        DocumentPalette &palette = m_document->pattern()->palette();
+        StitchData &stitches = m_document->pattern()->stitches();
+
+        for (QMap<int, DocumentFloss *>::const_iterator i = m_flosses.constBegin() ; i != m_flosses.constEnd() ; ++i) {
+            palette.add(i.key(), i.value());
+        }
+
+        m_stitchQueues->redo();
+
+        foreach (Backstitch *backstitch, m_backstitches) {
+            stitches.addBackstitch(backstitch);
+        }
+
+        foreach (Knot *knot, m_knots) {
+            stitches.addFrenchKnot(knot);
+        }
+    }
+
+    m_applied = true;
+    redraw();
+}
+
+
+void AddGlyphCommand::undo()
+{
+    DocumentPalette &palette = m_document->pattern()->palette();
+    StitchData &stitches = m_document->pattern()->stitches();
+
+    foreach (Knot *knot, m_knots) {
+        stitches.takeFrenchKnot(knot);
+    }
+
+    foreach (Backstitch *backstitch, m_backstitches) {
+        stitches.takeBackstitch(backstitch);
+    }
+
+    m_stitchQueues->undo();
+
+    foreach (int key, m_flosses.keys()) {
+        palette.remove(key);
+    }
+
+    m_applied = false;
+    redraw();
+}
+
+
+// match the colors of the character to the palette once, then add its stitches to the cells it covers
+void AddGlyphCommand::stamp()
+{
+    DocumentPalette &palette = m_document->pattern()->palette();
+    StitchData &stitches = m_document->pattern()->stitches();
+    QVector<int> colorIndexes;
+
+    foreach (const QColor &color, m_glyph->colors()) {
+        QMap<int, DocumentFloss *> flosses = palette.flosses();
+        int colorIndex = palette.add(color);
+
+        if (!flosses.contains(colorIndex)) {
+            m_flosses.insert(colorIndex, palette.flosses().value(colorIndex));
+        }
+
+        colorIndexes.append(colorIndex);
+    }
+
+    QRect cellArea(0, 0, stitches.width(), stitches.height());
+    QVector<QPoint> cells;
+    QVector<StitchQueue *> queues;
+
+    foreach (const Glyph::Run &run, m_glyph->runs()) {
+        for (int i = 0 ; i < run.length ; ++i) {
+            QPoint cell = m_cursor + run.start + QPoint(i, 0);
+
+            if (!cellArea.contains(cell)) {
+                continue;
+            }
+
+            StitchQueue *original = stitches.stitchQueueAt(cell);
+            StitchQueue *queue = (original) ? new StitchQueue(original) : new StitchQueue();
+
+            for (int j = 0 ; j < run.stitches.count() ; ++j) {
+                queue->add(run.stitches.at(j).first, colorIndexes.at(run.stitches.at(j).second));
+            }
+
+            cells.append(cell);
+            queues.append(queue);
+        }
+    }
+
+    // the child is only redone and undone from here, so its changes are ordered with those to the palette and lines
+    m_stitchQueues = new ReplaceStitchQueuesCommand(m_document, text(), cells, queues, this);
+    m_stitchQueues->redo();
+
+    QRect snapArea(0, 0, stitches.width() * 2, stitches.height() * 2);
+    QPoint snapCursor(m_cursor * 2);
+
+    foreach (const Glyph::Line &line, m_glyph->lines()) {
+        if (snapArea.contains(line.start + snapCursor) && snapArea.contains(line.end + snapCursor)) {
+            Backstitch *backstitch = new Backstitch(line.start + snapCursor, line.end + snapCursor, colorIndexes.at(line.color));
+            stitches.addBackstitch(backstitch);
+            m_backstitches.append(backstitch);
+        }
+    }
+
+    foreach (const Glyph::Dot &dot, m_glyph->dots()) {
+        if (snapArea.contains(dot.position + snapCursor)) {
+            Knot *knot = new Knot(dot.position + snapCursor, colorIndexes.at(dot.color));
+            stitches.addFrenchKnot(knot);
+            m_knots.append(knot);
+        }
+    }
+
+    m_stamped = true;
+}
+
+
+void AddGlyphCommand::redraw()
+{
+    // a cell around the character is included for backstitches and knots on its edges
+    QRect cellArea(0, 0, m_document->pattern()->stitches().width(), m_document->pattern()->stitches().height());
+    m_document->editor()->drawContents(m_glyph->cells().translated(m_cursor).adjusted(-1, -1, 1, 1).intersected(cellArea));
+    m_document->preview()->drawContents();
+    m_document->palette()->update();
+}
+
+
 MirrorSelectionCommand::MirrorSelectionCommand(Document *document, const QRect &selectionArea, int colorMask, const QList<Stitch::Type> &stitchMasks, bool excludeBackstitches, bool excludeKnots, Qt::Orientation orientation, bool copies, const QByteArray &originalPatternData, Pattern *invertedPattern, const QPoint &pasteCell, bool merge)
     :   QUndoCommand(i18n("Mirror Selection")),
         m_document(document),
@@ -13,11 +13,15 @@
 #define Commands_H
 
 
+#include <QList>
+#include <QMap>
 #include <QPoint>
 #include <QRect>
+#include <QSharedPointer>
 #include <QString>
 #include <QUndoCommand>
 #include <QVariant>
+#include <QVector>
 
 #include "DocumentPalette.h"
 #include "PrinterConfiguration.h"
@@ -30,6 +34,7 @@ class Document;
 class DocumentFloss;
 class Editor;
 class Floss;
+class Glyph;
 class MainWindow;
 class Palette;
 class Pattern;
@@ -226,6 +231,24 @@ private:
 };
 
 
+class ReplaceStitchQueuesCommand : public QUndoCommand
+{
+public:
+    ReplaceStitchQueuesCommand(Document *, const QString &, const QVector<QPoint> &, const QVector<StitchQueue *> &, QUndoCommand *parent = nullptr);
+    virtual ~ReplaceStitchQueuesCommand();
+
+    virtual void redo() Q_DECL_OVERRIDE;
+    virtual void undo() Q_DECL_OVERRIDE;
+
+private:
+    void swapQueues();
+
+    Document                *m_document;
+    QVector<QPoint>         m_cells;
+    QVector<StitchQueue *>  m_queues;
+};
+
+
 class AddBackstitchCommand : public QUndoCommand
 {
 public:
@@ -523,6 +546,20 @@ private:
 };
 
 
+class RemoveConfettiCommand : public QUndoCommand
+{
+public:
+    explicit RemoveConfettiCommand(Document *);
+    virtual ~RemoveConfettiCommand() = default;
+
+    virtual void redo() Q_DECL_OVERRIDE;
+    virtual void undo() Q_DECL_OVERRIDE;
+
+private:
+    Document    *m_document;
+};
+
+
 class ExtendPatternCommand : public QUndoCommand
 {
 public:
@@ -706,6 +743,33 @@ private:
 };
 
 
+class AddGlyphCommand : public QUndoCommand
+{
+public:
+    AddGlyphCommand(Document *, const QSharedPointer<const Glyph> &, const QPoint &);
+    virtual ~AddGlyphCommand();
+
+    void redo() Q_DECL_OVERRIDE;
+    void undo() Q_DECL_OVERRIDE;
+
+private:
+    void stamp();
+    void redraw();
+
+    Document                        *m_document;
+    QSharedPointer<const Glyph>     m_glyph;
+    QPoint                          m_cursor;
+    bool                            m_stamped;
+    bool                            m_applied;
+
+    // the stitches added, the command owns whichever are not in the document
+    ReplaceStitchQueuesCommand      *m_stitchQueues;    // a child exchanging the queues of the cells covered
+    QList<Backstitch *>             m_backstitches;
+    QList<Knot *>                   m_knots;
+    QMap<int, DocumentFloss *>      m_flosses;
+};
+
+
 class MirrorSelectionCommand : public QUndoCommand
 {
 public:
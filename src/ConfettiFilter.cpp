@@ -0,0 +1,201 @@
+/*
+ * Copyright (C) 2010-2022 by Stephen Allewell
+ * steve.allewell@gmail.com
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+
+/** @file
+ * This file implements the removal of confetti, small isolated groups of stitches
+ * of one color, from a grid of colors.
+ */
+
+
+#include "ConfettiFilter.h"
+
+#include <numeric>
+
+#include <QHash>
+
+#include "Stitch.h"
+#include "StitchData.h"
+
+
+/**
+ * Find the root of the component containing a cell, halving the path as it goes.
+ */
+static int findRoot(QVector<int> &parents, int cell)
+{
+    while (parents.at(cell) != cell) {
+        parents[cell] = parents.at(parents.at(cell));
+        cell = parents.at(cell);
+    }
+
+    return cell;
+}
+
+
+/**
+ * Join the components containing two cells, the lower root becoming the root of both.
+ */
+static void unite(QVector<int> &parents, int first, int second)
+{
+    first = findRoot(parents, first);
+    second = findRoot(parents, second);
+
+    if (first < second) {
+        parents[second] = first;
+    } else if (second < first) {
+        parents[first] = second;
+    }
+}
+
+
+int ConfettiFilter::filter(QVector<int> &colors, int width, int height, int confettiSize)
+{
+    int count = width * height;
+
+    if ((count == 0) || (colors.count() != count) || (confettiSize < 1)) {
+        return 0;
+    }
+
+    QVector<int> parents(count);
+    std::iota(parents.begin(), parents.end(), 0);
+
+    for (int dy = 0 ; dy < height ; ++dy) {
+        for (int dx = 0 ; dx < width ; ++dx) {
+            int cell = dy * width + dx;
+            int color = colors.at(cell);
+
+            if (color < 0) {
+                continue;
+            }
+
+            if (dx && (colors.at(cell - 1) == color)) {
+                unite(parents, cell, cell - 1);
+            }
+
+            if (dy && (colors.at(cell - width) == color)) {
+                unite(parents, cell, cell - width);
+            }
+        }
+    }
+
+    QVector<int> roots(count);
+    QVector<int> sizes(count, 0);
+
+    for (int cell = 0 ; cell < count ; ++cell) {
+        roots[cell] = findRoot(parents, cell);
+
+        if (colors.at(cell) >= 0) {
+            sizes[roots.at(cell)]++;
+        }
+    }
+
+    // count the colors of the neighbors of each small component, the colors are taken
+    // from the unfiltered grid so adjacent confetti don't depend on the scan order
+    QHash<int, QHash<int, int>> votes;
+
+    for (int dy = 0 ; dy < height ; ++dy) {
+        for (int dx = 0 ; dx < width ; ++dx) {
+            int cell = dy * width + dx;
+            int root = roots.at(cell);
+
+            if ((colors.at(cell) < 0) || (sizes.at(root) > confettiSize)) {
+                continue;
+            }
+
+            QHash<int, int> &rootVotes = votes[root];
+            const int neighbors[4][2] = {{dx - 1, dy}, {dx + 1, dy}, {dx, dy - 1}, {dx, dy + 1}};
+
+            for (int i = 0 ; i < 4 ; ++i) {
+                int nx = neighbors[i][0];
+                int ny = neighbors[i][1];
+
+                if ((nx < 0) || (nx >= width) || (ny < 0) || (ny >= height)) {
+                    continue;
+                }
+
+                int neighbor = ny * width + nx;
+
+                if ((colors.at(neighbor) >= 0) && (roots.at(neighbor) != root)) {
+                    rootVotes[colors.at(neighbor)]++;
+                }
+            }
+        }
+    }
+
+    QHash<int, int> replacements;
+
+    for (auto root = votes.constBegin() ; root != votes.constEnd() ; ++root) {
+        int replacement = -1;
+        int maximum = 0;
+
+        for (auto vote = root.value().constBegin() ; vote != root.value().constEnd() ; ++vote) {
+            if ((vote.value() > maximum) || ((vote.value() == maximum) && (vote.key() < replacement))) {
+                maximum = vote.value();
+                replacement = vote.key();
+            }
+        }
+
+        if (replacement != -1) {
+            replacements.insert(root.key(), replacement);
+        }
+    }
+
+    int changed = 0;
+
+    if (!replacements.isEmpty()) {
+        for (int cell = 0 ; cell < count ; ++cell) {
+            if ((colors.at(cell) >= 0) && (sizes.at(roots.at(cell)) <= confettiSize)) {
+                int replacement = replacements.value(roots.at(cell), -1);
+
+                if (replacement != -1) {
+                    colors[cell] = replacement;
+                    ++changed;
+                }
+            }
+        }
+    }
+
+    return changed;
+}
+
+
+void ConfettiFilter::filter(StitchData &stitches, const QRect &area, int confettiSize, QVector<QPoint> &cells, QVector<StitchQueue *> &queues)
+{
+    QRect filterArea = area.intersected(QRect(0, 0, stitches.width(), stitches.height()));
+    int width = filterArea.width();
+    int height = filterArea.height();
+
+    QVector<int> colors(width * height, -1);
+
+    for (int dy = 0 ; dy < height ; ++dy) {
+        for (int dx = 0 ; dx < width ; ++dx) {
+            StitchQueue *queue = stitches.stitchQueueAt(filterArea.left() + dx, filterArea.top() + dy);
+
+            if (queue && (queue->count() == 1) && (queue->head()->type == Stitch::Full)) {
+                colors[dy * width + dx] = queue->head()->colorIndex;
+            }
+        }
+    }
+
+    QVector<int> filtered(colors);
+
+    if (filter(filtered, width, height, confettiSize) == 0) {
+        return;
+    }
+
+    for (int i = 0 ; i < filtered.count() ; ++i) {
+        if (filtered.at(i) != colors.at(i)) {
+            StitchQueue *queue = new StitchQueue;
+            queue->add(Stitch::Full, filtered.at(i));
+            cells.append(QPoint(filterArea.left() + i % width, filterArea.top() + i / width));
+            queues.append(queue);
+        }
+    }
+}
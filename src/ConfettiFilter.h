@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2010-2022 by Stephen Allewell
+ * steve.allewell@gmail.com
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+
+/** @file
+ * This file defines the removal of confetti, small isolated groups of stitches
+ * of one color, from a grid of colors.
+ */
+
+
+#ifndef ConfettiFilter_H
+#define ConfettiFilter_H
+
+
+#include <QPoint>
+#include <QRect>
+#include <QVector>
+
+
+class StitchData;
+class StitchQueue;
+
+
+/**
+ * The cells of a grid are labelled with connected-component labelling using a
+ * union-find of the cells, cells being connected to their horizontal and vertical
+ * neighbors of the same color. Components no larger than the confetti size take
+ * the color most common along their boundary. Cells with a negative color, such
+ * as empty cells, are never changed and never provide a color.
+ */
+class ConfettiFilter
+{
+public:
+    /**
+     * Merge the confetti in a grid of colors into the surrounding colors.
+     *
+     * @param colors is a grid of color indexes, the cells being indexed by y * width + x
+     * @param width is the width of the grid
+     * @param height is the height of the grid
+     * @param confettiSize is the largest number of cells in a component treated as confetti
+     *
+     * @return the number of cells changed
+     */
+    static int filter(QVector<int> &colors, int width, int height, int confettiSize);
+
+    /**
+     * Find the confetti in an area of the stitch data. Only cells containing a single
+     * full stitch are considered, all other cells are left unchanged.
+     *
+     * @param stitches is the StitchData to be filtered
+     * @param area is the area of the stitch data to be filtered
+     * @param confettiSize is the largest number of cells in a component treated as confetti
+     * @param cells is filled with the cells that change
+     * @param queues is filled with the new StitchQueue for each changed cell, the caller takes ownership
+     */
+    static void filter(StitchData &stitches, const QRect &area, int confettiSize, QVector<QPoint> &cells, QVector<StitchQueue *> &queues);
+};
+
+
+#endif // ConfettiFilter_H
@@ -11,9 +11,14 @@
 
 #include "Document.h"
 
+#include <algorithm>
+#include <limits>
+
+#include <QBuffer>
 #include <QDataStream>
 #include <QFile>
 #include <QVariant>
+#include <QtEndian>
 
 #include <KLocalizedString>
 #include <KMessageBox>
@@ -28,11 +33,89 @@
 #include "SchemeManager.h"
 
 
+/**
+    A bounds checked cursor over the data of a file held in memory. Reading past the
+    end of the data returns zero and invalidates the cursor, as QDataStream does with
+    ReadPastEnd, so loops only need to check the cursor once they have finished.
+    */
+class DataCursor
+{
+public:
+    DataCursor(const QByteArray &data, qint64 position, QDataStream::ByteOrder byteOrder)
+        :   m_position(reinterpret_cast<const uchar *>(data.constData()) + std::min(position, qint64(data.size()))),
+            m_end(reinterpret_cast<const uchar *>(data.constData()) + data.size()),
+            m_begin(reinterpret_cast<const uchar *>(data.constData())),
+            m_littleEndian(byteOrder == QDataStream::LittleEndian),
+            m_valid(true)
+    {
+    }
+
+    template <typename T> T read()
+    {
+        if (m_end - m_position < qptrdiff(sizeof(T))) {
+            m_position = m_end;
+            m_valid = false;
+            return T(0);
+        }
+
+        T value = m_littleEndian ? qFromLittleEndian<T>(m_position) : qFromBigEndian<T>(m_position);
+        m_position += sizeof(T);
+
+        return value;
+    }
+
+    qint64 position() const
+    {
+        return m_position - m_begin;
+    }
+
+    bool isValid() const
+    {
+        return m_valid;
+    }
+
+private:
+    const uchar *m_position;
+    const uchar *m_end;
+    const uchar *m_begin;
+    bool        m_littleEndian;
+    bool        m_valid;
+};
+
+
+/**
+    Get the contents of a device in memory. Files are mapped rather than read, the returned
+    QByteArray referencing the mapped memory which remains valid while the file is open.
+    */
+static QByteArray deviceData(QIODevice *device)
+{
+    if (QBuffer *buffer = qobject_cast<QBuffer *>(device)) {
+        return buffer->data();
+    }
+
+    QFile *file = qobject_cast<QFile *>(device);
+
+    if (file && (file->size() > 0) && (file->size() < std::numeric_limits<int>::max())) {
+        if (uchar *memory = file->map(0, file->size())) {
+            return QByteArray::fromRawData(reinterpret_cast<const char *>(memory), int(file->size()));
+        }
+    }
+
+    qint64 position = device->pos();
+    device->seek(0);
+    QByteArray data = device->readAll();
+    device->seek(position);
+
+    return data;
+}
+
+
 Document::Document()
     :   m_editor(nullptr),
         m_palette(nullptr),
         m_preview(nullptr),
-        m_pattern(nullptr)
+        m_pattern(nullptr),
+        m_printerConfigurationModified(false)
 {
     initialiseNew();
 }
@@ -201,12 +284,32 @@ const PrinterConfiguration &Document::printerConfiguration() const
 void Document::setPrinterConfiguration(const PrinterConfiguration &printerConfiguration)
 {
     m_printerConfiguration = printerConfiguration;
+    m_printerConfigurationModified = true;
 }
 
 
-void Document::readKXStitch(QDataStream &stream)
+bool Document::takePrinterConfigurationModified()
+{
+    bool modified = m_printerConfigurationModified;
+    m_printerConfigurationModified = false;
+
+    return modified;
+}
+
+
+// the stitches of a document that is loaded on demand are decoded by StitchData::loadInBackground
+// or as they are used, otherwise they are decoded before this returns
+void Document::readKXStitch(QDataStream &device, bool loadOnDemand)
 {
     initialiseNew();
+    m_pattern->stitches().setLoadOnDemand(loadOnDemand);
+
+    // the file is parsed in memory rather than reading each field from the device
+    QByteArray data = deviceData(device.device());
+    QBuffer buffer(&data);
+    buffer.open(QIODevice::ReadOnly);
+    buffer.seek(device.device()->pos());
+    QDataStream stream(&buffer);
 
     char header[30];
     stream.readRawData(header, 30);
@@ -269,27 +372,27 @@ void Document::readKXStitch(QDataStream &stream)
 
         switch (version) {
         case 2:
-            readKXStitchV2File(stream);
+            readKXStitchV2File(stream, data);
             break;
 
         case 3:
-            readKXStitchV3File(stream);
+            readKXStitchV3File(stream, data);
             break;
 
         case 4:
-            readKXStitchV4File(stream);
+            readKXStitchV4File(stream, data);
             break;
 
         case 5:
-            readKXStitchV5File(stream);
+            readKXStitchV5File(stream, data);
             break;
 
         case 6:
-            readKXStitchV6File(stream);
+            readKXStitchV6File(stream, data);
             break;
 
         case 7:
-            readKXStitchV7File(stream);
+            readKXStitchV7File(stream, data);
             break;
 
         default:
@@ -302,19 +405,26 @@ void Document::readKXStitch(QDataStream &stream)
 }
 
 
-void Document::readPCStitch(QDataStream &stream)
+void Document::readPCStitch(QDataStream &device)
 {
     initialiseNew();
 
+    // the file is parsed in memory rather than reading each field from the device
+    QByteArray data = deviceData(device.device());
+    QBuffer buffer(&data);
+    buffer.open(QIODevice::ReadOnly);
+    buffer.seek(device.device()->pos());
+    QDataStream stream(&buffer);
+
     char header[23];
     stream.readRawData(header, 23);
 
     if (strncmp(header, "PCStitch 5 Pattern File", 23) == 0) {
-        readPCStitch5File(stream);
+        readPCStitch5File(stream, data);
     } else if (strncmp(header, "PCStitch 6 Pattern File", 23) == 0) {
-        readPCStitch6File(stream);
+        readPCStitch6File(stream, data);
     } else if (strncmp(header, "PCStitch 7 Pattern File", 23) == 0) {
-        readPCStitch7File(stream);
+        readPCStitch7File(stream, data);
     } else {
         throw InvalidFile();
     }
@@ -322,14 +432,47 @@ void Document::readPCStitch(QDataStream &stream)
 
 
 void Document::write(QDataStream &stream)
+{
+    snapshot().write(stream);
+}
+
+
+DocumentSnapshot Document::snapshot() const
+{
+    DocumentSnapshot snapshot;
+
+    // the small parts of the document are streamed now, the background images and the
+    // stitches share their encoded data with the document and are written from that
+    QDataStream head(&snapshot.m_head, QIODevice::WriteOnly);
+    head.setVersion(QDataStream::Qt_4_0);
+    head.writeRawData("KXStitchDoc", 11);
+    head << version;
+    head << m_properties;
+
+    snapshot.m_backgroundImages = m_backgroundImages.snapshot();
+    snapshot.m_pattern = m_pattern->snapshot();
+
+    QDataStream tail(&snapshot.m_tail, QIODevice::WriteOnly);
+    tail.setVersion(QDataStream::Qt_4_0);
+    tail << m_printerConfiguration;
+
+    if ((head.status() != QDataStream::Ok) || (tail.status() != QDataStream::Ok)) {
+        throw FailedWriteFile(QDataStream::WriteFailed);
+    }
+
+    return snapshot;
+}
+
+
+// this may be called on a worker thread, the progress of writing the stitches is reported
+// to progress if it is not nullptr
+void DocumentSnapshot::write(QDataStream &stream, QFutureInterfaceBase *progress) const
 {
     stream.setVersion(QDataStream::Qt_4_0); // maintain consistancy in the qt types
-    stream.writeRawData("KXStitchDoc", 11);
-    stream << version;
-    stream << m_properties;
+    stream.writeRawData(m_head.constData(), m_head.size());
     stream << m_backgroundImages;
-    stream << *m_pattern;
-    stream << m_printerConfiguration;
+    m_pattern.write(stream, progress);
+    stream.writeRawData(m_tail.constData(), m_tail.size());
 
     if (stream.status() != QDataStream::Ok) {
         throw FailedWriteFile(stream.status());
@@ -351,13 +494,19 @@ QVariant Document::property(const QString &name) const
 }
 
 
+const QMap<QString, QVariant> &Document::properties() const
+{
+    return m_properties;
+}
+
+
 void Document::setProperty(const QString &name, const QVariant &value)
 {
     m_properties[name] = value;
 }
 
 
-void Document::readPCStitch5File(QDataStream &stream)
+void Document::readPCStitch5File(QDataStream &stream, const QByteArray &data)
 {
     /* File Format
         uchar[256]      // header 'PCStitch 5 Pattern File'
@@ -542,93 +691,11 @@ void Document::readPCStitch5File(QDataStream &stream)
 
     m_pattern->palette().setCurrentIndex(-1);
 
-    Stitch::Type stitchType[] = {Stitch::Delete, Stitch::Full, Stitch::TL3Qtr, Stitch::TR3Qtr, Stitch::BL3Qtr, Stitch::BR3Qtr, Stitch::TBHalf, Stitch::BTHalf, Stitch::Delete, Stitch::TLQtr, Stitch::TRQtr, Stitch::BLQtr, Stitch::BRQtr}; // conversion of PCStitch to KXStitch
-
-    int documentWidth = m_pattern->stitches().width();
-    int documentHeight = m_pattern->stitches().height();
-    int cells = documentWidth * documentHeight;
-
-    quint16 cellCount;
-
-    for (int i = 0 ; i < cells ; i += cellCount) {
-        quint8 color;
-        quint8 type;
-
-        stream >> cellCount;
-        stream >> color;
-        stream >> type;
-
-        if (type != 0xff) {
-            for (int c = 0 ; c < cellCount ; c++) {
-                int xc = (i + c) / documentHeight;
-                int yc = (i + c) % documentHeight;
-                m_pattern->stitches().addStitch(QPoint(xc, yc), stitchType[type], color - 1); // color-1 because PCStitch uses 1 based array
-            }
-        }
-    }
-
-    quint32 extras;
-    stream >> extras;
-
-    while (extras--) {
-        quint16 x;
-        quint16 y;
-        quint8 color;
-        quint8 type;
-
-        stream >> x;
-        stream >> y;
-
-        for (int dx = 0 ; dx < 4 ; dx++) {
-            stream >> color;
-            stream >> type;
-
-            if (type != 0xff) {
-                m_pattern->stitches().addStitch(QPoint(x - 1, y - 1), stitchType[type], color - 1);
-            }
-        }
-    }
-
-    // read french knots
-
-    quint32 knots;
-    stream >> knots;
-
-    while (knots--) {
-        quint16 x;
-        quint16 y;
-        quint8 color;
-
-        stream >> x;
-        stream >> y;
-        stream >> color;
-        m_pattern->stitches().addFrenchKnot(QPoint(x - 1, y - 1), color - 1);
-    }
-
-    // read backstitches
-
-    quint32 backstitches;
-    stream >> backstitches;
-
-    while (backstitches--) {
-        quint16 sx;
-        quint16 sy;
-        quint16 sp;
-        quint16 ex;
-        quint16 ey;
-        quint16 ep;
-        quint8 color;
-        stream >> sx >> sy >> sp >> ex >> ey >> ep >> color;
-        m_pattern->stitches().addBackstitch(QPoint(--sx * 2 + ((sp - 1) % 3), --sy * 2 + ((sp - 1) / 3)), QPoint(--ex * 2 + ((ep - 1) % 3), --ey * 2 + ((ep - 1) / 3)), color - 1);
-    }
-
-    if (stream.status() != QDataStream::Ok) {
-        throw FailedReadFile(QString(i18n("Stream error")));
-    }
+    readPCStitchStitches(stream, data, 5);
 }
 
 
-void Document::readPCStitch6File(QDataStream &stream)
+void Document::readPCStitch6File(QDataStream &stream, const QByteArray &data)
 {
     /* File Format
         uchar[256]      // header 'PCStitch 6 Pattern File'
@@ -823,93 +890,11 @@ void Document::readPCStitch6File(QDataStream &stream)
 
     m_pattern->palette().setCurrentIndex(-1);
 
-    Stitch::Type stitchType[] = {Stitch::Delete, Stitch::Full, Stitch::TL3Qtr, Stitch::TR3Qtr, Stitch::BL3Qtr, Stitch::BR3Qtr, Stitch::TBHalf, Stitch::BTHalf, Stitch::Delete, Stitch::TLQtr, Stitch::TRQtr, Stitch::BLQtr, Stitch::BRQtr}; // conversion of PCStitch to KXStitch
-
-    int documentWidth = m_pattern->stitches().width();
-    int documentHeight = m_pattern->stitches().height();
-    int cells = documentWidth * documentHeight;
-
-    quint16 cellCount;
-
-    for (int i = 0 ; i < cells ; i += cellCount) {
-        quint8 color;
-        quint8 type;
-
-        stream >> cellCount;
-        stream >> color;
-        stream >> type;
-
-        if (type != 0xff) {
-            for (int c = 0 ; c < cellCount ; c++) {
-                int xc = (i + c) / documentHeight;
-                int yc = (i + c) % documentHeight;
-                m_pattern->stitches().addStitch(QPoint(xc, yc), stitchType[type], color - 1); // color-1 because PCStitch uses 1 based array
-            }
-        }
-    }
-
-    quint32 extras;
-    stream >> extras;
-
-    while (extras--) {
-        qint16 x;
-        qint16 y;
-        quint8 color;
-        quint8 type;
-
-        stream >> x;
-        stream >> y;
-
-        for (int dx = 0 ; dx < 4 ; dx++) {
-            stream >> color;
-            stream >> type;
-
-            if (type != 0xff) {
-                m_pattern->stitches().addStitch(QPoint(x - 1, y - 1), stitchType[type], color - 1);
-            }
-        }
-    }
-
-    // read french knots
-
-    quint32 knots;
-    stream >> knots;
-
-    while (knots--) {
-        qint16 x;
-        qint16 y;
-        quint8 color;
-
-        stream >> x;
-        stream >> y;
-        stream >> color;
-        m_pattern->stitches().addFrenchKnot(QPoint(x - 1, y - 1), color - 1);
-    }
-
-    // read backstitches
-
-    qint32 backstitches;
-    stream >> backstitches;
-
-    while (backstitches--) {
-        qint16 sx;
-        qint16 sy;
-        qint16 sp;
-        qint16 ex;
-        qint16 ey;
-        qint16 ep;
-        quint16 color;
-        stream >> sx >> sy >> sp >> ex >> ey >> ep >> color;
-        m_pattern->stitches().addBackstitch(QPoint(--sx * 2 + ((sp - 1) % 3), --sy * 2 + ((sp - 1) / 3)), QPoint(--ex * 2 + ((ep - 1) % 3), --ey * 2 + ((ep - 1) / 3)), color - 1);
-    }
-
-    if (stream.status() != QDataStream::Ok) {
-        throw FailedReadFile(QString(i18n("Stream error")));
-    }
+    readPCStitchStitches(stream, data, 6);
 }
 
 
-void Document::readPCStitch7File(QDataStream &stream)
+void Document::readPCStitch7File(QDataStream &stream, const QByteArray &data)
 {
     /* File Format
         uchar[256]      // header 'PCStitch 7 Pattern File'
@@ -1123,112 +1108,169 @@ void Document::readPCStitch7File(QDataStream &stream)
 
     m_pattern->palette().setCurrentIndex(-1);
 
+    readPCStitchStitches(stream, data, 7);
+}
+
+
+QString Document::readPCStitchString(QDataStream &stream)
+{
+    char *buffer;
+    quint16 stringSize;
+    stream >> stringSize;
+    buffer = new char[stringSize + 1];
+    stream.readRawData(buffer, stringSize);
+    buffer[stringSize] = '\0';
+    QString string = QString::fromLatin1(buffer);
+    delete [] buffer;
+
+    if (stream.status() != QDataStream::Ok) {
+        throw FailedReadFile(QString(i18n("Stream error")));
+    }
+
+    return string;
+}
+
+
+void Document::readPCStitchStitches(QDataStream &stream, const QByteArray &data, int fileVersion)
+{
+    /* The stitch data follows the palette in all versions, only the sizes of some fields differ.
+     * The cells are stored as runs of identical cells in columns from the top left downward.
+     * Parsing uses a cursor on the data in memory and runs are added to the stitch data
+     * a column at a time rather than a cell at a time.
+     */
     Stitch::Type stitchType[] = {Stitch::Delete, Stitch::Full, Stitch::TL3Qtr, Stitch::TR3Qtr, Stitch::BL3Qtr, Stitch::BR3Qtr, Stitch::TBHalf, Stitch::BTHalf, Stitch::Delete, Stitch::TLQtr, Stitch::TRQtr, Stitch::BLQtr, Stitch::BRQtr}; // conversion of PCStitch to KXStitch
-    // TODO above needs to include petite stitches
-    int documentWidth = m_pattern->stitches().width();
-    int documentHeight = m_pattern->stitches().height();
-    int cells = documentWidth * documentHeight;
+    // TODO above needs to include petite stitches for version 7
+    const int stitchTypes = sizeof(stitchType) / sizeof(Stitch::Type);
 
-    quint16 cellCount;
+    if (stream.status() != QDataStream::Ok) {
+        throw FailedReadFile(QString(i18n("Stream error")));
+    }
 
-    for (int i = 0 ; i < cells ; i += cellCount) {
-        quint8 color;
-        quint8 type;
+    StitchData &stitchData = m_pattern->stitches();
+    int documentHeight = stitchData.height();
+    int cells = stitchData.width() * documentHeight;
 
-        stream >> cellCount;
-        stream >> color;
-        stream >> type;
+    DataCursor cursor(data, stream.device()->pos(), QDataStream::LittleEndian);
+
+    for (int i = 0 ; i < cells ; ) {
+        int cellCount = cursor.read<quint16>();
+        quint8 color = cursor.read<quint8>();
+        quint8 type = cursor.read<quint8>();
+
+        if (!cursor.isValid() || (cellCount == 0)) {
+            throw FailedReadFile(QString(i18n("Stream error")));
+        }
 
         if (type != 0xff) {
-            for (int c = 0 ; c < cellCount ; c++) {
-                int xc = (i + c) / documentHeight;
-                int yc = (i + c) % documentHeight;
-                m_pattern->stitches().addStitch(QPoint(xc, yc), stitchType[type], color - 1); // color-1 because PCStitch uses 1 based array
+            if (type >= stitchTypes) {
+                throw FailedReadFile(QString(i18n("Invalid data read.")));
+            }
+
+            // split the run into the parts in each column
+            for (int c = i, end = std::min(i + cellCount, cells) ; c < end ; ) {
+                int yc = c % documentHeight;
+                int count = std::min(end - c, documentHeight - yc);
+                stitchData.addStitches(QPoint(c / documentHeight, yc), count, Qt::Vertical, stitchType[type], color - 1); // color-1 because PCStitch uses 1 based array
+                c += count;
             }
         }
+
+        i += cellCount;
     }
 
-    quint32 extras;
-    stream >> extras;
+    // version 6 used signed coordinates and version 5 used byte sized colors for knots and backstitches
+    auto coordinate = [&cursor, fileVersion]() -> int {
+        return (fileVersion == 6) ? int(cursor.read<qint16>()) : int(cursor.read<quint16>());
+    };
 
-    while (extras--) {
-        quint16 x;
-        quint16 y;
-        quint8 color;
-        quint8 type;
+    quint32 extras = cursor.read<quint32>();
 
-        stream >> x;
-        stream >> y;
+    while (extras-- && cursor.isValid()) {
+        int x = coordinate();
+        int y = coordinate();
 
         for (int dx = 0 ; dx < 4 ; dx++) {
-            stream >> color;
-            stream >> type;
+            quint8 color = cursor.read<quint8>();
+            quint8 type = cursor.read<quint8>();
 
-            if (type != 0xff) {
-                m_pattern->stitches().addStitch(QPoint(x - 1, y - 1), stitchType[type], color - 1);
+            if ((type != 0xff) && (type < stitchTypes) && (x > 0) && (x <= stitchData.width()) && (y > 0) && (y <= documentHeight)) {
+                stitchData.addStitch(QPoint(x - 1, y - 1), stitchType[type], color - 1);
             }
         }
     }
 
     // read french knots
 
-    quint32 knots;
-    stream >> knots;
-
-    while (knots--) {
-        quint16 x;
-        quint16 y;
-        quint16 color;
+    quint32 knots = cursor.read<quint32>();
 
-        stream >> x;
-        stream >> y;
-        stream >> color;
-        m_pattern->stitches().addFrenchKnot(QPoint(x - 1, y - 1), color - 1);
+    while (knots-- && cursor.isValid()) {
+        int x = coordinate();
+        int y = coordinate();
+        int color = (fileVersion == 7) ? cursor.read<quint16>() : cursor.read<quint8>();
+        stitchData.addFrenchKnot(QPoint(x - 1, y - 1), color - 1);
     }
 
     // read backstitches
 
-    quint32 backstitches;
-    stream >> backstitches;
+    quint32 backstitches = cursor.read<quint32>();
 
-    while (backstitches--) {
-        quint16 sx;
-        quint16 sy;
-        quint16 sp;
-        quint16 ex;
-        quint16 ey;
-        quint16 ep;
-        quint16 color;
-        stream >> sx >> sy >> sp >> ex >> ey >> ep >> color;
-        m_pattern->stitches().addBackstitch(QPoint(--sx * 2 + ((sp - 1) % 3), --sy * 2 + ((sp - 1) / 3)), QPoint(--ex * 2 + ((ep - 1) % 3), --ey * 2 + ((ep - 1) / 3)), color - 1);
+    while (backstitches-- && cursor.isValid()) {
+        int sx = coordinate();
+        int sy = coordinate();
+        int sp = coordinate();
+        int ex = coordinate();
+        int ey = coordinate();
+        int ep = coordinate();
+        int color = (fileVersion == 5) ? cursor.read<quint8>() : cursor.read<quint16>();
+        stitchData.addBackstitch(QPoint(--sx * 2 + ((sp - 1) % 3), --sy * 2 + ((sp - 1) / 3)), QPoint(--ex * 2 + ((ep - 1) % 3), --ey * 2 + ((ep - 1) / 3)), color - 1);
     }
 
-    if (stream.status() != QDataStream::Ok) {
+    if (!cursor.isValid()) {
         throw FailedReadFile(QString(i18n("Stream error")));
     }
+
+    stream.device()->seek(cursor.position());
 }
 
 
-QString Document::readPCStitchString(QDataStream &stream)
+void Document::readKXStitchStitches(QDataStream &stream, const QByteArray &data)
 {
-    char *buffer;
-    quint16 stringSize;
-    stream >> stringSize;
-    buffer = new char[stringSize + 1];
-    stream.readRawData(buffer, stringSize);
-    buffer[stringSize] = '\0';
-    QString string = QString::fromLatin1(buffer);
-    delete [] buffer;
+    /* The stitches of versions 2 to 7 are stored for each cell from the top left across
+     * as a qint8 count of the stitches followed by qint8 type and qint16 colorIndex for each.
+     * Parsing uses a cursor on the data in memory and each queue is built before being
+     * added to the stitch data.
+     */
+    StitchData &stitchData = m_pattern->stitches();
+    int width = stitchData.width();
+    int cells = width * stitchData.height();
 
-    if (stream.status() != QDataStream::Ok) {
+    DataCursor cursor(data, stream.device()->pos(), QDataStream::BigEndian);
+
+    for (int i = 0 ; i < cells ; i++) {
+        qint8 stitches = cursor.read<qint8>();
+
+        if (stitches > 0) {
+            StitchQueue *stitchQueue = new StitchQueue;
+
+            while (stitches--) {
+                qint8 type = cursor.read<qint8>();
+                qint16 colorIndex = cursor.read<qint16>();
+                stitchQueue->add(Stitch::Type(type), colorIndex);
+            }
+
+            stitchData.replaceStitchQueueAt(i % width, i / width, stitchQueue);
+        }
+    }
+
+    if (!cursor.isValid()) {
         throw FailedReadFile(QString(i18n("Stream error")));
     }
 
-    return string;
+    stream.device()->seek(cursor.position());
 }
 
 
-void Document::readKXStitchV2File(QDataStream &stream)
+void Document::readKXStitchV2File(QDataStream &stream, const QByteArray &data)
 {
     /* File format
         // header
@@ -1364,22 +1406,9 @@ void Document::readKXStitchV2File(QDataStream &stream)
     // read stitches
     stream  >> width
             >> height;
-    qint32 cells = width * height;
     m_pattern->stitches().resize(width, height);
 
-    for (int i = 0 ; i < cells ; i++) {
-        qint8 stitches;
-        stream  >> stitches;
-
-        while (stitches--) {
-            qint8 type;
-            qint16 colorIndex;
-            stream  >> type
-                    >> colorIndex;
-
-            m_pattern->stitches().addStitch(QPoint(i % width, i / width), Stitch::Type(type), colorIndex);
-        }
-    }
+    readKXStitchStitches(stream, data);
 
     qint32 backstitches;
     stream  >> backstitches;
@@ -1401,7 +1430,7 @@ void Document::readKXStitchV2File(QDataStream &stream)
 }
 
 
-void Document::readKXStitchV3File(QDataStream &stream)
+void Document::readKXStitchV3File(QDataStream &stream, const QByteArray &data)
 {
     /* File format
         // header
@@ -1530,22 +1559,9 @@ void Document::readKXStitchV3File(QDataStream &stream)
     // read stitches
     stream  >> width
             >> height;
-    qint32 cells = width * height;
     m_pattern->stitches().resize(width, height);
 
-    for (int i = 0 ; i < cells ; i++) {
-        qint8 stitches;
-        stream  >> stitches;
-
-        while (stitches--) {
-            qint8 type;
-            qint16 colorIndex;
-            stream  >> type
-                    >> colorIndex;
-
-            m_pattern->stitches().addStitch(QPoint(i % width, i / width), Stitch::Type(type), colorIndex);
-        }
-    }
+    readKXStitchStitches(stream, data);
 
     qint32 backstitches;
     stream  >> backstitches;
@@ -1567,7 +1583,7 @@ void Document::readKXStitchV3File(QDataStream &stream)
 }
 
 
-void Document::readKXStitchV4File(QDataStream &stream)
+void Document::readKXStitchV4File(QDataStream &stream, const QByteArray &data)
 {
     // version 4 wasn't used in the release versions.
     // but was available in cvs
@@ -1701,22 +1717,9 @@ void Document::readKXStitchV4File(QDataStream &stream)
     // read stitches
     stream  >> width
             >> height;
-    qint32 cells = width * height;
     m_pattern->stitches().resize(width, height);
 
-    for (int i = 0 ; i < cells ; i++) {
-        qint8 stitches;
-        stream  >> stitches;
-
-        while (stitches--) {
-            qint8 type;
-            qint16 colorIndex;
-            stream  >> type
-                    >> colorIndex;
-
-            m_pattern->stitches().addStitch(QPoint(i % width, i / width), Stitch::Type(type), colorIndex);
-        }
-    }
+    readKXStitchStitches(stream, data);
 
     qint32 knots;
     stream  >> knots;
@@ -1750,7 +1753,7 @@ void Document::readKXStitchV4File(QDataStream &stream)
 }
 
 
-void Document::readKXStitchV5File(QDataStream &stream)
+void Document::readKXStitchV5File(QDataStream &stream, const QByteArray &data)
 {
     /* File format
         // header
@@ -1906,22 +1909,9 @@ void Document::readKXStitchV5File(QDataStream &stream)
     // read stitches
     stream  >> width
             >> height;
-    qint32 cells = width * height;
     m_pattern->stitches().resize(width, height);
 
-    for (int i = 0 ; i < cells ; i++) {
-        qint8 stitches;
-        stream  >> stitches;
-
-        while (stitches--) {
-            qint8 type;
-            qint16 colorIndex;
-            stream  >> type
-                    >> colorIndex;
-
-            m_pattern->stitches().addStitch(QPoint(i % width, i / width), Stitch::Type(type), colorIndex);
-        }
-    }
+    readKXStitchStitches(stream, data);
 
     qint32 knots;
     stream  >> knots;
@@ -1955,7 +1945,7 @@ void Document::readKXStitchV5File(QDataStream &stream)
 }
 
 
-void Document::readKXStitchV6File(QDataStream &stream)
+void Document::readKXStitchV6File(QDataStream &stream, const QByteArray &data)
 {
     /* File format
         // header
@@ -2116,22 +2106,9 @@ void Document::readKXStitchV6File(QDataStream &stream)
     // read stitches
     stream  >> width
             >> height;
-    qint32 cells = width * height;
     m_pattern->stitches().resize(width, height);
 
-    for (int i = 0 ; i < cells ; i++) {
-        qint8 stitches;
-        stream  >> stitches;
-
-        while (stitches--) {
-            qint8 type;
-            qint16 colorIndex;
-            stream  >> type
-                    >> colorIndex;
-
-            m_pattern->stitches().addStitch(QPoint(i % width, i / width), Stitch::Type(type), colorIndex);
-        }
-    }
+    readKXStitchStitches(stream, data);
 
     qint32 knots;
     stream  >> knots;
@@ -2165,7 +2142,7 @@ void Document::readKXStitchV6File(QDataStream &stream)
 }
 
 
-void Document::readKXStitchV7File(QDataStream &stream)
+void Document::readKXStitchV7File(QDataStream &stream, const QByteArray &data)
 {
     /* File format
         // header
@@ -2319,22 +2296,9 @@ void Document::readKXStitchV7File(QDataStream &stream)
     // read stitches
     stream  >> width
             >> height;
-    qint32 cells = width * height;
     m_pattern->stitches().resize(width, height);
 
-    for (int i = 0 ; i < cells ; i++) {
-        qint8 stitches;
-        stream  >> stitches;
-
-        while (stitches--) {
-            qint8 type;
-            qint16 colorIndex;
-            stream  >> type
-                    >> colorIndex;
-
-            m_pattern->stitches().addStitch(QPoint(i % width, i / width), Stitch::Type(type), colorIndex);
-        }
-    }
+    readKXStitchStitches(stream, data);
 
     qint32 knots;
     stream  >> knots;
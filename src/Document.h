@@ -13,6 +13,7 @@
 #define Document_H
 
 
+#include <QByteArray>
 #include <QPolygon>
 #include <QUndoStack>
 #include <QUrl>
@@ -29,6 +30,21 @@ class Palette;
 class Preview;
 
 
+class DocumentSnapshot
+{
+public:
+    void write(QDataStream &, QFutureInterfaceBase *progress = nullptr) const;
+
+private:
+    friend class Document;
+
+    QByteArray                  m_head;     // header and properties
+    BackgroundImagesSnapshot    m_backgroundImages;
+    PatternSnapshot             m_pattern;
+    QByteArray                  m_tail;     // printer configuration
+};
+
+
 class Document
 {
 public:
@@ -37,9 +53,10 @@ public:
 
     void initialiseNew();
 
-    void readKXStitch(QDataStream &);
+    void readKXStitch(QDataStream &, bool loadOnDemand = false);
     void readPCStitch(QDataStream &);
     void write(QDataStream &);
+    DocumentSnapshot snapshot() const;
 
     void setUrl(const QUrl &);
     QUrl url() const;
@@ -53,6 +70,7 @@ public:
     Preview *preview() const;
 
     QVariant property(const QString &) const;
+    const QMap<QString, QVariant> &properties() const;
     void setProperty(const QString &, const QVariant &);
 
     QUndoStack &undoStack();
@@ -61,19 +79,22 @@ public:
     Pattern *pattern();
     const PrinterConfiguration &printerConfiguration() const;
     void setPrinterConfiguration(const PrinterConfiguration &);
+    bool takePrinterConfigurationModified();
 
 private:
-    void readPCStitch5File(QDataStream &);
-    void readPCStitch6File(QDataStream &);
-    void readPCStitch7File(QDataStream &);
+    void readPCStitch5File(QDataStream &, const QByteArray &);
+    void readPCStitch6File(QDataStream &, const QByteArray &);
+    void readPCStitch7File(QDataStream &, const QByteArray &);
     QString readPCStitchString(QDataStream &);
+    void readPCStitchStitches(QDataStream &, const QByteArray &, int);
 
-    void readKXStitchV2File(QDataStream &);
-    void readKXStitchV3File(QDataStream &);
-    void readKXStitchV4File(QDataStream &);
-    void readKXStitchV5File(QDataStream &);
-    void readKXStitchV6File(QDataStream &);
-    void readKXStitchV7File(QDataStream &);
+    void readKXStitchV2File(QDataStream &, const QByteArray &);
+    void readKXStitchV3File(QDataStream &, const QByteArray &);
+    void readKXStitchV4File(QDataStream &, const QByteArray &);
+    void readKXStitchV5File(QDataStream &, const QByteArray &);
+    void readKXStitchV6File(QDataStream &, const QByteArray &);
+    void readKXStitchV7File(QDataStream &, const QByteArray &);
+    void readKXStitchStitches(QDataStream &, const QByteArray &);
 
     static const int version = 104;
 
@@ -90,6 +111,7 @@ private:
     BackgroundImages    m_backgroundImages;
     Pattern             *m_pattern;
     PrinterConfiguration    m_printerConfiguration;
+    bool                    m_printerConfigurationModified;     // since takePrinterConfigurationModified, used by the journal
 };
 
 
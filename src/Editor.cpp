@@ -36,6 +36,7 @@
 #include "Document.h"
 #include "Floss.h"
 #include "FlossScheme.h"
+#include "Glyph.h"
 #include "LibraryManagerDlg.h"
 #include "LibraryPattern.h"
 #include "LibraryTreeWidgetItem.h"
@@ -200,6 +201,7 @@ Editor::Editor(QWidget *parent)
         m_maskBackstitch(false),
         m_maskKnot(false),
         m_makesCopies(Configuration::tool_MakesCopies()),
+        m_readOnly(false),
         m_activeCommand(nullptr),
         m_colorHighlight(Configuration::renderer_ColorHilight()),
         m_pastePattern(nullptr)
@@ -241,6 +243,19 @@ Scale *Editor::verticalScale()
 }
 
 
+const Renderer &Editor::renderer() const
+{
+    return m_renderer;
+}
+
+
+void Editor::setReadOnly(bool readOnly)
+{
+    m_readOnly = readOnly;
+    setAcceptDrops(!readOnly);
+}
+
+
 void Editor::readDocumentSettings()
 {
     m_cellHorizontalGrouping = m_document->property(QStringLiteral("cellHorizontalGrouping")).toInt();
@@ -299,6 +314,16 @@ void Editor::drawContents(const QRect &cells)
         renderBackgroundImages(painter, cells);
     }
 
+    // when viewing a file the stitches are decoded as they are drawn, otherwise they are
+    // decoded in the background and drawn when they are available
+    if (m_readOnly) {
+        QRect loadedCells = m_document->pattern()->stitches().loadRows(cells.top(), cells.bottom());
+
+        if (loadedCells.isValid()) {
+            emit cellsLoaded(loadedCells);
+        }
+    }
+
     m_renderer.render(&painter,
                       m_document->pattern(),
                       cells,
@@ -499,11 +524,30 @@ void Editor::editCopy()
 void Editor::editPaste()
 {
     m_pasteData = QApplication::clipboard()->mimeData()->data(QStringLiteral("application/kxstitch"));
-    m_pastePattern = new Pattern;
+    m_pastePattern = readPastePattern();
+
+    if (m_pastePattern) {
+        pastePattern(ToolPaste);
+    }
+}
+
+
+// read the pattern being pasted or dropped, returning nullptr if it cannot be read
+Pattern *Editor::readPastePattern()
+{
+    Pattern *pattern = new Pattern;
     QDataStream stream(&m_pasteData, QIODevice::ReadOnly);
-    stream >> *m_pastePattern;
 
-    pastePattern(ToolPaste);
+    try {
+        stream >> *pattern;
+    } catch (const FailedReadFile &e) {
+        delete pattern;
+        pattern = nullptr;
+        m_pasteData.clear();
+        KMessageBox::error(nullptr, i18n("Failed to read the pasted pattern.\n%1", e.status));
+    }
+
+    return pattern;
 }
 
 
@@ -782,11 +826,13 @@ void Editor::dragLeaveEvent(QDragLeaveEvent*)
 void Editor::dropEvent(QDropEvent *e)
 {
     m_pasteData = e->mimeData()->data(QStringLiteral("application/kxstitch"));
-    m_pastePattern = new Pattern;
-    QDataStream stream(&m_pasteData, QIODevice::ReadOnly);
-    stream >> *m_pastePattern;
-    m_document->undoStack().push(new EditPasteCommand(m_document, m_pastePattern, contentsToCell(e->pos()), e->keyboardModifiers() & Qt::ShiftModifier, i18n("Drag")));
-    m_pastePattern = nullptr;
+    m_pastePattern = readPastePattern();
+
+    if (m_pastePattern) {
+        m_document->undoStack().push(new EditPasteCommand(m_document, m_pastePattern, contentsToCell(e->pos()), e->keyboardModifiers() & Qt::ShiftModifier, i18n("Drag")));
+        m_pastePattern = nullptr;
+    }
+
     m_pasteData.clear();
     e->accept();
 }
@@ -794,7 +840,7 @@ void Editor::dropEvent(QDropEvent *e)
 
 void Editor::keyPressEvent(QKeyEvent *e)
 {
-    if (keyPressCallPointers[m_toolMode]) {
+    if (!m_readOnly && keyPressCallPointers[m_toolMode]) {
         (this->*keyPressCallPointers[m_toolMode])(e);
     } else {
         e->ignore();
@@ -905,9 +951,9 @@ void Editor::keyPressAlphabet(QKeyEvent *e)
             libraryPattern = m_libraryManagerDlg->currentLibrary()->findCharacter(e->key(), modifiers);
 
             if (libraryPattern) {
-                if ((m_cursorStack.top() + QPoint(libraryPattern->pattern()->stitches().width(), 0)).x() >= width) {
+                if ((m_cursorStack.top() + QPoint(libraryPattern->width(), 0)).x() >= width) {
                     if (m_cursorCommands[m_cursorStack.count() - 2]) {
-                        static_cast<AlphabetCommand *>(m_activeCommand)->push(new ExtendPatternCommand(m_document, 0, 0, m_cursorStack.top().x() + libraryPattern->pattern()->stitches().width() - width + Configuration::alphabet_ExtendPatternWidth(), 0));
+                        static_cast<AlphabetCommand *>(m_activeCommand)->push(new ExtendPatternCommand(m_document, 0, 0, m_cursorStack.top().x() + libraryPattern->width() - width + Configuration::alphabet_ExtendPatternWidth(), 0));
                         m_cursorCommands[m_cursorStack.count() - 1]++;
                     } else {
                         m_cellTracking = QPoint(m_cursorStack.at(0).x(), m_cursorStack.top().y() + m_libraryManagerDlg->currentLibrary()->maxHeight() + Configuration::alphabet_LineSpacing());
@@ -923,10 +969,10 @@ void Editor::keyPressAlphabet(QKeyEvent *e)
                     }
                 }
 
-                QPoint insertionPoint = m_cursorStack.top() - QPoint(0, libraryPattern->pattern()->stitches().height() - 1 - libraryPattern->baseline());
-                static_cast<AlphabetCommand *>(m_activeCommand)->push(new EditPasteCommand(m_document, libraryPattern->pattern(), insertionPoint, true, i18n("Add Character")));
+                QSharedPointer<const Glyph> glyph = libraryPattern->glyph();
+                static_cast<AlphabetCommand *>(m_activeCommand)->push(new AddGlyphCommand(m_document, glyph, m_cursorStack.top()));
                 m_cursorCommands[m_cursorStack.count() - 1]++;
-                m_cursorStack.push(m_cursorStack.top() + QPoint(libraryPattern->pattern()->stitches().width() + 1, 0));
+                m_cursorStack.push(m_cursorStack.top() + QPoint(glyph->advance(), 0));
             } else {
                 if (e->key() == Qt::Key_Space) {
                     m_cellTracking = m_cursorStack.top() + QPoint(Configuration::alphabet_SpaceWidth(), 0);
@@ -1187,7 +1233,7 @@ void Editor::toolCleanupRotate()
 
 void Editor::mousePressEvent(QMouseEvent *e)
 {
-    if (!rect().contains(e->pos())) {
+    if (m_readOnly || !rect().contains(e->pos())) {
         return;
     }
 
@@ -1202,7 +1248,7 @@ void Editor::mousePressEvent(QMouseEvent *e)
 
 void Editor::mouseMoveEvent(QMouseEvent *e)
 {
-    if (!rect().contains(e->pos())) {
+    if (m_readOnly || !rect().contains(e->pos())) {
         return;
     }
 
@@ -1226,7 +1272,7 @@ void Editor::mouseMoveEvent(QMouseEvent *e)
 
 void Editor::mouseReleaseEvent(QMouseEvent *e)
 {
-    if (!rect().contains(e->pos())) {
+    if (m_readOnly || !rect().contains(e->pos())) {
         return;
     }
 
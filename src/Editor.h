@@ -82,12 +82,17 @@ public:
     Scale *horizontalScale();
     Scale *verticalScale();
 
+    const Renderer &renderer() const;
+
+    void setReadOnly(bool);
+
     QRect selectionArea();
     void resetSelectionArea();
 
 signals:
     void selectionMade(bool);
     void changedVisibleCells(const QRect&);
+    void cellsLoaded(const QRect&);
 
 public slots:
     void libraryManager();
@@ -164,6 +169,8 @@ protected:
 private:
     bool zoom(double);
 
+    Pattern *readPastePattern();
+
     void keyPressPolygon(QKeyEvent*);
     void keyPressText(QKeyEvent*);
     void keyPressAlphabet(QKeyEvent*);
@@ -303,6 +310,7 @@ private:
     bool    m_maskBackstitch;
     bool    m_maskKnot;
     bool    m_makesCopies;
+    bool    m_readOnly;
 
     Qt::Orientation         m_orientation;
     StitchData::Rotation    m_rotation;
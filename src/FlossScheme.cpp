@@ -11,6 +11,8 @@
 
 #include "FlossScheme.h"
 
+#include <QMutexLocker>
+
 
 FlossScheme::FlossScheme()
     :   m_map(nullptr)
@@ -26,7 +28,8 @@ FlossScheme::~FlossScheme()
 
 Floss *FlossScheme::convert(const QColor &color)
 {
-    createImageMap();
+    QMutexLocker locker(&m_mapMutex);
+    imageMap();
 
     char c[3];
     c[0] = (char)color.red();
@@ -38,6 +41,7 @@ Floss *FlossScheme::convert(const QColor &color)
     Magick::Image image = Magick::Image(1, 1, "RGB", MagickLib::CharPixel, c);
 #endif
     image.map(*m_map);
+    locker.unlock();
 
     const Magick::ColorRGB rgb = image.pixelColor(0,0);
 
@@ -47,22 +51,16 @@ Floss *FlossScheme::convert(const QColor &color)
 
 Floss *FlossScheme::find(const QString &name) const
 {
-    QListIterator<Floss *> flossIterator(m_flosses);
-
-    while (flossIterator.hasNext()) {
-        Floss *floss = flossIterator.next();
-
-        if (floss->name() == name) {
-            return floss;
-        }
-    }
-
-    return nullptr;
+    return m_flossNames.value(name, nullptr);
 }
 
 
 Floss *FlossScheme::find(const QColor &color) const
 {
+    if (Floss *floss = m_flossColors.value(qRgb(color.red(), color.green(), color.blue()), nullptr)) {
+        return floss;
+    }
+
     QListIterator<Floss *> flossIterator(m_flosses);
 
     Floss *matched = nullptr;
@@ -106,6 +104,19 @@ const QList<Floss *> &FlossScheme::flosses() const
 void FlossScheme::addFloss(Floss *floss)
 {
     m_flosses.append(floss);
+
+    if (!m_flossNames.contains(floss->name())) {
+        m_flossNames.insert(floss->name(), floss);
+    }
+
+    QColor color = floss->color();
+    QRgb rgb = qRgb(color.red(), color.green(), color.blue());
+
+    if (!m_flossColors.contains(rgb)) {
+        m_flossColors.insert(rgb, floss);
+    }
+
+    QMutexLocker locker(&m_mapMutex);
     delete m_map;
     m_map = nullptr;
 }
@@ -115,12 +126,29 @@ void FlossScheme::clearScheme()
 {
     qDeleteAll(m_flosses);
     m_flosses.clear();
+    m_flossNames.clear();
+    m_flossColors.clear();
 
+    QMutexLocker locker(&m_mapMutex);
     delete m_map;
     m_map = nullptr;
 }
 
 
+// to be called when the names or colors of the flosses have been changed directly
+void FlossScheme::updateIndexes()
+{
+    QList<Floss *> flosses;
+    flosses.swap(m_flosses);
+    m_flossNames.clear();
+    m_flossColors.clear();
+
+    foreach (Floss *floss, flosses) {
+        addFloss(floss);
+    }
+}
+
+
 void FlossScheme::setSchemeName(const QString &name)
 {
     m_schemeName = name;
@@ -134,6 +162,15 @@ void FlossScheme::setPath(const QString &name)
 
 
 Magick::Image *FlossScheme::createImageMap()
+{
+    QMutexLocker locker(&m_mapMutex);
+
+    return imageMap();
+}
+
+
+// called with m_mapMutex held
+Magick::Image *FlossScheme::imageMap()
 {
     if (m_map == nullptr) {
         char *pixels = new char[(m_flosses.size() + 1) * 4];
@@ -14,8 +14,10 @@
 
 
 #include <QColor>
+#include <QHash>
 #include <QList>
 #include <QListIterator>
+#include <QMutex>
 #include <QString>
 
 // wrap include to silence unused-parameter warning from Magick++ include file
@@ -43,15 +45,21 @@ public:
 
     void addFloss(Floss *floss);
     void clearScheme();
+    void updateIndexes();
     Magick::Image *createImageMap();
     void setSchemeName(const QString &name);
     void setPath(const QString &name);
 
 private:
+    Magick::Image *imageMap();
+
     QString     m_schemeName;
     QString     m_path;
     QList<Floss *>  m_flosses;
+    QHash<QString, Floss *> m_flossNames;   // the first floss with each name
+    QHash<QRgb, Floss *>    m_flossColors;  // the first floss with each color, the alpha is ignored
     Magick::Image   *m_map;
+    QMutex          m_mapMutex;             // the map is created and used by convert on worker threads when reading files
 };
 
 #endif // FlossScheme_H
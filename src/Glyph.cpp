@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2010-2022 by Stephen Allewell
+ * steve.allewell@gmail.com
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+
+/** @file
+ * This file implements the compiled form of library patterns used by the
+ * alphabet tool.
+ */
+
+
+#include "Glyph.h"
+
+#include "DocumentFloss.h"
+#include "Pattern.h"
+
+
+Glyph::Glyph(Pattern *pattern, int baseline)
+{
+    StitchData &stitches = pattern->stitches();
+
+    // the cursor is on the baseline, which is counted up from the bottom row
+    QPoint offset(0, baseline + 1 - stitches.height());
+    m_cells = QRect(offset, QSize(stitches.width(), stitches.height()));
+
+    for (int y = 0 ; y < stitches.height() ; ++y) {
+        Run run;
+        run.length = 0;
+
+        for (int x = 0 ; x < stitches.width() ; ++x) {
+            Stitches cell;
+
+            if (StitchQueue *queue = stitches.stitchQueueAt(x, y)) {
+                foreach (const Stitch *stitch, *queue) {
+                    cell.append(qMakePair(stitch->type, colorIndex(pattern, stitch->colorIndex)));
+                }
+            }
+
+            if (run.length && (cell == run.stitches)) {
+                ++run.length;
+                continue;
+            }
+
+            if (run.length) {
+                m_runs.append(run);
+                run.length = 0;
+            }
+
+            if (!cell.isEmpty()) {
+                run.start = QPoint(x, y) + offset;
+                run.length = 1;
+                run.stitches = cell;
+            }
+        }
+
+        if (run.length) {
+            m_runs.append(run);
+        }
+    }
+
+    // backstitches and knots are in snap coordinates, twice the cell coordinates
+    foreach (const Backstitch *backstitch, stitches.backstitches()) {
+        Line line;
+        line.start = backstitch->start + offset * 2;
+        line.end = backstitch->end + offset * 2;
+        line.color = colorIndex(pattern, backstitch->colorIndex);
+        m_lines.append(line);
+    }
+
+    foreach (const Knot *knot, stitches.knots()) {
+        Dot dot;
+        dot.position = knot->position + offset * 2;
+        dot.color = colorIndex(pattern, knot->colorIndex);
+        m_dots.append(dot);
+    }
+}
+
+
+QRect Glyph::cells() const
+{
+    return m_cells;
+}
+
+
+// a column is left between characters
+int Glyph::advance() const
+{
+    return m_cells.width() + 1;
+}
+
+
+const QVector<QColor> &Glyph::colors() const
+{
+    return m_colors;
+}
+
+
+const QVector<Glyph::Run> &Glyph::runs() const
+{
+    return m_runs;
+}
+
+
+const QVector<Glyph::Line> &Glyph::lines() const
+{
+    return m_lines;
+}
+
+
+const QVector<Glyph::Dot> &Glyph::dots() const
+{
+    return m_dots;
+}
+
+
+int Glyph::colorIndex(Pattern *pattern, int flossIndex)
+{
+    int index = m_flossIndexes.indexOf(flossIndex);
+
+    if (index == -1) {
+        index = m_flossIndexes.count();
+        m_flossIndexes.append(flossIndex);
+        m_colors.append(pattern->palette().flosses().value(flossIndex)->flossColor());
+    }
+
+    return index;
+}
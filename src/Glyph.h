@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2010-2022 by Stephen Allewell
+ * steve.allewell@gmail.com
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+
+/** @file
+ * This file defines the compiled form of library patterns used by the alphabet
+ * tool.
+ */
+
+
+#ifndef Glyph_H
+#define Glyph_H
+
+
+#include <QColor>
+#include <QPair>
+#include <QPoint>
+#include <QRect>
+#include <QVector>
+
+#include "Stitch.h"
+
+
+class Pattern;
+
+
+/**
+ * A library pattern compiled for stamping into a pattern as a character of
+ * text. The stitches are held as horizontal runs of cells with the same
+ * stitches, so the solid areas of most characters are a few runs, and the
+ * colors are held as the floss colors used, so they are matched to the
+ * palette of the pattern once for each character rather than for each stitch.
+ *
+ * The positions are relative to the text cursor with the baseline of the
+ * character applied, the cursor being the cell on the baseline at the left of
+ * the character, and the advance of the cursor includes the space between
+ * characters, so stamping a character needs no further calculation.
+ */
+class Glyph
+{
+public:
+    /**
+     * A list of stitch types and indexes into colors().
+     */
+    typedef QVector<QPair<Stitch::Type, int> > Stitches;
+
+    /**
+     * A horizontal run of cells with the same stitches.
+     */
+    struct Run {
+        QPoint      start;      /**< the first cell relative to the cursor */
+        int         length;     /**< the number of cells */
+        Stitches    stitches;   /**< the stitches of each cell */
+    };
+
+    /**
+     * A backstitch in snap coordinates relative to the cursor.
+     */
+    struct Line {
+        QPoint  start;
+        QPoint  end;
+        int     color;          /**< an index into colors() */
+    };
+
+    /**
+     * A french knot in snap coordinates relative to the cursor.
+     */
+    struct Dot {
+        QPoint  position;
+        int     color;          /**< an index into colors() */
+    };
+
+    /**
+     * Constructor, compiling a library pattern.
+     *
+     * @param pattern is a pointer to the Pattern of the library pattern
+     * @param baseline is the baseline of the library pattern
+     */
+    Glyph(Pattern *pattern, int baseline);
+
+    /**
+     * Get the cells covered by the character.
+     *
+     * @return a QRect of the cells relative to the cursor
+     */
+    QRect cells() const;
+
+    /**
+     * Get the distance the cursor moves after the character.
+     *
+     * @return the number of cells
+     */
+    int advance() const;
+
+    const QVector<QColor> &colors() const;
+    const QVector<Run> &runs() const;
+    const QVector<Line> &lines() const;
+    const QVector<Dot> &dots() const;
+
+private:
+    int colorIndex(Pattern *pattern, int flossIndex);
+
+    QRect           m_cells;
+    QVector<QColor> m_colors;
+    QVector<int>    m_flossIndexes;     // the floss index of the library pattern for each of m_colors
+    QVector<Run>    m_runs;
+    QVector<Line>   m_lines;
+    QVector<Dot>    m_dots;
+};
+
+
+#endif // Glyph_H
@@ -0,0 +1,568 @@
+/*
+ * Copyright (C) 2010-2022 by Stephen Allewell
+ * steve.allewell@gmail.com
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+
+/** @file
+ * This file implements the conversion of an imported image, already scaled and
+ * mapped to the colors of a floss scheme, into runs of stitches.
+ */
+
+
+#include "ImageConverter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+#include <QHash>
+#include <QSet>
+#include <QtConcurrent>
+
+#include "ConfettiFilter.h"
+#include "DocumentFloss.h"
+#include "Floss.h"
+#include "FlossScheme.h"
+#include "Stitch.h"
+#include "SymbolLibrary.h"
+#include "SymbolManager.h"
+
+
+/**
+ * Function object used by QtConcurrent::mapped to convert a row, QtConcurrent
+ * requires the result_type to be defined.
+ */
+class RowConverter
+{
+public:
+    typedef ImageConverter::Runs result_type;
+
+    explicit RowConverter(const QImage &pixels)
+        :   m_pixels(pixels)
+    {
+    }
+
+    ImageConverter::Runs operator()(int row) const
+    {
+        return ImageConverter::convertRow(m_pixels, row);
+    }
+
+private:
+    QImage  m_pixels;
+};
+
+
+Magick::Image ImageConverter::load(const QString &source, int maximumSize, QSize &sourceSize)
+{
+    // pinging reads the size from the header without decoding the pixels
+    Magick::Image image;
+    image.ping(source.toStdString());
+    sourceSize = QSize(image.columns(), image.rows());
+
+    if ((sourceSize.width() <= maximumSize) && (sourceSize.height() <= maximumSize)) {
+        image.read(source.toStdString());
+        return image;
+    }
+
+    QSize reducedSize = sourceSize.scaled(maximumSize, maximumSize, Qt::KeepAspectRatio);
+    Magick::Geometry geometry(reducedSize.width(), reducedSize.height());
+
+    // the size hint lets the jpeg decoder scale by up to 1/8 as it decodes, other formats
+    // are decoded at full size and released as soon as they have been reduced
+    Magick::Image reduced;
+    reduced.defineValue("jpeg", "size", std::string(geometry));
+    reduced.read(source.toStdString());
+    reduced.resize(geometry);
+
+    return reduced;
+}
+
+
+/**
+ * A color in the CIE Lab color space.
+ */
+struct Lab {
+    float   L;
+    float   a;
+    float   b;
+};
+
+
+/**
+ * Convert an sRGB color to Lab using the D65 white point.
+ */
+static Lab toLab(const uchar *rgb)
+{
+    static const QVector<float> linear = []() {
+        QVector<float> table(256);
+
+        for (int i = 0 ; i < 256 ; ++i) {
+            float c = i / 255.0f;
+            table[i] = (c <= 0.04045f) ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+        }
+
+        return table;
+    }();
+
+    float r = linear[rgb[0]];
+    float g = linear[rgb[1]];
+    float b = linear[rgb[2]];
+
+    float x = (0.4124f * r + 0.3576f * g + 0.1805f * b) / 0.95047f;
+    float y = (0.2126f * r + 0.7152f * g + 0.0722f * b);
+    float z = (0.0193f * r + 0.1192f * g + 0.9505f * b) / 1.08883f;
+
+    auto f = [](float t) {
+        return (t > 0.008856f) ? std::cbrt(t) : (7.787f * t + 16.0f / 116.0f);
+    };
+
+    float fx = f(x);
+    float fy = f(y);
+    float fz = f(z);
+
+    return {116.0f * fy - 16.0f, 500.0f * (fx - fy), 200.0f * (fy - fz)};
+}
+
+
+static float distance(const Lab &lhs, const Lab &rhs)
+{
+    float dL = lhs.L - rhs.L;
+    float da = lhs.a - rhs.a;
+    float db = lhs.b - rhs.b;
+
+    return dL * dL + da * da + db * db;
+}
+
+
+/**
+ * A k-d tree of the colors of a palette, used to find the palette color nearest
+ * to a pixel without comparing the pixel with every color of the palette.
+ */
+class PaletteTree
+{
+public:
+    explicit PaletteTree(const QVector<Lab> &palette)
+        :   m_palette(palette),
+            m_nodes(palette.count())
+    {
+        std::iota(m_nodes.begin(), m_nodes.end(), 0);
+        build(0, m_nodes.count(), 0);
+    }
+
+    int nearest(const Lab &color) const
+    {
+        int found = 0;
+        float minimum = std::numeric_limits<float>::max();
+        search(0, m_nodes.count(), 0, color, found, minimum);
+
+        return found;
+    }
+
+private:
+    static float component(const Lab &color, int axis)
+    {
+        return (axis == 0) ? color.L : ((axis == 1) ? color.a : color.b);
+    }
+
+    // the median of a range is its node, the colors before it being less on the axis and those after it greater
+    void build(int begin, int end, int axis)
+    {
+        if (end - begin < 2) {
+            return;
+        }
+
+        int middle = (begin + end) / 2;
+        std::nth_element(m_nodes.begin() + begin, m_nodes.begin() + middle, m_nodes.begin() + end, [this, axis](int lhs, int rhs) {
+            return component(m_palette.at(lhs), axis) < component(m_palette.at(rhs), axis);
+        });
+
+        build(begin, middle, (axis + 1) % 3);
+        build(middle + 1, end, (axis + 1) % 3);
+    }
+
+    // the side of a node containing the color is searched first, the other side only if it could hold a nearer color
+    void search(int begin, int end, int axis, const Lab &color, int &found, float &minimum) const
+    {
+        if (begin >= end) {
+            return;
+        }
+
+        int middle = (begin + end) / 2;
+        int index = m_nodes.at(middle);
+        float d = distance(m_palette.at(index), color);
+
+        if (d < minimum) {
+            minimum = d;
+            found = index;
+        }
+
+        float offset = component(color, axis) - component(m_palette.at(index), axis);
+        int next = (axis + 1) % 3;
+
+        if (offset < 0) {
+            search(begin, middle, next, color, found, minimum);
+
+            if (offset * offset < minimum) {
+                search(middle + 1, end, next, color, found, minimum);
+            }
+        } else {
+            search(middle + 1, end, next, color, found, minimum);
+
+            if (offset * offset < minimum) {
+                search(begin, middle, next, color, found, minimum);
+            }
+        }
+    }
+
+    QVector<Lab>    m_palette;
+    QVector<int>    m_nodes;    /**< indexes into m_palette arranged as a tree */
+};
+
+
+QImage ImageConverter::rgba(Magick::Image image)
+{
+    int width = image.columns();
+    int height = image.rows();
+
+    QImage pixels(width, height, QImage::Format_RGBA8888);
+    image.write(0, 0, width, height, "RGBA", Magick::CharPixel, pixels.bits());
+
+    return pixels;
+}
+
+
+QVector<QRgb> ImageConverter::palette(const QImage &pixels)
+{
+    QSet<QRgb> colors;
+
+    for (int dy = 0 ; dy < pixels.height() ; ++dy) {
+        const uchar *pixel = pixels.constScanLine(dy);
+        const uchar *end = pixel + pixels.width() * 4;
+
+        for ( ; pixel < end ; pixel += 4) {
+            if (pixel[3]) {
+                colors.insert(qRgb(pixel[0], pixel[1], pixel[2]));
+            }
+        }
+    }
+
+    return colors.values().toVector();
+}
+
+
+QImage ImageConverter::dither(const QImage &pixels, const QVector<QRgb> &palette, Configuration::EnumImport_Dithering::type dithering)
+{
+    static const int bayer[8][8] = {
+        { 0, 32,  8, 40,  2, 34, 10, 42},
+        {48, 16, 56, 24, 50, 18, 58, 26},
+        {12, 44,  4, 36, 14, 46,  6, 38},
+        {60, 28, 52, 20, 62, 30, 54, 22},
+        { 3, 35, 11, 43,  1, 33,  9, 41},
+        {51, 19, 59, 27, 49, 17, 57, 25},
+        {15, 47,  7, 39, 13, 45,  5, 37},
+        {63, 31, 55, 23, 61, 29, 53, 21}
+    };
+
+    if (palette.isEmpty() || (dithering == Configuration::EnumImport_Dithering::None)) {
+        return pixels;
+    }
+
+    int width = pixels.width();
+    int height = pixels.height();
+
+    QVector<Lab> paletteLab;
+    paletteLab.reserve(palette.count());
+
+    foreach (QRgb color, palette) {
+        const uchar rgb[3] = {uchar(qRed(color)), uchar(qGreen(color)), uchar(qBlue(color))};
+        paletteLab.append(toLab(rgb));
+    }
+
+    PaletteTree tree(paletteLab);
+
+    // the ordered threshold is scaled to the average distance between neighboring palette colors
+    float spread = 0.0f;
+
+    if ((dithering == Configuration::EnumImport_Dithering::Ordered) && (paletteLab.count() > 1)) {
+        for (int i = 0 ; i < paletteLab.count() ; ++i) {
+            float minimum = std::numeric_limits<float>::max();
+
+            for (int j = 0 ; j < paletteLab.count() ; ++j) {
+                if (i != j) {
+                    minimum = std::min(minimum, distance(paletteLab.at(i), paletteLab.at(j)));
+                }
+            }
+
+            spread += std::sqrt(minimum);
+        }
+
+        spread /= paletteLab.count();
+    }
+
+    QVector<Lab> buffer(width * height);
+
+    for (int dy = 0 ; dy < height ; ++dy) {
+        const uchar *pixel = pixels.constScanLine(dy);
+
+        for (int dx = 0 ; dx < width ; ++dx, pixel += 4) {
+            buffer[dy * width + dx] = toLab(pixel);
+        }
+    }
+
+    auto diffuse = [&](int x, int y, const Lab &error, float weight) {
+        if ((x >= 0) && (x < width) && (y < height)) {
+            Lab &target = buffer[y * width + x];
+            target.L += error.L * weight;
+            target.a += error.a * weight;
+            target.b += error.b * weight;
+        }
+    };
+
+    QImage dithered(width, height, QImage::Format_RGBA8888);
+
+    for (int dy = 0 ; dy < height ; ++dy) {
+        bool reverse = (dy % 2);
+        int step = reverse ? -1 : 1;
+        const uchar *source = pixels.constScanLine(dy);
+        uchar *destination = dithered.scanLine(dy);
+
+        for (int i = 0 ; i < width ; ++i) {
+            int dx = reverse ? width - 1 - i : i;
+            const uchar *in = source + dx * 4;
+            uchar *out = destination + dx * 4;
+
+            out[3] = in[3];
+
+            if (in[3] == 0) {
+                out[0] = in[0];
+                out[1] = in[1];
+                out[2] = in[2];
+                continue;
+            }
+
+            const Lab &color = buffer.at(dy * width + dx);
+            int index;
+
+            if (dithering == Configuration::EnumImport_Dithering::Ordered) {
+                // the threshold is applied to the lightness only, adding it to a and b as well
+                // would shift every pixel along the same diagonal and tint the pattern
+                float threshold = ((bayer[dy % 8][dx % 8] + 0.5f) / 64.0f - 0.5f) * spread;
+                index = tree.nearest({color.L + threshold, color.a, color.b});
+            } else {
+                index = tree.nearest(color);
+            }
+
+            QRgb mapped = palette.at(index);
+            out[0] = uchar(qRed(mapped));
+            out[1] = uchar(qGreen(mapped));
+            out[2] = uchar(qBlue(mapped));
+
+            const Lab &chosen = paletteLab.at(index);
+            Lab error = {color.L - chosen.L, color.a - chosen.a, color.b - chosen.b};
+
+            if (dithering == Configuration::EnumImport_Dithering::FloydSteinberg) {
+                diffuse(dx + step, dy, error, 7.0f / 16.0f);
+                diffuse(dx - step, dy + 1, error, 3.0f / 16.0f);
+                diffuse(dx, dy + 1, error, 5.0f / 16.0f);
+                diffuse(dx + step, dy + 1, error, 1.0f / 16.0f);
+            } else if (dithering == Configuration::EnumImport_Dithering::Atkinson) {
+                diffuse(dx + step, dy, error, 1.0f / 8.0f);
+                diffuse(dx + 2 * step, dy, error, 1.0f / 8.0f);
+                diffuse(dx - step, dy + 1, error, 1.0f / 8.0f);
+                diffuse(dx, dy + 1, error, 1.0f / 8.0f);
+                diffuse(dx + step, dy + 1, error, 1.0f / 8.0f);
+                diffuse(dx, dy + 2, error, 1.0f / 8.0f);
+            }
+        }
+    }
+
+    return dithered;
+}
+
+
+Magick::Image ImageConverter::mapColors(Magick::Image image, const Magick::Image &colorMap, int colors, Configuration::EnumImport_Dithering::type dithering)
+{
+    image.modifyImage();
+
+    // keep the sampled image, dithering maps it to the floss colors chosen by the quantization
+    Magick::Image sampledImage(image);
+
+    image.quantizeColorSpace(Magick::RGBColorspace);
+    image.quantizeColors(colors);
+    image.quantize();
+    image.map(colorMap);
+    image.modifyImage();
+
+    if (dithering != Configuration::EnumImport_Dithering::None) {
+        QImage dithered = dither(rgba(sampledImage), palette(rgba(image)), dithering);
+        image = Magick::Image(dithered.width(), dithered.height(), "RGBA", Magick::CharPixel, dithered.constBits());
+    }
+
+    return image;
+}
+
+
+QImage ImageConverter::pixels(Magick::Image image, bool ignoreColor, const Magick::ColorRGB &ignoreColorValue)
+{
+    int width = image.columns();
+    int height = image.rows();
+
+/*
+ * ImageMagick prior to V7 used matte (opacity) to determine if an image has transparency,
+ * ImageMagick V7 now uses alpha (transparency).
+ *
+ * Exporting the pixels as RGBA bytes hides this difference, the exported A channel is always
+ * the alpha value, 0 for fully transparent to 255 for opaque, regardless of the version.
+ * The byte order also matches the QImage::Format_RGBA8888 layout, so the pixels are written
+ * directly into the scanlines of the image in one call.
+ */
+#if MagickLibVersion < 0x700
+    bool hasTransparency = image.matte();
+#else
+    bool hasTransparency = image.alpha();
+#endif
+
+    QImage pixels = rgba(image);
+
+    const uchar ignoreRed = uchar(qRound(255 * ignoreColorValue.red()));
+    const uchar ignoreGreen = uchar(qRound(255 * ignoreColorValue.green()));
+    const uchar ignoreBlue = uchar(qRound(255 * ignoreColorValue.blue()));
+
+    // transparent and ignored pixels are cleared, anything else is made
+    // fully opaque as it would be stitched
+    for (int dy = 0 ; dy < height ; ++dy) {
+        uchar *pixel = pixels.scanLine(dy);
+        uchar *end = pixel + width * 4;
+
+        for ( ; pixel < end ; pixel += 4) {
+            bool transparent = (hasTransparency && (pixel[3] == 0)) || (ignoreColor && (pixel[0] == ignoreRed) && (pixel[1] == ignoreGreen) && (pixel[2] == ignoreBlue));
+            pixel[3] = transparent ? 0 : 255;
+        }
+    }
+
+    return pixels;
+}
+
+
+ImageConverter::Runs ImageConverter::convertRow(const QImage &pixels, int row)
+{
+    Runs runs;
+    const uchar *pixel = pixels.constScanLine(row);
+    int width = pixels.width();
+
+    for (int dx = 0 ; dx < width ; ++dx, pixel += 4) {
+        if (pixel[3] == 0) {
+            continue;
+        }
+
+        QRgb color = qRgb(pixel[0], pixel[1], pixel[2]);
+
+        if (!runs.isEmpty() && (runs.last().start + runs.last().length == dx) && (runs.last().color == color)) {
+            runs.last().length++;
+        } else {
+            runs.append({dx, 1, color});
+        }
+    }
+
+    return runs;
+}
+
+
+QFuture<ImageConverter::Runs> ImageConverter::convert(const QImage &pixels)
+{
+    QVector<int> rows(pixels.height());
+    std::iota(rows.begin(), rows.end(), 0);
+
+    return QtConcurrent::mapped(rows, RowConverter(pixels));
+}
+
+
+void ImageConverter::createStitches(const QList<Runs> &runs, int imageWidth, bool useFractionals, FlossScheme *flossScheme, QList<DocumentFloss *> &flosses, QVector<QPoint> &cells, QVector<StitchQueue *> &queues)
+{
+    int imageHeight = runs.count();
+    int documentWidth = useFractionals ? imageWidth / 2 : imageWidth;
+    int documentHeight = useFractionals ? imageHeight / 2 : imageHeight;
+
+    QList<qint16> symbolIndexes = SymbolManager::library(Configuration::palette_DefaultSymbolLibrary())->indexes();
+
+    // expand the runs into a grid of colors, transparent pixels are -1
+    QVector<QRgb> colors;
+    QHash<QRgb, int> colorIndexes;
+    QVector<int> grid(imageWidth * imageHeight, -1);
+
+    for (int dy = 0 ; dy < imageHeight ; ++dy) {
+        foreach (const Run &run, runs.at(dy)) {
+            int colorIndex = colorIndexes.value(run.color, -1);
+
+            if (colorIndex == -1) {
+                colorIndex = colors.count();
+                colors.append(run.color);
+                colorIndexes.insert(run.color, colorIndex);
+            }
+
+            std::fill(grid.begin() + dy * imageWidth + run.start, grid.begin() + dy * imageWidth + run.start + run.length, colorIndex);
+        }
+    }
+
+    if (Configuration::import_RemoveConfetti()) {
+        ConfettiFilter::filter(grid, imageWidth, imageHeight, Configuration::import_ConfettiSize());
+    }
+
+    // merge the pixels into a queue for each cell, flosses are added in the order
+    // their colors are first found scanning the rows
+    QVector<int> documentFlosses(colors.count(), -1);
+    QVector<StitchQueue *> cellQueues(documentWidth * documentHeight);
+
+    for (int dy = 0 ; dy < imageHeight ; ++dy) {
+        for (int dx = 0 ; dx < imageWidth ; ++dx) {
+            int colorIndex = grid.at(dy * imageWidth + dx);
+            int x = useFractionals ? dx / 2 : dx;
+            int y = useFractionals ? dy / 2 : dy;
+
+            if ((colorIndex == -1) || (x >= documentWidth) || (y >= documentHeight)) {
+                continue;   // transparent or odd pixels at the edges of a fractional image
+            }
+
+            int flossIndex = documentFlosses.at(colorIndex);
+
+            if (flossIndex == -1) {
+                flossIndex = flosses.count();
+                qint16 stitchSymbol = symbolIndexes.takeFirst();
+                Qt::PenStyle backstitchSymbol(Qt::SolidLine);
+                Floss *floss = flossScheme->find(QColor(colors.at(colorIndex)));
+
+                DocumentFloss *documentFloss = new DocumentFloss(floss->name(), stitchSymbol, backstitchSymbol, Configuration::palette_StitchStrands(), Configuration::palette_BackstitchStrands());
+                documentFloss->setFlossColor(floss->color());
+                flosses.append(documentFloss);
+                documentFlosses[colorIndex] = flossIndex;
+            }
+
+            StitchQueue *&queue = cellQueues[y * documentWidth + x];
+
+            if (queue == nullptr) {
+                queue = new StitchQueue;
+            }
+
+            if (useFractionals) {
+                int zone = (dy % 2) * 2 + (dx % 2);
+                queue->add(stitchMap[0][zone], flossIndex);
+            } else {
+                queue->add(Stitch::Full, flossIndex);
+            }
+        }
+    }
+
+    for (int i = 0 ; i < cellQueues.count() ; ++i) {
+        if (cellQueues.at(i)) {
+            cells.append(QPoint(i % documentWidth, i / documentWidth));
+            queues.append(cellQueues.at(i));
+        }
+    }
+}
@@ -0,0 +1,178 @@
+/*
+ * Copyright (C) 2010-2022 by Stephen Allewell
+ * steve.allewell@gmail.com
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+
+/** @file
+ * This file defines the conversion of an imported image, already scaled and
+ * mapped to the colors of a floss scheme, into runs of stitches.
+ */
+
+
+#ifndef ImageConverter_H
+#define ImageConverter_H
+
+
+#include <QColor>
+#include <QFuture>
+#include <QImage>
+#include <QList>
+#include <QPoint>
+#include <QSize>
+#include <QString>
+#include <QVector>
+
+// wrap include to silence unused-parameter warning from Magick++ include file
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-parameter"
+#pragma GCC diagnostic ignored "-Wsuggest-override"
+#include <Magick++.h>
+#pragma GCC diagnostic pop
+
+#include "configuration.h"
+
+
+class DocumentFloss;
+class FlossScheme;
+class StitchQueue;
+
+/**
+ * The conversion is done in two stages. The pixels of the ImageMagick image
+ * are exported in one step to a QImage where transparent and ignored pixels
+ * have an alpha value of 0 and all others are opaque. Each row of the QImage
+ * is then reduced to a list of runs of identical colors, the rows being
+ * independent of each other this is done in parallel on a thread pool.
+ */
+class ImageConverter
+{
+public:
+    /**
+     * A run of opaque pixels of the same color in a row of the image.
+     */
+    struct Run {
+        qint32  start;  /**< the column of the first pixel */
+        qint32  length; /**< the number of pixels in the run */
+        QRgb    color;  /**< the color of the pixels */
+    };
+
+    typedef QVector<Run> Runs;
+
+    /**
+     * Load an image to be imported. Images larger than maximumSize in either
+     * direction are reduced after they are read. JPEG images are decoded at a
+     * reduced scale, other formats are decoded at full size first.
+     *
+     * @param source is the path of the image file
+     * @param maximumSize is the largest width or height of the returned image
+     * @param sourceSize is set to the size of the image in the file
+     *
+     * @return a Magick::Image no larger than maximumSize
+     */
+    static Magick::Image load(const QString &source, int maximumSize, QSize &sourceSize);
+
+    /**
+     * Export the pixels of an image unmodified into a QImage in QImage::Format_RGBA8888.
+     *
+     * @param image is the Magick::Image to export
+     *
+     * @return a QImage of the RGBA values of the image
+     */
+    static QImage rgba(Magick::Image image);
+
+    /**
+     * Find the distinct colors of the opaque pixels of an image.
+     *
+     * @param pixels is a QImage in QImage::Format_RGBA8888
+     *
+     * @return a QVector of the colors found
+     */
+    static QVector<QRgb> palette(const QImage &pixels);
+
+    /**
+     * Map each opaque pixel of an image to the nearest color of a palette in Lab
+     * color space, diffusing the error to the neighboring pixels or applying an
+     * ordered threshold depending on the dithering method. Error diffusion uses a
+     * serpentine scan, alternate rows being processed right to left.
+     *
+     * @param pixels is a QImage in QImage::Format_RGBA8888 of the unmapped image
+     * @param palette is the colors that may be used, usually the floss colors
+     * found by palette() in the image mapped without dithering
+     * @param dithering is the dithering method
+     *
+     * @return a QImage in QImage::Format_RGBA8888 using only the palette colors
+     * and retaining the alpha values of pixels
+     */
+    static QImage dither(const QImage &pixels, const QVector<QRgb> &palette, Configuration::EnumImport_Dithering::type dithering);
+
+    /**
+     * Reduce the colors of a sampled image to those of a floss scheme. The image
+     * is quantized to a number of colors which are then mapped to the nearest
+     * colors of the scheme, optionally dithering the sampled image with the
+     * mapped colors.
+     *
+     * @param image is the Magick::Image sampled to the size of the pattern
+     * @param colorMap is the image map of the floss scheme
+     * @param colors is the maximum number of colors
+     * @param dithering is the dithering method
+     *
+     * @return a Magick::Image using only colors of the floss scheme
+     */
+    static Magick::Image mapColors(Magick::Image image, const Magick::Image &colorMap, int colors, Configuration::EnumImport_Dithering::type dithering);
+
+    /**
+     * Export the pixels of an image into a QImage in QImage::Format_RGBA8888.
+     *
+     * @param image is the Magick::Image to export
+     * @param ignoreColor @c true if pixels of ignoreColorValue should be treated as transparent
+     * @param ignoreColorValue is the color to be ignored
+     *
+     * @return a QImage where transparent and ignored pixels have an alpha value of 0
+     */
+    static QImage pixels(Magick::Image image, bool ignoreColor, const Magick::ColorRGB &ignoreColorValue);
+
+    /**
+     * Convert a single row of exported pixels into runs.
+     *
+     * @param pixels is a QImage returned by pixels()
+     * @param row is the row to be converted
+     *
+     * @return the runs of opaque pixels for the row
+     */
+    static Runs convertRow(const QImage &pixels, int row);
+
+    /**
+     * Convert all the rows of the exported pixels in parallel. The progress
+     * of the conversion can be monitored and the conversion canceled with a
+     * QFutureWatcher, the runs for each row are available using resultAt(row).
+     *
+     * @param pixels is a QImage returned by pixels()
+     *
+     * @return a QFuture for the runs of each row
+     */
+    static QFuture<Runs> convert(const QImage &pixels);
+
+    /**
+     * Create the stitches for the converted rows of an image. Small areas of color
+     * are removed if configured, the flosses are created in the order their colors
+     * are first found scanning the rows and are assigned symbols from the default
+     * symbol library.
+     *
+     * @param runs is the runs for each row returned by convert()
+     * @param imageWidth is the width of the converted image
+     * @param useFractionals @c true if each pixel is a quarter of a cell, @c false if it is a cell
+     * @param flossScheme is the FlossScheme the image was mapped to
+     * @param flosses is filled with the new DocumentFloss for each palette index
+     * @param cells is filled with the cells that have stitches
+     * @param queues is filled with a new StitchQueue for each of the cells
+     */
+    static void createStitches(const QList<Runs> &runs, int imageWidth, bool useFractionals, FlossScheme *flossScheme, QList<DocumentFloss *> &flosses, QVector<QPoint> &cells, QVector<StitchQueue *> &queues);
+};
+
+
+#endif // ImageConverter_H
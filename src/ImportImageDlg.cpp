@@ -11,15 +11,15 @@
 
 #include "ImportImageDlg.h"
 
-#include <QApplication>
+#include <QImage>
 #include <QPainter>
-#include <QProgressDialog>
 
 #include <KHelpClient>
 #include <KLocalizedString>
 
 #include "configuration.h"
 #include "FlossScheme.h"
+#include "ImageConverter.h"
 #include "SchemeManager.h"
 #include "SymbolManager.h"
 #include "SymbolLibrary.h"
@@ -47,13 +47,20 @@ const uchar alphaData[] = {
 };
 
 
-ImportImageDlg::ImportImageDlg(QWidget *parent, const Magick::Image &originalImage)
+ImportImageDlg::ImportImageDlg(QWidget *parent, const Magick::Image &originalImage, const QSize &sourceSize)
     :   QDialog(parent),
+        m_sourceScale(1.0),
         m_alphaSelect(nullptr),
         m_originalImage(originalImage)
 {
     ui.setupUi(this);
 
+    // the image may have been reduced whilst loading, sizes shown to the user and
+    // the pattern scale are relative to the size of the image in the source file
+    if (sourceSize.isValid() && m_originalImage.columns()) {
+        m_sourceScale = double(sourceSize.width()) / double(m_originalImage.columns());
+    }
+
     m_crop = QRect(0, 0, m_originalImage.columns(), m_originalImage.rows());
     m_originalSize = QSize(m_crop.width(), m_crop.height());
     updateWindowTitle();
@@ -71,6 +78,7 @@ ImportImageDlg::ImportImageDlg(QWidget *parent, const Magick::Image &originalIma
     ui.CropEnabled->blockSignals(true);
     ui.CropReset->blockSignals(true);
     ui.UseFractionals->blockSignals(true);
+    ui.Dithering->blockSignals(true);
 
     ui.FlossScheme->addItems(SchemeManager::schemes());
     ui.CropReset->setIcon(QIcon::fromTheme(QStringLiteral("edit-undo")));
@@ -92,13 +100,14 @@ ImportImageDlg::ImportImageDlg(QWidget *parent, const Magick::Image &originalIma
     ui.CropEnabled->blockSignals(false);
     ui.CropReset->blockSignals(false);
     ui.UseFractionals->blockSignals(false);
+    ui.Dithering->blockSignals(false);
     connect(ui.ImagePreview, &ScaledPixmapLabel::imageCropped, this, &ImportImageDlg::imageCropped);
 }
 
 
 void ImportImageDlg::updateWindowTitle()
 {
-    QString caption = i18n("Import Image - Image Size %1 x %2 pixels", m_crop.width(), m_crop.height());
+    QString caption = i18n("Import Image - Image Size %1 x %2 pixels", qRound(m_crop.width() * m_sourceScale), qRound(m_crop.height() * m_sourceScale));
     setWindowTitle(caption);
 }
 
@@ -329,6 +338,13 @@ void ImportImageDlg::on_UseFractionals_toggled(bool checked)
 }
 
 
+void ImportImageDlg::on_Dithering_currentIndexChanged(int)
+{
+    killTimer(m_timer);
+    m_timer = startTimer(500);
+}
+
+
 void ImportImageDlg::calculateSizes()
 {
     m_convertedImage = m_originalImage;
@@ -339,7 +355,7 @@ void ImportImageDlg::calculateSizes()
         m_originalSize = QSize(m_convertedImage.columns(), m_convertedImage.rows());
     }
     
-    m_preferredSize = m_originalSize * ui.PatternScale->value() / 100;    
+    m_preferredSize = m_originalSize * m_sourceScale * ui.PatternScale->value() / 100;
     QSize imageSize = m_preferredSize;
 
     if (ui.UseFractionals->isChecked()) {
@@ -373,72 +389,21 @@ void ImportImageDlg::renderPixmap()
     m_pixmap = QPixmap(m_convertedImage.columns(), m_convertedImage.rows());
     m_pixmap.fill();
 
-    m_convertedImage.quantizeColorSpace(Magick::RGBColorspace);
-    m_convertedImage.quantizeColors(ui.UseMaximumColors->isChecked() ?
-                                    std::min(ui.MaximumColors->value(), SymbolManager::library(Configuration::palette_DefaultSymbolLibrary())->indexes().count()) :
-                                    SymbolManager::library(Configuration::palette_DefaultSymbolLibrary())->indexes().count());
-    m_convertedImage.quantize();
-    m_convertedImage.map(m_colorMap);
-    m_convertedImage.modifyImage();
+    m_convertedImage = ImageConverter::mapColors(m_convertedImage,
+                                                 m_colorMap,
+                                                 ui.UseMaximumColors->isChecked() ?
+                                                 std::min(ui.MaximumColors->value(), SymbolManager::library(Configuration::palette_DefaultSymbolLibrary())->indexes().count()) :
+                                                 SymbolManager::library(Configuration::palette_DefaultSymbolLibrary())->indexes().count(),
+                                                 static_cast<Configuration::EnumImport_Dithering::type>(ui.Dithering->currentIndex()));
+
+    QImage preview = ImageConverter::pixels(m_convertedImage, ui.IgnoreColor->isChecked(), m_ignoreColorValue);
 
     QPainter painter;
     painter.begin(&m_pixmap);
     painter.drawTiledPixmap(m_pixmap.rect(), alpha);
-    int width = m_convertedImage.columns();
-    int height = m_convertedImage.rows();
-    int pixelCount = width * height;
-
-    QProgressDialog progress(i18n("Rendering preview"), i18n("Cancel"), 0, pixelCount, this);
-    progress.setWindowModality(Qt::WindowModal);
-
-/*
- * ImageMagick prior to V7 used matte (opacity) to determine if an image has transparency.
- * 0.0 for transparent to 1.0 for opaque
- * 
- * ImageMagick V7 now uses alpha (transparency).
- * 1.0 for transparent to 0.0 for opaque
- * 
- * Access to pixels has changed too, V7 can use pixelColor to access the color of a particular
- * pixel, but although this was available in V6, it doesn't appear to produce the same result
- * and has resulted in black images when importing.
- */
-#if MagickLibVersion < 0x700
-    bool hasTransparency = m_convertedImage.matte();
-    double transparent = 1.0;
-    const Magick::PixelPacket *pixels = m_convertedImage.getConstPixels(0, 0, width, height);
-#else
-    bool hasTransparency = m_convertedImage.alpha();
-    double transparent = 0.0;
-#endif
-    
-    for (int dy = 0 ; dy < height ; dy++) {
-        QApplication::processEvents();
-        progress.setValue(dy * width);
-
-        if (progress.wasCanceled()) {
-            break;
-        }
-
-        for (int dx = 0 ; dx < width ; dx++) {
-#if MagickLibVersion < 0x700
-            Magick::ColorRGB rgb = Magick::Color(*pixels++);
-#else
-            Magick::ColorRGB rgb = m_convertedImage.pixelColor(dx, dy);
-#endif
-
-            if (hasTransparency && (rgb.alpha() == transparent)) {
-                //ignore this pixel as it is transparent
-            } else {
-                if (!(ui.IgnoreColor->isChecked() && rgb == m_ignoreColorValue)) {
-                    QColor color((int)(255*rgb.red()), (int)(255*rgb.green()), (int)(255*rgb.blue()));
-                    painter.setPen(QPen(color));
-                    painter.drawPoint(dx, dy);
-                }
-            }
-        }
-    }
-
+    painter.drawImage(0, 0, preview);
     painter.end();
+
     ui.ImagePreview->setPixmap(m_pixmap);
     ui.ImagePreview->setCursor(Qt::ArrowCursor);
 }
@@ -592,8 +557,8 @@ void ImportImageDlg::resetImportParameters()
         break;
     }
 
-    int scaledWidth = m_preferredSize.width() * 100 / m_originalSize.width();
-    int scaledHeight = m_preferredSize.height() * 100 / m_originalSize.height();
+    int scaledWidth = m_preferredSize.width() * 100 / (m_originalSize.width() * m_sourceScale);
+    int scaledHeight = m_preferredSize.height() * 100 / (m_originalSize.height() * m_sourceScale);
     int scale = std::min(scaledWidth, scaledHeight);
     
     QString scheme = Configuration::palette_DefaultScheme();
@@ -604,6 +569,7 @@ void ImportImageDlg::resetImportParameters()
 
     ui.FlossScheme->setCurrentItem(scheme);
     ui.PatternScale->setValue(scale);
+    ui.Dithering->setCurrentIndex(Configuration::import_Dithering());
     ui.UseMaximumColors->setChecked(Configuration::import_UseMaximumColors());
     ui.MaximumColors->setEnabled(ui.UseMaximumColors->isChecked());
     ui.MaximumColors->setValue(Configuration::import_MaximumColors());
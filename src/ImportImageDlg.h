@@ -41,7 +41,7 @@ class ImportImageDlg : public QDialog
     Q_OBJECT
 
 public:
-    ImportImageDlg(QWidget *, const Magick::Image &);
+    ImportImageDlg(QWidget *, const Magick::Image &, const QSize &sourceSize = QSize());
     virtual ~ImportImageDlg() = default;
 
     Magick::Image convertedImage() const;
@@ -72,6 +72,7 @@ private slots:
     void on_CropReset_clicked(bool);
     void imageCropped(const QRectF &rectF);
     void on_UseFractionals_toggled(bool);
+    void on_Dithering_currentIndexChanged(int);
     void selectColor(const QPoint &);
     void on_DialogButtonBox_accepted();
     void on_DialogButtonBox_rejected();
@@ -92,6 +93,7 @@ private:
     QPixmap     m_pixmap;
     QSize       m_originalSize;
     QSize       m_preferredSize;
+    double      m_sourceScale;
     int         m_timer;
     AlphaSelect *m_alphaSelect;
     Magick::ColorRGB    m_ignoreColorValue;
@@ -0,0 +1,764 @@
+/*
+ * Copyright (C) 2010-2022 by Stephen Allewell
+ * steve.allewell@gmail.com
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+
+/** @file
+ * This file implements the crash recovery journal kept for each open document.
+ */
+
+
+// Class include
+#include "Journal.h"
+
+// Qt includes
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QLockFile>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QUndoStack>
+#include <QUuid>
+
+// KDE includes
+#include <KLocalizedString>
+
+// Application includes
+#include "BackgroundImage.h"
+#include "Document.h"
+#include "Exceptions.h"
+
+
+/**
+ * The open journal file. This is only used on the writer thread, the writes
+ * being queued to it in the order they were made.
+ */
+class JournalFile
+{
+public:
+    /**
+     * Replace the journal with a new one, written atomically so an existing
+     * journal remains valid until the new one is complete.
+     *
+     * @param path is the path of the journal
+     * @param data is the header and first record
+     */
+    void create(const QString &path, const QByteArray &data)
+    {
+        m_file.close();
+
+        QSaveFile file(path);
+
+        if (file.open(QIODevice::WriteOnly) && (file.write(data) == data.size()) && file.commit()) {
+            m_file.setFileName(path);
+            m_file.open(QIODevice::WriteOnly | QIODevice::Append);
+        }
+    }
+
+    /**
+     * Append records to the journal. If the journal could not be created the
+     * records are discarded, the journal is not essential to editing.
+     *
+     * @param data is the records to append
+     */
+    void append(const QByteArray &data)
+    {
+        if (m_file.isOpen()) {
+            m_file.write(data);
+            m_file.flush();
+        }
+    }
+
+    /**
+     * Close and delete the journal.
+     *
+     * @param path is the path of the journal
+     */
+    void remove(const QString &path)
+    {
+        m_file.close();
+        QFile::remove(path);
+    }
+
+private:
+    QFile   m_file;
+};
+
+
+Journal::Journal(Document *document, QObject *parent)
+    :   QObject(parent),
+        m_document(document),
+        m_writer(new QObject),
+        m_file(new JournalFile),
+        m_lock(nullptr),
+        m_base(false),
+        m_appended(0)
+{
+    m_recoveryPath = QString::fromLatin1("%1/recovery/%2.journal").arg(QStandardPaths::writableLocation(QStandardPaths::DataLocation)).arg(QString::fromLatin1(QUuid::createUuid().toRfc4122().toHex()));
+
+    m_timer.setSingleShot(true);
+    m_timer.setInterval(batchInterval);
+    connect(&m_timer, &QTimer::timeout, this, &Journal::flush);
+
+    m_writer->moveToThread(&m_thread);
+    connect(&m_thread, &QThread::finished, m_writer, &QObject::deleteLater);
+    m_thread.start(QThread::LowPriority);
+}
+
+
+Journal::~Journal()
+{
+    close();
+    unlock();
+
+    // stop the writer once the outstanding writes and the removal are done
+    QMetaObject::invokeMethod(m_writer, []() {
+        QThread::currentThread()->quit();
+    }, Qt::QueuedConnection);
+    m_thread.wait();
+
+    delete m_file;
+}
+
+
+QString Journal::path(const QUrl &url)
+{
+    if (!url.isLocalFile()) {
+        return QString();
+    }
+
+    QFileInfo fileInfo(url.toLocalFile());
+
+    return QString::fromLatin1("%1/.%2.journal").arg(fileInfo.absolutePath()).arg(fileInfo.fileName());
+}
+
+
+bool Journal::isRecoverable(const QString &path)
+{
+    if (path.isEmpty() || !QFile::exists(path)) {
+        return false;
+    }
+
+    // a lock left by a process that no longer exists is removed by tryLock
+    QLockFile lock(path + QLatin1String(".lock"));
+
+    return lock.tryLock(0);
+}
+
+
+QStringList Journal::orphans()
+{
+    QStringList paths;
+
+    QDir dir(QString::fromLatin1("%1/recovery").arg(QStandardPaths::writableLocation(QStandardPaths::DataLocation)));
+    const QStringList journals = dir.entryList(QStringList() << QStringLiteral("*.journal"), QDir::Files, QDir::Time);
+
+    for (const QString &journal : journals) {
+        QString path = dir.absoluteFilePath(journal);
+
+        if (isRecoverable(path)) {
+            paths.append(path);
+        }
+    }
+
+    return paths;
+}
+
+
+void Journal::reset()
+{
+    m_timer.stop();
+    close();
+
+    // the document has just been read from or written to the url so changes can be
+    // recorded against the saved file, unless it is not clean or the save failed
+    m_base = m_document->url().isLocalFile();
+    m_appended = 0;
+
+    m_palette = paletteData();
+    m_properties = propertiesData();
+    m_backgroundImages = backgroundImagesData();
+    m_document->takePrinterConfigurationModified();
+
+    QVector<QPoint> cells;
+    bool lines;
+    QVector<StitchData::LineChange> lineChanges;
+    m_document->pattern()->stitches().takeModifications(cells, lines, lineChanges);
+
+    if (!m_document->undoStack().isClean()) {
+        checkpoint();
+    }
+}
+
+
+void Journal::recover(const QString &path)
+{
+    QFile file(path);
+
+    if (!file.open(QIODevice::ReadOnly)) {
+        throw FailedReadFile(file.errorString());
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_4_0);
+
+    char magic[15];
+    qint32 journalVersion;
+    QUrl url;
+
+    if ((stream.readRawData(magic, 15) != 15) || (strncmp(magic, "KXStitchJournal", 15) != 0)) {
+        throw FailedReadFile(QString(i18n("The recovery file is not valid")));
+    }
+
+    stream >> journalVersion;
+
+    if (journalVersion != version) {
+        throw InvalidFileVersion(QString(i18n("Journal version %1", journalVersion)));
+    }
+
+    stream >> url;
+
+    QString damaged;
+
+    while (!stream.atEnd()) {
+        qint32 type;
+        QByteArray payload;
+
+        stream >> type >> payload;
+
+        if (stream.status() != QDataStream::Ok) {
+            break; // the last record was not completely written
+        }
+
+        try {
+            apply(type, payload);
+        } catch (const InvalidFile &e) {
+            break;
+        } catch (const InvalidFileVersion &e) {
+            break;
+        } catch (const FailedReadFile &e) {
+            damaged = e.status;
+            break;
+        }
+    }
+
+    file.close();
+    QFile::remove(path);
+
+    // the recovered changes have not been saved
+    m_document->setUrl(url);
+    m_document->undoStack().resetClean();
+
+    // the changes before a record that could not be read are kept, but the rest are lost
+    if (!damaged.isEmpty()) {
+        throw FailedReadFile(damaged);
+    }
+}
+
+
+void Journal::schedule()
+{
+    if (!m_timer.isActive()) {
+        m_timer.start();
+    }
+}
+
+
+void Journal::flush()
+{
+    m_timer.stop();
+
+    if (m_document->undoStack().isClean()) {
+        // back to the saved state, there is nothing to recover
+        reset();
+        return;
+    }
+
+    StitchData &stitches = m_document->pattern()->stitches();
+    QVector<QPoint> cells;
+    bool lines;
+    QVector<StitchData::LineChange> lineChanges;
+    bool partial = stitches.takeModifications(cells, lines, lineChanges);
+    bool printerConfiguration = m_document->takePrinterConfigurationModified();
+
+    // changes that are rare or can not be described by the records are checkpointed
+    if ((m_path.isEmpty() && !m_base) || !partial || (m_appended > checkpointSize) || printerConfiguration || (backgroundImagesData() != m_backgroundImages)) {
+        checkpoint();
+        return;
+    }
+
+    if (m_path.isEmpty()) {
+        if (!open()) {
+            return;
+        }
+
+        if (!m_base) {
+            // the journal next to the file is in use by another window
+            checkpoint();
+            return;
+        }
+
+        QByteArray data = header() + record(BaseRecord, QByteArray());
+        QString path = m_path;
+        JournalFile *file = m_file;
+        QMetaObject::invokeMethod(m_writer, [file, path, data]() {
+            file->create(path, data);
+        }, Qt::QueuedConnection);
+    }
+
+    QByteArray records;
+
+    if (!cells.isEmpty()) {
+        QByteArray payload;
+        QDataStream stream(&payload, QIODevice::WriteOnly);
+        stream.setVersion(QDataStream::Qt_4_0);
+        stream << qint32(cells.count());
+
+        for (const QPoint &cell : cells) {
+            StitchQueue *stitchQueue = stitches.stitchQueueAt(cell);
+            stream << cell;
+
+            if (stitchQueue) {
+                stream << *stitchQueue;
+            } else {
+                stream << StitchQueue();
+            }
+        }
+
+        records += record(CellsRecord, payload);
+    }
+
+    if (lines) {
+        QByteArray payload;
+        QDataStream stream(&payload, QIODevice::WriteOnly);
+        stream.setVersion(QDataStream::Qt_4_0);
+        stream << qint32(stitches.backstitches().count());
+
+        for (const Backstitch *backstitch : stitches.backstitches()) {
+            stream << *backstitch;
+        }
+
+        stream << qint32(stitches.knots().count());
+
+        for (const Knot *knot : stitches.knots()) {
+            stream << *knot;
+        }
+
+        records += record(LinesRecord, payload);
+    } else if (!lineChanges.isEmpty()) {
+        QByteArray payload;
+        QDataStream stream(&payload, QIODevice::WriteOnly);
+        stream.setVersion(QDataStream::Qt_4_0);
+        stream << qint32(lineChanges.count());
+
+        for (const StitchData::LineChange &change : lineChanges) {
+            stream << qint32(change.type);
+
+            if ((change.type == StitchData::LineChange::AddBackstitch) || (change.type == StitchData::LineChange::RemoveBackstitch)) {
+                stream << change.backstitch;
+            } else {
+                stream << change.knot;
+            }
+        }
+
+        records += record(LineChangesRecord, payload);
+    }
+
+    QByteArray palette = paletteData();
+
+    if (palette != m_palette) {
+        records += record(PaletteRecord, palette);
+        m_palette = palette;
+    }
+
+    QByteArray properties = propertiesData();
+
+    if (properties != m_properties) {
+        records += record(PropertiesRecord, properties);
+        m_properties = properties;
+    }
+
+    if (!records.isEmpty()) {
+        append(records);
+    }
+}
+
+
+bool Journal::open()
+{
+    QString sidecar = path(m_document->url());
+
+    if (!sidecar.isEmpty() && lock(sidecar)) {
+        m_path = sidecar;
+        return true;
+    }
+
+    m_base = false;
+    QDir().mkpath(QFileInfo(m_recoveryPath).absolutePath());
+
+    if (lock(m_recoveryPath)) {
+        m_path = m_recoveryPath;
+        return true;
+    }
+
+    return false;
+}
+
+
+// the lock is kept when a journal is closed, so it is reused if the next journal has the same path
+bool Journal::lock(const QString &path)
+{
+    if (m_lock && (m_lockPath == path)) {
+        return true;
+    }
+
+    QLockFile *lock = new QLockFile(path + QLatin1String(".lock"));
+
+    if (!lock->tryLock(0)) {
+        delete lock;
+        return false;
+    }
+
+    unlock();
+    m_lock = lock;
+    m_lockPath = path;
+
+    return true;
+}
+
+
+// the lock is released on the writer thread after the queued removal of the journal it protects
+void Journal::unlock()
+{
+    if (m_lock) {
+        QLockFile *lock = m_lock;
+
+        QMetaObject::invokeMethod(m_writer, [lock]() {
+            delete lock;
+        }, Qt::QueuedConnection);
+
+        m_lock = nullptr;
+        m_lockPath.clear();
+    }
+}
+
+
+void Journal::apply(qint32 type, const QByteArray &payload)
+{
+    QDataStream stream(payload);
+    stream.setVersion(QDataStream::Qt_4_0);
+
+    StitchData &stitches = m_document->pattern()->stitches();
+
+    // each record is read completely before it is applied so a damaged record leaves the document unchanged
+    switch (type) {
+    case BaseRecord:
+        // the document has already been read from the saved file
+        break;
+
+    case CheckpointRecord:
+        m_document->readKXStitch(stream);
+        break;
+
+    case CellsRecord: {
+        qint32 count;
+        QVector<QPoint> cells;
+        QVector<StitchQueue *> queues;
+
+        stream >> count;
+
+        try {
+            while ((count-- > 0) && (stream.status() == QDataStream::Ok)) {
+                QPoint cell;
+                StitchQueue *stitchQueue = new StitchQueue;
+                queues.append(stitchQueue);
+                stream >> cell >> *stitchQueue;
+                cells.append(cell);
+            }
+        } catch (const InvalidFileVersion &e) {
+            qDeleteAll(queues);
+            throw;
+        }
+
+        if (stream.status() != QDataStream::Ok) {
+            qDeleteAll(queues);
+            throw FailedReadFile(stream.status());
+        }
+
+        for (int i = 0 ; i < cells.count() ; ++i) {
+            StitchQueue *stitchQueue = queues.at(i);
+
+            if ((cells.at(i).x() < 0) || (cells.at(i).x() >= stitches.width()) || (cells.at(i).y() < 0) || (cells.at(i).y() >= stitches.height()) || stitchQueue->isEmpty()) {
+                delete stitchQueue;
+                stitchQueue = nullptr;
+            }
+
+            delete stitches.replaceStitchQueueAt(cells.at(i), stitchQueue);
+        }
+
+        break;
+    }
+
+    case LinesRecord: {
+        qint32 count;
+        QList<Backstitch *> backstitches;
+        QList<Knot *> knots;
+
+        stream >> count;
+
+        while ((count-- > 0) && (stream.status() == QDataStream::Ok)) {
+            Backstitch *backstitch = new Backstitch;
+            backstitches.append(backstitch);
+            stream >> *backstitch;
+        }
+
+        stream >> count;
+
+        while ((count-- > 0) && (stream.status() == QDataStream::Ok)) {
+            Knot *knot = new Knot;
+            knots.append(knot);
+            stream >> *knot;
+        }
+
+        if (stream.status() != QDataStream::Ok) {
+            qDeleteAll(backstitches);
+            qDeleteAll(knots);
+            throw FailedReadFile(stream.status());
+        }
+
+        stitches.replaceLines(backstitches, knots);
+        break;
+    }
+
+    case LineChangesRecord: {
+        qint32 count;
+        QVector<StitchData::LineChange> changes;
+
+        stream >> count;
+
+        while ((count-- > 0) && (stream.status() == QDataStream::Ok)) {
+            StitchData::LineChange change;
+            qint32 changeType;
+            stream >> changeType;
+            change.type = static_cast<StitchData::LineChange::Type>(changeType);
+
+            if ((change.type == StitchData::LineChange::AddBackstitch) || (change.type == StitchData::LineChange::RemoveBackstitch)) {
+                stream >> change.backstitch;
+            } else if ((change.type == StitchData::LineChange::AddKnot) || (change.type == StitchData::LineChange::RemoveKnot)) {
+                stream >> change.knot;
+            } else {
+                throw InvalidFile();
+            }
+
+            changes.append(change);
+        }
+
+        if (stream.status() != QDataStream::Ok) {
+            throw FailedReadFile(stream.status());
+        }
+
+        for (const StitchData::LineChange &change : changes) {
+            switch (change.type) {
+            case StitchData::LineChange::AddBackstitch:
+                stitches.addBackstitch(new Backstitch(change.backstitch));
+                break;
+
+            case StitchData::LineChange::RemoveBackstitch:
+                for (Backstitch *backstitch : stitches.backstitches()) {
+                    if ((backstitch->start == change.backstitch.start) && (backstitch->end == change.backstitch.end) && (backstitch->colorIndex == change.backstitch.colorIndex)) {
+                        delete stitches.takeBackstitch(backstitch);
+                        break;
+                    }
+                }
+
+                break;
+
+            case StitchData::LineChange::AddKnot:
+                stitches.addFrenchKnot(new Knot(change.knot));
+                break;
+
+            case StitchData::LineChange::RemoveKnot:
+                delete stitches.takeFrenchKnot(change.knot.position, change.knot.colorIndex);
+                break;
+            }
+        }
+
+        break;
+    }
+
+    case PaletteRecord: {
+        DocumentPalette palette;
+        stream >> palette;
+
+        if (stream.status() != QDataStream::Ok) {
+            throw FailedReadFile(stream.status());
+        }
+
+        m_document->pattern()->palette() = palette;
+        break;
+    }
+
+    case PropertiesRecord: {
+        QMap<QString, QVariant> properties;
+        stream >> properties;
+
+        if (stream.status() != QDataStream::Ok) {
+            throw FailedReadFile(stream.status());
+        }
+
+        for (auto it = properties.constBegin() ; it != properties.constEnd() ; ++it) {
+            m_document->setProperty(it.key(), it.value());
+        }
+
+        break;
+    }
+
+    default:
+        throw InvalidFile();
+        break;
+    }
+}
+
+
+void Journal::checkpoint()
+{
+    m_timer.stop();
+
+    if (m_path.isEmpty() && !open()) {
+        return;
+    }
+
+    QVector<QPoint> cells;
+    bool lines;
+    QVector<StitchData::LineChange> lineChanges;
+    m_document->pattern()->stitches().takeModifications(cells, lines, lineChanges);
+
+    m_appended = 0;
+    m_palette = paletteData();
+    m_properties = propertiesData();
+    m_backgroundImages = backgroundImagesData();
+    m_document->takePrinterConfigurationModified();
+
+    try {
+        // the snapshot shares the encoded rows and lines with the stitch data, so only the rows
+        // changed since the last snapshot are encoded here, compressing and writing them is done
+        // on the writer thread
+        DocumentSnapshot snapshot = m_document->snapshot();
+        QByteArray head = header();
+        QString path = m_path;
+        JournalFile *file = m_file;
+
+        QMetaObject::invokeMethod(m_writer, [file, path, head, snapshot]() {
+            QByteArray payload;
+            QDataStream stream(&payload, QIODevice::WriteOnly);
+
+            try {
+                snapshot.write(stream);
+                file->create(path, head + record(CheckpointRecord, payload));
+            } catch (const FailedWriteFile &e) {
+                file->remove(path);
+            }
+        }, Qt::QueuedConnection);
+    } catch (const FailedWriteFile &e) {
+        // try again on the next change
+        m_document->pattern()->stitches().setModified();
+    }
+}
+
+
+void Journal::close()
+{
+    if (!m_path.isEmpty()) {
+        QString path = m_path;
+        JournalFile *file = m_file;
+
+        // the lock is still held, it is only released by unlock after this has been done
+        QMetaObject::invokeMethod(m_writer, [file, path]() {
+            file->remove(path);
+        }, Qt::QueuedConnection);
+
+        m_path.clear();
+    }
+}
+
+
+void Journal::append(const QByteArray &records)
+{
+    JournalFile *file = m_file;
+    m_appended += records.size();
+
+    QMetaObject::invokeMethod(m_writer, [file, records]() {
+        file->append(records);
+    }, Qt::QueuedConnection);
+}
+
+
+QByteArray Journal::header() const
+{
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_4_0);
+    stream.writeRawData("KXStitchJournal", 15);
+    stream << qint32(version);
+    stream << m_document->url();
+
+    return data;
+}
+
+
+QByteArray Journal::paletteData() const
+{
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_4_0);
+    stream << m_document->pattern()->palette();
+
+    return data;
+}
+
+
+QByteArray Journal::propertiesData() const
+{
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_4_0);
+    stream << m_document->properties();
+
+    return data;
+}
+
+
+QByteArray Journal::backgroundImagesData() const
+{
+    // the image data can not change, only which images are used and how
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_4_0);
+    QListIterator<QSharedPointer<BackgroundImage>> backgroundImages = m_document->backgroundImages().backgroundImages();
+
+    while (backgroundImages.hasNext()) {
+        QSharedPointer<BackgroundImage> backgroundImage = backgroundImages.next();
+        stream << backgroundImage->url() << backgroundImage->location() << backgroundImage->isVisible();
+    }
+
+    return data;
+}
+
+
+QByteArray Journal::record(Record type, const QByteArray &payload)
+{
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_4_0);
+    stream << qint32(type) << payload;
+
+    return data;
+}
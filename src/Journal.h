@@ -0,0 +1,183 @@
+/*
+ * Copyright (C) 2010-2022 by Stephen Allewell
+ * steve.allewell@gmail.com
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+
+/** @file
+ * This file defines the crash recovery journal kept for each open document.
+ */
+
+
+#ifndef Journal_H
+#define Journal_H
+
+
+#include <QByteArray>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QThread>
+#include <QTimer>
+#include <QUrl>
+
+
+class QLockFile;
+
+class Document;
+class JournalFile;
+
+
+/**
+ * The journal is an append only file recording the changes made to a document
+ * since it was last saved, allowing the changes to be recovered if the
+ * application terminates unexpectedly.
+ *
+ * Changes are batched, when the undo stack changes a timer is started and when
+ * it expires the cells, lines, palette and properties changed since the last
+ * flush are appended as records, lines being recorded as the backstitches and
+ * knots added and removed. The records are encoded on the GUI thread, this
+ * being proportional to the size of the change, and written to the file on a
+ * dedicated thread so writing never delays editing.
+ *
+ * The journal starts with either a base record, meaning the changes apply to
+ * the saved file, or a checkpoint record holding the complete document. A new
+ * checkpoint replaces the journal when a change can not be described by the
+ * records, such as resizing the pattern or changing the printer configuration,
+ * or when enough records have been appended that replaying them would be slower
+ * than reading a checkpoint.
+ *
+ * The journal of a saved local document is kept next to the document, others
+ * are kept in the recovery folder of the application data. A lock file marks
+ * a journal that is in use so it will not be offered for recovery.
+ */
+class Journal : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * Constructor.
+     *
+     * @param document is a pointer to the Document to be journaled
+     * @param parent is a pointer to the parent QObject
+     */
+    explicit Journal(Document *document, QObject *parent = nullptr);
+
+    /**
+     * Destructor. Waits for outstanding writes and removes the journal, this
+     * is only called when the document has been saved or changes discarded.
+     */
+    virtual ~Journal();
+
+    /**
+     * Get the path of the journal for a saved document.
+     *
+     * @param url is the QUrl of the document
+     *
+     * @return the path of the journal, an empty string if the url is not a local file
+     */
+    static QString path(const QUrl &url);
+
+    /**
+     * Test if a journal exists and is not in use by another window or instance.
+     *
+     * @param path is the path of the journal
+     *
+     * @return @c true if the journal can be recovered, @c false otherwise
+     */
+    static bool isRecoverable(const QString &path);
+
+    /**
+     * Find the journals of unsaved or remote documents left by an earlier
+     * instance of the application.
+     *
+     * @return a QStringList of the paths of the recoverable journals
+     */
+    static QStringList orphans();
+
+    /**
+     * Start a new journal for the current state of the document, called when
+     * a document has been opened, saved or recovered. Any existing journal is
+     * removed, if the document has unsaved changes a checkpoint is written.
+     */
+    void reset();
+
+    /**
+     * Apply a journal to the document. If the journal starts with a base record
+     * the document should have been read from the file the journal belongs to.
+     * Records are applied until the end of the file or the first incomplete
+     * record which may be the result of the application terminating while it
+     * was being written. The journal is removed afterwards.
+     *
+     * @param path is the path of the journal
+     */
+    void recover(const QString &path);
+
+public slots:
+    /**
+     * Start the timer to batch the changes made to the document.
+     */
+    void schedule();
+
+    /**
+     * Append the changes made to the document since the last flush.
+     */
+    void flush();
+
+private:
+    enum Record {
+        BaseRecord = 1,
+        CheckpointRecord,
+        CellsRecord,
+        LinesRecord,
+        PaletteRecord,
+        PropertiesRecord,
+        LineChangesRecord
+    };
+
+    bool open();
+    bool lock(const QString &);
+    void unlock();
+    void apply(qint32, const QByteArray &);
+    void checkpoint();
+    void close();
+    void append(const QByteArray &);
+    QByteArray header() const;
+    QByteArray paletteData() const;
+    QByteArray propertiesData() const;
+    QByteArray backgroundImagesData() const;
+
+    static QByteArray record(Record, const QByteArray &);
+
+    static const int version = 101;
+    static const int batchInterval = 1000;              /**< milliseconds between flushes */
+    static const int checkpointSize = 1024 * 1024;      /**< bytes appended before a new checkpoint */
+
+    Document    *m_document;
+
+    QTimer      m_timer;
+    QThread     m_thread;
+    QObject     *m_writer;      /**< the context for the writes, living on m_thread */
+    JournalFile *m_file;        /**< only used on m_thread */
+    QLockFile   *m_lock;
+    QString     m_lockPath;     /**< the path of the journal m_lock is for */
+
+    QString     m_path;         /**< the path of the journal, empty if not yet written */
+    QString     m_recoveryPath; /**< the path used for unsaved documents */
+    bool        m_base;         /**< @c true if the saved file can be used as the base */
+    int         m_appended;     /**< the number of bytes appended since the last checkpoint */
+
+    // the last journaled values of the parts of the document only compared
+    QByteArray  m_palette;
+    QByteArray  m_properties;
+    QByteArray  m_backgroundImages;
+};
+
+
+#endif // Journal_H
@@ -11,22 +11,31 @@
 
 #include "LibraryFile.h"
 
+#include <QBuffer>
+#include <QCryptographicHash>
 #include <QDataStream>
+#include <QDateTime>
+#include <QDir>
 #include <QFile>
 #include <QFileInfo>
-#include <QProgressDialog>
+#include <QSaveFile>
+#include <QStandardPaths>
 
 #include <KLocalizedString>
 #include <KMessageBox>
 
 #include <stdlib.h>
 
+#include "Exceptions.h"
 #include "LibraryPattern.h"
+#include "Pattern.h"
 
 
 LibraryFile::LibraryFile(const QString &path)
     :   m_read(false),
-        m_path(path)
+        m_path(path),
+        m_fileSize(-1),
+        m_fileModified(-1)
 {
     m_exists = QFile::exists(localFile());
 }
@@ -96,14 +105,64 @@ LibraryPattern *LibraryFile::next()
 }
 
 
+QByteArray LibraryFile::readPatternData(qint64 offset, qint32 size) const
+{
+    return readPatternData(localFile(), offset, size);
+}
+
+
+// this does not use the library file object, so the data may be read on a worker thread
+QByteArray LibraryFile::readPatternData(const QString &localFile, qint64 offset, qint32 size)
+{
+    QFile file(localFile);
+
+    if (file.open(QIODevice::ReadOnly) && file.seek(offset)) {
+        return file.read(size);
+    }
+
+    return QByteArray();
+}
+
+
 void LibraryFile::readFile()
 {
+    QString error = read();
+
+    if (!error.isEmpty()) {
+        KMessageBox::error(nullptr, error, i18n("Failed to read library."));
+    }
+}
+
+
+// read the list of patterns, this does not use the user interface so a library
+// file may be read on a worker thread before it is shared, returning an error
+// message or an empty QString if the library was read
+QString LibraryFile::read()
+{
+    QString error;
+
+    if (m_read) {
+        return error;
+    }
+
+    m_read = true;
+    updateFileState();
+
     if (m_exists) {
+        // the patterns are listed from the index and decoded when they are first used
+        if (readIndex()) {
+            return error;
+        }
+
         bool ok = true;
         QFile file(localFile());
 
         if (file.open(QIODevice::ReadOnly)) {
-            QDataStream stream(&file);
+            // the encoded patterns are hashed for the index, so the whole file is read
+            QByteArray contents = file.readAll();
+            QBuffer buffer(&contents);
+            buffer.open(QIODevice::ReadOnly);
+            QDataStream stream(&buffer);
             char header[11];
             stream.readRawData(header, 11);
 
@@ -118,22 +177,16 @@ void LibraryFile::readFile()
                 QByteArray data;
                 LibraryPattern *libraryPattern;
 
-                QProgressDialog progress(nullptr);
-                progress.setLabelText(i18n("Loading Library %1", file.fileName()));
-
                 stream >> version;
 
                 switch (version) {
                 case 1:
-                    progress.setRange(file.pos(), file.size());
-                    progress.setValue(0);
-                    progress.show();
-
-                    while (!file.atEnd() && ok) {
+                    while (!buffer.atEnd() && ok) {
                         stream >> key;
                         stream >> modifier;
                         stream >> baseline;
                         stream >> checksum; // no longer used
+                        qint64 offset = buffer.pos() + 4;   // following the length of the data
                         stream >> data;
                         Qt::KeyboardModifiers replacedModifiers;
 
@@ -154,28 +207,41 @@ void LibraryFile::readFile()
                         }
 
                         if (checksum == qChecksum(data.data(), data.size())) {
-                            m_libraryPatterns.append(new LibraryPattern(data, key, replacedModifiers, baseline));
+                            libraryPattern = new LibraryPattern(data, key, replacedModifiers, baseline);
+                            libraryPattern->m_libraryFile = this;
+                            libraryPattern->m_offset = offset;
+                            libraryPattern->m_size = data.size();
+                            libraryPattern->m_hash = QCryptographicHash::hash(data, QCryptographicHash::Sha1);
+                            m_libraryPatterns.append(libraryPattern);
                         } else {
-                            KMessageBox::error(nullptr, i18n("Failed to read a pattern from the library %1.\n%2", localFile(), file.errorString()), i18n("Failed to read library."));
+                            error = i18n("Failed to read a pattern from the library %1.\n%2", localFile(), file.errorString());
                             ok = false;
                         }
-
-                        progress.setValue(file.pos());
                     }
 
                     break;
 
                 case 100:
                     stream >> count;
-                    progress.setRange(0, count);
-                    progress.setValue(0);
-                    progress.show();
 
                     while (count--) {
+                        qint64 offset = buffer.pos() + LibraryPattern::headerSize;
                         libraryPattern = new LibraryPattern;
-                        stream >> *libraryPattern;
+
+                        try {
+                            stream >> *libraryPattern;
+                        } catch (const FailedReadFile &e) {
+                            delete libraryPattern;
+                            error = i18n("Failed to read a pattern from the library %1.\n%2", localFile(), e.status);
+                            ok = false;
+                            break;
+                        }
+
+                        libraryPattern->m_libraryFile = this;
+                        libraryPattern->m_offset = offset;
+                        libraryPattern->m_size = buffer.pos() - offset;
+                        libraryPattern->m_hash = QCryptographicHash::hash(contents.mid(offset, libraryPattern->m_size), QCryptographicHash::Sha1);
                         m_libraryPatterns.append(libraryPattern);
-                        progress.setValue(progress.value() + 1);
                     }
 
                     break;
@@ -188,31 +254,61 @@ void LibraryFile::readFile()
             }
 
             file.close();
-            m_read = true;
+
+            if (ok) {
+                writeIndex();
+            }
         } else {
-            KMessageBox::error(nullptr, i18n("The file %1\ncould not be opened for reading.\n%2", localFile(), file.errorString()), i18n("Error opening file"));
+            error = i18n("The file %1\ncould not be opened for reading.\n%2", localFile(), file.errorString());
         }
     }
+
+    return error;
 }
 
 
 void LibraryFile::writeFile()
 {
-    QFile file(localFile());
+    // the existing file is replaced when the new one is complete, so patterns that
+    // have not been decoded can be copied from it as they are written
+    QSaveFile file(localFile());
 
-    if (file.open(QIODevice::WriteOnly)) { // truncates the file
+    if (file.open(QIODevice::WriteOnly)) {
         QDataStream stream(&file);
         stream.writeRawData("KXStitchLib", 11);
         stream << qint16(version);
         stream << qint32(m_libraryPatterns.count());
-        QListIterator<LibraryPattern *> iterator(m_libraryPatterns);
 
-        while (iterator.hasNext()) {
-            LibraryPattern *libraryPattern = iterator.next();
-            stream << *libraryPattern;
+        QList<qint64> offsets;
+        QList<QByteArray> records;
+
+        foreach (LibraryPattern *libraryPattern, m_libraryPatterns) {
+            QByteArray record;
+            QDataStream recordStream(&record, QIODevice::WriteOnly);
+            recordStream << *libraryPattern;
+
+            offsets.append(file.pos() + LibraryPattern::headerSize);
+            records.append(record);
+            stream.writeRawData(record.constData(), record.size());
+        }
+
+        if (file.commit()) {
+            for (int i = 0 ; i < m_libraryPatterns.count() ; ++i) {
+                LibraryPattern *libraryPattern = m_libraryPatterns.at(i);
+                libraryPattern->m_libraryFile = this;
+                libraryPattern->m_offset = offsets.at(i);
+                libraryPattern->m_size = records.at(i).size() - LibraryPattern::headerSize;
+                libraryPattern->m_fileVersion = LibraryPattern::version;
+                libraryPattern->m_hash = QCryptographicHash::hash(records.at(i).mid(LibraryPattern::headerSize), QCryptographicHash::Sha1);
+            }
+
+            m_exists = true;
+            updateFileState();
+            writeIndex();
+        } else {
+            KMessageBox::error(nullptr, i18n("The file %1\ncould not be written.\n%2", localFile(), file.errorString()), i18n("Error writing file"));
         }
 
-        file.close();
         m_read = true;
     } else {
         KMessageBox::error(nullptr, i18n("The file %1\ncould not be opened for writing.\n%2", localFile(), file.errorString()), i18n("Error opening file"));
@@ -232,6 +328,117 @@ QString LibraryFile::localFile() const
 }
 
 
+// the index is kept in the cache as the library directories may not be writable
+QString LibraryFile::indexFile() const
+{
+    QString name = QString::fromLatin1(QCryptographicHash::hash(localFile().toUtf8(), QCryptographicHash::Sha1).toHex());
+
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + QLatin1String("/library/") + name + QLatin1String(".index");
+}
+
+
+// list the patterns from the index, returning false if there is no index or the
+// library has been changed since it was written
+bool LibraryFile::readIndex()
+{
+    QFile file(indexFile());
+
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QFileInfo library(localFile());
+    QDataStream stream(&file);
+    char header[11];
+    qint16 version;
+    qint64 size;
+    qint64 modified;
+    qint32 count;
+
+    stream.readRawData(header, 11);
+
+    if (strncmp(header, "KXStitchIdx", 11) != 0) {
+        return false;
+    }
+
+    stream >> version;
+    stream >> size;
+    stream >> modified;
+    stream >> count;
+
+    if ((version != indexVersion) || (size != library.size()) || (modified != library.lastModified().toMSecsSinceEpoch())) {
+        return false;
+    }
+
+    QList<LibraryPattern *> libraryPatterns;
+
+    while (count-- && (stream.status() == QDataStream::Ok)) {
+        LibraryPattern *libraryPattern = new LibraryPattern(static_cast<Pattern *>(nullptr));
+        qint32 modifiers;
+
+        stream >> libraryPattern->m_offset;
+        stream >> libraryPattern->m_size;
+        stream >> libraryPattern->m_fileVersion;
+        stream >> libraryPattern->m_key;
+        stream >> modifiers;
+        stream >> libraryPattern->m_baseline;
+        stream >> libraryPattern->m_width;
+        stream >> libraryPattern->m_height;
+        stream >> libraryPattern->m_colors;
+        stream >> libraryPattern->m_hash;
+
+        libraryPattern->m_modifiers = Qt::KeyboardModifiers(modifiers);
+        libraryPattern->m_libraryFile = this;
+        libraryPatterns.append(libraryPattern);
+    }
+
+    if (stream.status() != QDataStream::Ok) {
+        qDeleteAll(libraryPatterns);
+        return false;
+    }
+
+    m_libraryPatterns.append(libraryPatterns);
+
+    return true;
+}
+
+
+// the index is a cache, if it can't be written the library is read in full next time
+void LibraryFile::writeIndex()
+{
+    QFileInfo library(localFile());
+    QDir().mkpath(QFileInfo(indexFile()).path());
+
+    QSaveFile file(indexFile());
+
+    if (!file.open(QIODevice::WriteOnly)) {
+        return;
+    }
+
+    QDataStream stream(&file);
+    stream.writeRawData("KXStitchIdx", 11);
+    stream << qint16(indexVersion);
+    stream << qint64(library.size());
+    stream << qint64(library.lastModified().toMSecsSinceEpoch());
+    stream << qint32(m_libraryPatterns.count());
+
+    foreach (const LibraryPattern *libraryPattern, m_libraryPatterns) {
+        stream << libraryPattern->m_offset;
+        stream << libraryPattern->m_size;
+        stream << libraryPattern->m_fileVersion;
+        stream << libraryPattern->m_key;
+        stream << qint32(libraryPattern->m_modifiers);
+        stream << libraryPattern->m_baseline;
+        stream << qint32(libraryPattern->width());
+        stream << qint32(libraryPattern->height());
+        stream << qint32(libraryPattern->colors());
+        stream << libraryPattern->m_hash;
+    }
+
+    file.commit();
+}
+
+
 bool LibraryFile::hasChanged()
 {
     bool changed = false;
@@ -244,3 +451,25 @@ bool LibraryFile::hasChanged()
 
     return changed;
 }
+
+
+qint64 LibraryFile::fileSize() const
+{
+    return m_fileSize;
+}
+
+
+qint64 LibraryFile::fileModified() const
+{
+    return m_fileModified;
+}
+
+
+// record the state of the file so a library scan can tell if it has been changed by another application
+void LibraryFile::updateFileState()
+{
+    QFileInfo library(localFile());
+
+    m_fileSize = (library.exists()) ? library.size() : -1;
+    m_fileModified = (library.exists()) ? library.lastModified().toMSecsSinceEpoch() : -1;
+}
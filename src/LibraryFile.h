@@ -13,6 +13,7 @@
 #define LibraryFile_H
 
 
+#include <QByteArray>
 #include <QList>
 #include <QString>
 
@@ -35,12 +36,25 @@ public:
     LibraryPattern *first();
     LibraryPattern *next();
 
+    QByteArray readPatternData(qint64, qint32) const;
+    static QByteArray readPatternData(const QString &, qint64, qint32);
+
+    QString read();
+    bool hasChanged();
+    qint64 fileSize() const;
+    qint64 fileModified() const;
+
 private:
     void readFile();
     void writeFile();
-    bool hasChanged();
+    void updateFileState();
+
+    QString indexFile() const;
+    bool readIndex();
+    void writeIndex();
 
     static const int version = 100;
+    static const int indexVersion = 100;
 
     bool            m_exists;
     bool            m_read;
@@ -48,6 +62,9 @@ private:
     QList<LibraryPattern *> m_libraryPatterns;
     int         m_current;
 
+    // the size and modification time of the file when it was read or written, -1 if it did not exist
+    qint64      m_fileSize;
+    qint64      m_fileModified;
 
 };
 
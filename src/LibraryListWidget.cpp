@@ -26,6 +26,10 @@
 LibraryListWidget::LibraryListWidget(QWidget *parent)
     :   QListWidget(parent)
 {
+    // the items are laid out without asking for their icons, which are generated when shown
+    setUniformItemSizes(true);
+    connect(&m_thumbnailCache, &ThumbnailCache::thumbnailReady, viewport(), QOverload<>::of(&QWidget::update));
+
     m_renderer.setRenderStitchesAs(Configuration::EnumRenderer_RenderStitchesAs::Stitches);
     m_renderer.setRenderBackstitchesAs(Configuration::EnumRenderer_RenderBackstitchesAs::ColorLines);
     m_renderer.setRenderKnotsAs(Configuration::EnumRenderer_RenderKnotsAs::ColorBlocks);
@@ -43,6 +47,13 @@ void LibraryListWidget::changeIconSize(int size)
 {
     setIconSize(QSize(size, size));
     setGridSize(QSize(size + 10, size + 20));
+    m_thumbnailCache.setSize(size);
+}
+
+
+QPixmap LibraryListWidget::thumbnail(LibraryPattern *libraryPattern)
+{
+    return m_thumbnailCache.thumbnail(libraryPattern);
 }
 
 
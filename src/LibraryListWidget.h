@@ -17,8 +17,10 @@
 #include <QWidget>
 
 #include "Renderer.h"
+#include "ThumbnailCache.h"
 
 
+class LibraryPattern;
 class QString;
 
 class Renderer;
@@ -32,6 +34,7 @@ public:
 
     void setCellSize(double, double);
     void changeIconSize(int);
+    QPixmap thumbnail(LibraryPattern *);
 
 protected:
     virtual void dragEnterEvent(QDragEnterEvent *) Q_DECL_OVERRIDE;
@@ -41,7 +44,8 @@ protected:
     virtual void mouseMoveEvent(QMouseEvent *) Q_DECL_OVERRIDE;
 
 private:
-    Renderer    m_renderer;
+    Renderer        m_renderer;
+    ThumbnailCache  m_thumbnailCache;
 
     QPoint  m_startDrag;
 
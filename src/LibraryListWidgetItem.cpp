@@ -11,14 +11,9 @@
 
 #include "LibraryListWidgetItem.h"
 
-#include <QPainter>
+#include <QIcon>
 
-#include "LibraryPattern.h"
-#include "Pattern.h"
-#include "Renderer.h"
-#include "StitchData.h"
-
-#include "configuration.h"
+#include "LibraryListWidget.h"
 
 
 LibraryListWidgetItem::LibraryListWidgetItem(QListWidget *listWidget, LibraryPattern *libraryPattern)
@@ -30,36 +25,7 @@ LibraryListWidgetItem::LibraryListWidgetItem(QListWidget *listWidget, LibraryPat
 
 void LibraryListWidgetItem::setLibraryPattern(LibraryPattern *libraryPattern)
 {
-    static Renderer *renderer = nullptr;
-
-    if (renderer == nullptr) {
-        renderer = new Renderer();
-        renderer->setRenderStitchesAs(Configuration::EnumRenderer_RenderStitchesAs::Stitches);
-        renderer->setRenderBackstitchesAs(Configuration::EnumRenderer_RenderBackstitchesAs::ColorLines);
-        renderer->setRenderKnotsAs(Configuration::EnumRenderer_RenderKnotsAs::ColorBlocks);
-    }
-
     m_libraryPattern = libraryPattern;
-
-    StitchData &stitches = libraryPattern->pattern()->stitches();
-    int cellSize = 256 / std::max(stitches.width(), stitches.height());
-    QPixmap pixmap(stitches.width() * cellSize, stitches.height() * cellSize);
-    pixmap.fill(Qt::white);
-
-    QPainter painter(&pixmap);
-    painter.setRenderHint(QPainter::Antialiasing, true);
-    painter.setWindow(0, 0, stitches.width(), stitches.height());
-
-    renderer->render(&painter,
-                     libraryPattern->pattern(),
-                     pixmap.rect(),
-                     true,
-                     true,
-                     true,
-                     true,
-                     -1);
-
-    setIcon(QIcon(pixmap));
 }
 
 
@@ -67,3 +33,14 @@ LibraryPattern *LibraryListWidgetItem::libraryPattern()
 {
     return m_libraryPattern;
 }
+
+
+// the thumbnail is generated in the background when the item is first shown
+QVariant LibraryListWidgetItem::data(int role) const
+{
+    if (role == Qt::DecorationRole) {
+        return QIcon(static_cast<LibraryListWidget *>(listWidget())->thumbnail(m_libraryPattern));
+    }
+
+    return QListWidgetItem::data(role);
+}
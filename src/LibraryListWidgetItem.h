@@ -28,8 +28,10 @@ public:
     void setLibraryPattern(LibraryPattern *libraryPattern);
     LibraryPattern *libraryPattern();
 
+    virtual QVariant data(int role) const Q_DECL_OVERRIDE;
+
 private:
-    LibraryPattern *m_libraryPattern;
+    LibraryPattern  *m_libraryPattern;
 };
 
 
@@ -19,11 +19,13 @@
 #include <QMimeData>
 #include <QStandardPaths>
 #include <QToolTip>
+#include <QTreeWidgetItemIterator>
 
 #include <KHelpClient>
 #include <KLocalizedString>
 #include <KMessageBox>
 
+#include "Exceptions.h"
 #include "LibraryFilePathsDlg.h"
 #include "LibraryListWidgetItem.h"
 #include "LibraryPatternPropertiesDlg.h"
@@ -40,6 +42,7 @@ LibraryManagerDlg::LibraryManagerDlg(QWidget *parent)
 
     ui.setupUi(this);
 
+    connect(&m_libraryScanner, &LibraryScanner::libraryFound, this, &LibraryManagerDlg::libraryFound);
     refreshLibraries();
 
     ui.LibraryTree->setContextMenuPolicy(Qt::CustomContextMenu);
@@ -61,7 +64,9 @@ bool LibraryManagerDlg::event(QEvent *event)
         QHelpEvent *helpEvent = static_cast<QHelpEvent *>(event);
         QString tip;
 
-        if (ui.LibraryTree->topLevelItemCount() == 0) {
+        if (ui.LibraryTree->topLevelItemCount() == 0 && m_libraryScanner.isScanning()) {
+            tip = i18n("Searching for libraries.");
+        } else if (ui.LibraryTree->topLevelItemCount() == 0) {
             tip = i18n("The Library Manager can be used to store\nreusable patterns for insertion into\nnew patterns.\n\nThere are no library categories defined.\nClick the Help button for information on creating\nand populating libraries.");
         } else {
             if (ui.LibraryTree->currentItem() == nullptr) {
@@ -99,6 +104,9 @@ void LibraryManagerDlg::showEvent(QShowEvent *event)
     if (KConfigGroup(KSharedConfig::openConfig(), QStringLiteral("DialogSizes")).hasKey(QStringLiteral("LibraryManagerDlg"))) {
         resize(KConfigGroup(KSharedConfig::openConfig(), QStringLiteral("DialogSizes")).readEntry(QStringLiteral("LibraryManagerDlg"), QSize()));
     }
+
+    // libraries changed by other applications since the dialog was last shown are read again
+    refreshLibraries();
 }
 
 
@@ -257,7 +265,15 @@ void LibraryManagerDlg::pasteFromClipboard()
     Pattern *pattern = new Pattern();
     QByteArray data = QApplication::clipboard()->mimeData()->data(QStringLiteral("application/kxstitch"));
     QDataStream stream(&data, QIODevice::ReadOnly);
-    stream >> *pattern;
+
+    try {
+        stream >> *pattern;
+    } catch (const FailedReadFile &e) {
+        delete pattern;
+        KMessageBox::error(this, i18n("Failed to read the pasted pattern.\n%1", e.status));
+        return;
+    }
+
     item->addPattern(new LibraryPattern(pattern));
     on_LibraryTree_currentItemChanged(static_cast<QTreeWidgetItem *>(item), nullptr);
 }
@@ -278,6 +294,7 @@ void LibraryManagerDlg::patternProperties()
     if (dialog->exec()) {
         libraryPattern->setKeyModifiers(dialog->key(), dialog->modifiers());
         libraryPattern->setBaseline(dialog->baseline());
+        currentLibrary()->invalidateIndex();
     }
 
     delete dialog;
@@ -303,67 +320,77 @@ void LibraryManagerDlg::deletePattern()
 }
 
 
+// the library directories are scanned in the background, only libraries that are new or
+// have changed since they were read are reported to libraryFound()
 void LibraryManagerDlg::refreshLibraries()
 {
-    ui.LibraryTree->clear();
+    LibraryScanner::FileStates fileStates;
+
+    for (QTreeWidgetItemIterator it(ui.LibraryTree) ; *it ; ++it) {
+        foreach (LibraryFile *libraryFile, static_cast<LibraryTreeWidgetItem *>(*it)->libraryFiles()) {
+            fileStates.insert(libraryFile->path(), qMakePair(libraryFile->fileSize(), libraryFile->fileModified()));
+        }
+    }
+
     QStringList libraryDirectories = QStandardPaths::locateAll(QStandardPaths::DataLocation, QStringLiteral("library"), QStandardPaths::LocateDirectory);
-    QStringListIterator libraryDirectoriesIterator(libraryDirectories);
+    m_libraryScanner.scan(libraryDirectories, fileStates);
+}
+
+
+void LibraryManagerDlg::libraryFound(const QStringList &categories, LibraryFile *libraryFile, const QString &error)
+{
+    LibraryTreeWidgetItem *libraryTreeWidgetItem = nullptr;
+
+    foreach (const QString &category, categories) {
+        libraryTreeWidgetItem = findCategory(libraryTreeWidgetItem, category);
+    }
+
+    // the patterns of a library that has been read again replace those shown
+    if (libraryTreeWidgetItem->addLibraryFile(libraryFile) && libraryTreeWidgetItem == ui.LibraryTree->currentItem()) {
+        on_LibraryTree_currentItemChanged(libraryTreeWidgetItem, nullptr);
+    }
 
-    while (libraryDirectoriesIterator.hasNext()) {
-        recurseLibraryDirectory(nullptr, libraryDirectoriesIterator.next());
+    if (!error.isEmpty()) {
+        KMessageBox::error(this, error, i18n("Failed to read library."));
     }
 }
 
 
-void LibraryManagerDlg::recurseLibraryDirectory(LibraryTreeWidgetItem *parent, const QString &path)
+LibraryTreeWidgetItem *LibraryManagerDlg::findCategory(LibraryTreeWidgetItem *parent, const QString &name)
 {
-    QDir directory(path);
-    const QFileInfoList directoryEntries = directory.entryInfoList();
-    QListIterator<QFileInfo> fileInfoListIterator(directoryEntries);
-
-    while (fileInfoListIterator.hasNext()) {
-        QFileInfo fileInfo = fileInfoListIterator.next();
-
-        if (fileInfo.isDir()) {
-            if (fileInfo.fileName() != QLatin1String(".") && fileInfo.fileName() != QLatin1String("..")) {
-                LibraryTreeWidgetItem *libraryTreeWidgetItem = nullptr;
-                QString subPath = QString::fromLatin1("%1/%2").arg(path, fileInfo.fileName());
-
-                if (parent) {
-                    int children = parent->childCount();
-                    int childIndex = 0;
-
-                    while (childIndex < children) {
-                        libraryTreeWidgetItem = dynamic_cast<LibraryTreeWidgetItem *>(parent->child(childIndex));
-
-                        if (libraryTreeWidgetItem->text(0) == fileInfo.fileName()) {
-                            break;
-                        } else {
-                            libraryTreeWidgetItem = nullptr;
-                        }
-
-                        childIndex++;
-                    }
-                } else {
-                    QList<QTreeWidgetItem *> rootNodes = ui.LibraryTree->findItems(fileInfo.fileName(), Qt::MatchExactly, 0);
-
-                    if (!rootNodes.isEmpty()) {
-                        libraryTreeWidgetItem = dynamic_cast<LibraryTreeWidgetItem *>(rootNodes[0]);
-                    }
-                }
-
-                if (libraryTreeWidgetItem == nullptr) {
-                    if (parent) {
-                        libraryTreeWidgetItem = new LibraryTreeWidgetItem(parent, fileInfo.fileName());
-                    } else {
-                        libraryTreeWidgetItem = new LibraryTreeWidgetItem(ui.LibraryTree, fileInfo.fileName());
-                        ui.LibraryTree->sortItems(0, Qt::AscendingOrder);
-                    }
-                }
-
-                libraryTreeWidgetItem->addPath(subPath);
-                recurseLibraryDirectory(libraryTreeWidgetItem, subPath);
+    LibraryTreeWidgetItem *libraryTreeWidgetItem = nullptr;
+
+    if (parent) {
+        int children = parent->childCount();
+        int childIndex = 0;
+
+        while (childIndex < children) {
+            libraryTreeWidgetItem = dynamic_cast<LibraryTreeWidgetItem *>(parent->child(childIndex));
+
+            if (libraryTreeWidgetItem->text(0) == name) {
+                break;
+            } else {
+                libraryTreeWidgetItem = nullptr;
             }
+
+            childIndex++;
+        }
+    } else {
+        QList<QTreeWidgetItem *> rootNodes = ui.LibraryTree->findItems(name, Qt::MatchExactly, 0);
+
+        if (!rootNodes.isEmpty()) {
+            libraryTreeWidgetItem = dynamic_cast<LibraryTreeWidgetItem *>(rootNodes[0]);
         }
     }
+
+    if (libraryTreeWidgetItem == nullptr) {
+        if (parent) {
+            libraryTreeWidgetItem = new LibraryTreeWidgetItem(parent, name);
+        } else {
+            libraryTreeWidgetItem = new LibraryTreeWidgetItem(ui.LibraryTree, name);
+            ui.LibraryTree->sortItems(0, Qt::AscendingOrder);
+        }
+    }
+
+    return libraryTreeWidgetItem;
 }
@@ -18,9 +18,12 @@
 #include <QTreeWidgetItem>
 #include <QWidget>
 
+#include "LibraryScanner.h"
+
 #include "ui_LibraryManager.h"
 
 
+class LibraryFile;
 class LibraryListWidgetItem;
 class LibraryTreeWidgetItem;
 class QHideEvent;
@@ -63,14 +66,18 @@ private slots:
     void copyToClipboard();
     void deletePattern();
 
+    void libraryFound(const QStringList &, LibraryFile *, const QString &);
+
 private:
     void refreshLibraries();
-    void recurseLibraryDirectory(LibraryTreeWidgetItem *, const QString &);
+    LibraryTreeWidgetItem *findCategory(LibraryTreeWidgetItem *, const QString &);
 
     QMenu                   m_contextMenu;
     LibraryTreeWidgetItem   *m_contextTreeItem;
     LibraryListWidgetItem   *m_contextListItem;
 
+    LibraryScanner          m_libraryScanner;
+
     Ui::LibraryManager  ui;
 };
 
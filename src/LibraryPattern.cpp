@@ -13,14 +13,27 @@
 
 #include <QListWidget>
 
+#include <KLocalizedString>
+#include <KMessageBox>
+
+#include "Exceptions.h"
+#include "Glyph.h"
 #include "KeycodeLineEdit.h"
+#include "LibraryFile.h"
 #include "LibraryListWidgetItem.h"
 #include "Pattern.h"
 
 
 LibraryPattern::LibraryPattern()
+    :   m_pattern(new Pattern),
+        m_libraryFile(nullptr),
+        m_offset(0),
+        m_size(0),
+        m_fileVersion(version),
+        m_width(0),
+        m_height(0),
+        m_colors(0)
 {
-    m_pattern = new Pattern;
 }
 
 
@@ -30,17 +43,38 @@ LibraryPattern::LibraryPattern(Pattern *pattern, qint32 key, Qt::KeyboardModifie
         m_modifiers(modifiers),
         m_baseline(baseline),
         m_libraryListWidgetItem(nullptr),
-        m_changed(false)
+        m_changed(false),
+        m_libraryFile(nullptr),
+        m_offset(0),
+        m_size(0),
+        m_fileVersion(version),
+        m_width(0),
+        m_height(0),
+        m_colors(0)
 {
 }
 
 
 LibraryPattern::LibraryPattern(QByteArray data, qint32 key, Qt::KeyboardModifiers modifiers, qint16 baseline)
-    :   m_key(key),
+    :   m_pattern(readVersion1(data)),
+        m_key(key),
         m_modifiers(modifiers),
         m_baseline(baseline),
         m_libraryListWidgetItem(nullptr),
-        m_changed(false)
+        m_changed(false),
+        m_libraryFile(nullptr),
+        m_offset(0),
+        m_size(0),
+        m_fileVersion(1),
+        m_width(0),
+        m_height(0),
+        m_colors(0)
+{
+}
+
+
+// decode a pattern from version 1 of the library format
+Pattern *LibraryPattern::readVersion1(QByteArray data)
 {
     QDataStream stream(&data, QIODevice::ReadOnly);
     stream.setVersion(QDataStream::Qt_3_3);
@@ -50,9 +84,9 @@ LibraryPattern::LibraryPattern(QByteArray data, qint32 key, Qt::KeyboardModifier
     stream  >> scheme
             >> width
             >> height;
-    m_pattern = new Pattern;
-    m_pattern->palette().setSchemeName(scheme);
-    m_pattern->stitches().resize(width, height);
+    Pattern *pattern = new Pattern;
+    pattern->palette().setSchemeName(scheme);
+    pattern->stitches().resize(width, height);
 
     QMap<int, QColor> colors;
     int colorIndex;
@@ -69,11 +103,11 @@ LibraryPattern::LibraryPattern(QByteArray data, qint32 key, Qt::KeyboardModifier
                 stream >> type >> color;
 
                 if ((colorIndex = colors.key(color, -1)) == -1) {
-                    colorIndex = m_pattern->palette().add(color);
+                    colorIndex = pattern->palette().add(color);
                     colors.insert(colorIndex, color);
                 }
 
-                m_pattern->stitches().addStitch(cell, static_cast<Stitch::Type>(type), colorIndex);
+                pattern->stitches().addStitch(cell, static_cast<Stitch::Type>(type), colorIndex);
             }
         }
     }
@@ -88,11 +122,11 @@ LibraryPattern::LibraryPattern(QByteArray data, qint32 key, Qt::KeyboardModifier
         stream >> start >> end >> color;
 
         if ((colorIndex = colors.key(color, -1)) == -1) {
-            colorIndex = m_pattern->palette().add(color);
+            colorIndex = pattern->palette().add(color);
             colors.insert(colorIndex, color);
         }
 
-        m_pattern->stitches().addBackstitch(start, end, colorIndex);
+        pattern->stitches().addBackstitch(start, end, colorIndex);
     }
 
     qint32 knots;
@@ -104,12 +138,14 @@ LibraryPattern::LibraryPattern(QByteArray data, qint32 key, Qt::KeyboardModifier
         stream >> position >> color;
 
         if ((colorIndex = colors.key(color, -1)) == -1) {
-            colorIndex = m_pattern->palette().add(color);
+            colorIndex = pattern->palette().add(color);
             colors.insert(colorIndex, color);
         }
 
-        m_pattern->stitches().addFrenchKnot(position, colorIndex);
+        pattern->stitches().addFrenchKnot(position, colorIndex);
     }
+
+    return pattern;
 }
 
 
@@ -131,12 +167,109 @@ qint16 LibraryPattern::baseline() const
 }
 
 
+int LibraryPattern::width() const
+{
+    return (m_pattern) ? m_pattern->stitches().width() : m_width;
+}
+
+
+int LibraryPattern::height() const
+{
+    return (m_pattern) ? m_pattern->stitches().height() : m_height;
+}
+
+
+int LibraryPattern::colors() const
+{
+    return (m_pattern) ? m_pattern->palette().flosses().count() : m_colors;
+}
+
+
+QByteArray LibraryPattern::hash() const
+{
+    return m_hash;
+}
+
+
+// the encoded pattern as stored in the library file, empty if it has not been written to one
+QByteArray LibraryPattern::patternData() const
+{
+    return (m_libraryFile) ? m_libraryFile->readPatternData(m_offset, m_size) : QByteArray();
+}
+
+
+// the location of the encoded pattern, so it can be read with LibraryFile::readPatternData on another thread
+QString LibraryPattern::patternFile() const
+{
+    return (m_libraryFile) ? m_libraryFile->localFile() : QString();
+}
+
+
+qint64 LibraryPattern::patternOffset() const
+{
+    return m_offset;
+}
+
+
+qint32 LibraryPattern::patternSize() const
+{
+    return m_size;
+}
+
+
+qint16 LibraryPattern::fileVersion() const
+{
+    return m_fileVersion;
+}
+
+
 Pattern *LibraryPattern::pattern()
 {
+    if (m_pattern == nullptr) {
+        try {
+            m_pattern = decode(m_libraryFile->readPatternData(m_offset, m_size), m_fileVersion);
+        } catch (const FailedReadFile &e) {
+            // a damaged pattern is shown empty rather than being decoded again each time it is used
+            m_pattern = new Pattern;
+            KMessageBox::error(nullptr, i18n("Failed to read a pattern from the library %1.\n%2", m_libraryFile->localFile(), e.status));
+        }
+    }
+
     return m_pattern;
 }
 
 
+// decode a pattern read from a library file, this does not use the LibraryPattern so may be called on a worker thread
+Pattern *LibraryPattern::decode(QByteArray data, qint16 fileVersion)
+{
+    if (fileVersion == 1) {
+        return readVersion1(data);
+    }
+
+    Pattern *pattern = new Pattern;
+    QDataStream stream(&data, QIODevice::ReadOnly);
+
+    try {
+        stream >> *pattern;
+    } catch (const FailedReadFile &e) {
+        delete pattern;
+        throw;
+    }
+
+    return pattern;
+}
+
+
+QSharedPointer<const Glyph> LibraryPattern::glyph()
+{
+    if (m_glyph.isNull()) {
+        m_glyph = QSharedPointer<const Glyph>(new Glyph(pattern(), m_baseline));
+    }
+
+    return m_glyph;
+}
+
+
 LibraryListWidgetItem *LibraryPattern::libraryListWidgetItem() const
 {
     return m_libraryListWidgetItem;
@@ -161,6 +294,7 @@ void LibraryPattern::setKeyModifiers(qint32 key, Qt::KeyboardModifiers modifiers
 void LibraryPattern::setBaseline(qint16 baseline)
 {
     m_baseline = baseline;
+    m_glyph.clear();
     m_changed = true;
 }
 
@@ -178,7 +312,17 @@ QDataStream &operator<<(QDataStream &stream, const LibraryPattern &libraryPatter
     stream << libraryPattern.m_key;
     stream << qint32(libraryPattern.m_modifiers);
     stream << libraryPattern.m_baseline;
-    stream << *(libraryPattern.m_pattern);
+
+    if (libraryPattern.m_pattern) {
+        stream << *(libraryPattern.m_pattern);
+    } else if (libraryPattern.m_fileVersion == LibraryPattern::version) {
+        // not decoded, so the encoded pattern is copied from the library file
+        QByteArray data = libraryPattern.m_libraryFile->readPatternData(libraryPattern.m_offset, libraryPattern.m_size);
+        stream.writeRawData(data.constData(), data.size());
+    } else {
+        stream << *(const_cast<LibraryPattern &>(libraryPattern).pattern());
+    }
+
     return stream;
 }
 
@@ -15,9 +15,12 @@
 
 #include <QByteArray>
 #include <QDataStream>
+#include <QSharedPointer>
 #include <QString>
 
 
+class Glyph;
+class LibraryFile;
 class LibraryListWidgetItem;
 class Pattern;
 
@@ -32,7 +35,17 @@ public:
     qint32 key() const;
     Qt::KeyboardModifiers modifiers() const;
     qint16 baseline() const;
+    int width() const;
+    int height() const;
+    int colors() const;
+    QByteArray hash() const;
+    QByteArray patternData() const;
+    QString patternFile() const;
+    qint64 patternOffset() const;
+    qint32 patternSize() const;
+    qint16 fileVersion() const;
     Pattern *pattern();
+    QSharedPointer<const Glyph> glyph();
     LibraryListWidgetItem *libraryListWidgetItem() const;
     bool hasChanged() const;
 
@@ -43,15 +56,34 @@ public:
     friend QDataStream &operator<<(QDataStream &, const LibraryPattern &);
     friend QDataStream &operator>>(QDataStream &, LibraryPattern &);
 
+    friend class LibraryFile;
+
+    static Pattern *decode(QByteArray, qint16 fileVersion);
+
 private:
+    static Pattern *readVersion1(QByteArray);
+
     static const int version = 100;
+    static const int headerSize = 14;   // the version, key, modifiers and baseline preceding the pattern
 
-    Pattern         *m_pattern;
+    Pattern         *m_pattern;         // nullptr until the pattern is decoded from the library file
     qint32          m_key;
     Qt::KeyboardModifiers   m_modifiers;
     qint16          m_baseline;
     LibraryListWidgetItem   *m_libraryListWidgetItem;
     bool            m_changed;
+    QSharedPointer<const Glyph> m_glyph;    // compiled when first typed, shared with the commands using it
+
+    // the location of the encoded pattern in the library file and the details of it
+    // kept in the library index, so the pattern can be listed without decoding it
+    LibraryFile     *m_libraryFile;
+    qint64          m_offset;
+    qint32          m_size;
+    qint16          m_fileVersion;
+    qint32          m_width;
+    qint32          m_height;
+    qint32          m_colors;
+    QByteArray      m_hash;
 };
 
 
@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2010-2022 by Stephen Allewell
+ * steve.allewell@gmail.com
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+
+/** @file
+ * This file implements the scanning of the library directories in the background.
+ */
+
+
+#include "LibraryScanner.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QFileInfoList>
+#include <QMutexLocker>
+#include <QtConcurrent>
+
+#include "LibraryFile.h"
+
+
+LibraryScanner::LibraryScanner(QObject *parent)
+    :   QObject(parent)
+{
+    connect(&m_watcher, &QFutureWatcher<void>::finished, this, [this]() {
+        publish();
+        emit finished();
+    });
+}
+
+
+LibraryScanner::~LibraryScanner()
+{
+    m_cancelled.storeRelease(1);
+    m_watcher.waitForFinished();
+
+    foreach (const Library &library, m_found) {
+        delete library.libraryFile;
+    }
+}
+
+
+void LibraryScanner::scan(const QStringList &directories, const FileStates &fileStates)
+{
+    if (isScanning()) {
+        return;
+    }
+
+    m_cancelled.storeRelease(0);
+    m_watcher.setFuture(QtConcurrent::run(this, &LibraryScanner::run, directories, fileStates));
+}
+
+
+bool LibraryScanner::isScanning() const
+{
+    return m_watcher.isRunning();
+}
+
+
+// called on the user interface thread to report the libraries found since it was last called
+void LibraryScanner::publish()
+{
+    QList<Library> found;
+
+    {
+        QMutexLocker locker(&m_mutex);
+        found.swap(m_found);
+    }
+
+    foreach (const Library &library, found) {
+        emit libraryFound(library.categories, library.libraryFile, library.error);
+    }
+}
+
+
+// called on a worker thread
+void LibraryScanner::run(const QStringList &directories, const FileStates &fileStates)
+{
+    foreach (const QString &directory, directories) {
+        recurse(QStringList(), directory, fileStates);
+    }
+}
+
+
+void LibraryScanner::recurse(const QStringList &categories, const QString &path, const FileStates &fileStates)
+{
+    const QFileInfoList directoryEntries = QDir(path).entryInfoList(QDir::Dirs | QDir::NoDotAndDotDot);
+
+    foreach (const QFileInfo &fileInfo, directoryEntries) {
+        if (m_cancelled.loadAcquire()) {
+            return;
+        }
+
+        QStringList subCategories = categories;
+        subCategories.append(fileInfo.fileName());
+        QString subPath = QString::fromLatin1("%1/%2").arg(path, fileInfo.fileName());
+
+        LibraryFile *libraryFile = new LibraryFile(subPath);
+        QFileInfo library(libraryFile->localFile());
+        qint64 size = (library.exists()) ? library.size() : -1;
+        qint64 modified = (library.exists()) ? library.lastModified().toMSecsSinceEpoch() : -1;
+
+        if (fileStates.value(subPath, qMakePair(qint64(-2), qint64(-2))) == qMakePair(size, modified)) {
+            // unchanged since it was read, the category already exists
+            delete libraryFile;
+        } else {
+            Library found;
+            found.categories = subCategories;
+            found.libraryFile = libraryFile;
+            found.error = libraryFile->read();
+
+            QMutexLocker locker(&m_mutex);
+            m_found.append(found);
+
+            // the user interface is only notified once for the libraries found before it publishes them
+            if (m_found.count() == 1) {
+                QMetaObject::invokeMethod(this, "publish", Qt::QueuedConnection);
+            }
+        }
+
+        recurse(subCategories, subPath, fileStates);
+    }
+}
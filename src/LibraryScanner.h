@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2010-2022 by Stephen Allewell
+ * steve.allewell@gmail.com
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+
+/** @file
+ * This file defines the scanning of the library directories in the background.
+ */
+
+
+#ifndef LibraryScanner_H
+#define LibraryScanner_H
+
+
+#include <QAtomicInt>
+#include <QFutureWatcher>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QObject>
+#include <QPair>
+#include <QString>
+#include <QStringList>
+
+
+class LibraryFile;
+
+
+/**
+ * Finds the library categories and reads their library files on the global
+ * thread pool, so the library manager is not blocked by slow or network
+ * mounted directories.
+ *
+ * Each directory below a library directory is a category, named by the path
+ * of directory names from the library directory. As each directory is found
+ * its library file is read and libraryFound() is emitted on the user interface
+ * thread, so the categories are shown as they are found.
+ *
+ * A scan is given the size and modification time of the library files that
+ * have already been read, and those that have not changed since are not read
+ * again or reported, so scanning again when the library manager is reopened
+ * only reads new or changed libraries.
+ */
+class LibraryScanner : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * The size and modification time of library files that have been read,
+     * indexed by the path of their directory.
+     */
+    typedef QHash<QString, QPair<qint64, qint64> > FileStates;
+
+    /**
+     * Constructor.
+     *
+     * @param parent is a pointer to the parent QObject
+     */
+    explicit LibraryScanner(QObject *parent = nullptr);
+
+    /**
+     * Destructor, a scan in progress is cancelled and the libraries read by it
+     * that have not been reported are deleted.
+     */
+    virtual ~LibraryScanner();
+
+    /**
+     * Start scanning, this is ignored if a scan is in progress.
+     *
+     * @param directories is a QStringList of the library directories
+     * @param fileStates is a const reference to the FileStates of the library files already read
+     */
+    void scan(const QStringList &directories, const FileStates &fileStates);
+
+    /**
+     * Test if a scan is in progress.
+     *
+     * @return @c true if scanning, @c false otherwise
+     */
+    bool isScanning() const;
+
+signals:
+    /**
+     * Emitted for each new or changed library found.
+     *
+     * @param categories is a QStringList of the names of the category and its parents, the top level first
+     * @param libraryFile is a pointer to the LibraryFile read, the receiver takes ownership of it
+     * @param error is an error message from reading the library, an empty QString if it was read
+     */
+    void libraryFound(const QStringList &categories, LibraryFile *libraryFile, const QString &error);
+
+    /**
+     * Emitted when a scan is complete.
+     */
+    void finished();
+
+private slots:
+    void publish();
+
+private:
+    struct Library {
+        QStringList categories;
+        LibraryFile *libraryFile;
+        QString     error;
+    };
+
+    void run(const QStringList &directories, const FileStates &fileStates);
+    void recurse(const QStringList &categories, const QString &path, const FileStates &fileStates);
+
+    QAtomicInt              m_cancelled;
+    QFutureWatcher<void>    m_watcher;
+
+    QMutex                  m_mutex;
+    QList<Library>          m_found;
+};
+
+
+#endif // LibraryScanner_H
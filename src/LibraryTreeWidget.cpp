@@ -21,7 +21,9 @@
 #include <QTreeWidgetItem>
 
 #include <KLocalizedString>
+#include <KMessageBox>
 
+#include "Exceptions.h"
 #include "LibraryPattern.h"
 #include "LibraryTreeWidgetItem.h"
 #include "Pattern.h"
@@ -110,8 +112,14 @@ void LibraryTreeWidget::dropEvent(QDropEvent *event)
         QByteArray data = event->mimeData()->data(QStringLiteral("application/kxstitch"));
         Pattern *pattern = new Pattern;
         QDataStream stream(&data, QIODevice::ReadOnly);
-        stream >> *pattern;
-        static_cast<LibraryTreeWidgetItem *>(m_dropItem)->addPattern(new LibraryPattern(pattern));
+
+        try {
+            stream >> *pattern;
+            static_cast<LibraryTreeWidgetItem *>(m_dropItem)->addPattern(new LibraryPattern(pattern));
+        } catch (const FailedReadFile &e) {
+            delete pattern;
+            KMessageBox::error(this, i18n("Failed to read the dropped pattern.\n%1", e.status));
+        }
     }
 
     if (m_currentItem) {
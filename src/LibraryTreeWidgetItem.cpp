@@ -102,14 +102,18 @@ struct LIBRARY (new kde4)
 
 
 LibraryTreeWidgetItem::LibraryTreeWidgetItem(QTreeWidget *parent, const QString &name)
-    :   QTreeWidgetItem(parent, QTreeWidgetItem::UserType)
+    :   QTreeWidgetItem(parent, QTreeWidgetItem::UserType),
+        m_indexValid(false),
+        m_maxHeight(0)
 {
     setText(0, name);
 }
 
 
 LibraryTreeWidgetItem::LibraryTreeWidgetItem(LibraryTreeWidgetItem *parent, const QString &name)
-    :   QTreeWidgetItem(parent, QTreeWidgetItem::UserType)
+    :   QTreeWidgetItem(parent, QTreeWidgetItem::UserType),
+        m_indexValid(false),
+        m_maxHeight(0)
 {
     setText(0, name);
 }
@@ -121,29 +125,57 @@ LibraryTreeWidgetItem::~LibraryTreeWidgetItem()
 }
 
 
-int LibraryTreeWidgetItem::maxHeight()
+// the key and modifiers of a character combined for the index
+static qint64 characterKey(int key, Qt::KeyboardModifiers modifiers)
 {
-    int max = 0;
+    return (qint64(key) << 32) | quint32(modifiers);
+}
 
-    for (LibraryPattern *libraryPattern = first() ; libraryPattern ; libraryPattern = next()) {
-        max = std::max(max, libraryPattern->pattern()->stitches().height());
-    }
 
-    return max;
+int LibraryTreeWidgetItem::maxHeight()
+{
+    updateIndex();
+
+    return m_maxHeight;
 }
 
 
 LibraryPattern *LibraryTreeWidgetItem::findCharacter(int key, Qt::KeyboardModifiers modifiers)
 {
-    LibraryPattern *libraryPattern;
+    updateIndex();
+
+    return m_characters.value(characterKey(key, modifiers), nullptr);
+}
 
-    for (libraryPattern = first() ; libraryPattern ; libraryPattern = next()) {
-        if (libraryPattern->key() == key && libraryPattern->modifiers() == modifiers) {
-            break;
+
+// call when the key or modifiers of a pattern have been changed
+void LibraryTreeWidgetItem::invalidateIndex()
+{
+    m_indexValid = false;
+}
+
+
+// the first pattern found for a key is used, as it was when the patterns were searched
+void LibraryTreeWidgetItem::updateIndex()
+{
+    if (m_indexValid) {
+        return;
+    }
+
+    m_characters.clear();
+    m_maxHeight = 0;
+
+    for (LibraryPattern *libraryPattern = first() ; libraryPattern ; libraryPattern = next()) {
+        qint64 character = characterKey(libraryPattern->key(), libraryPattern->modifiers());
+
+        if (!m_characters.contains(character)) {
+            m_characters.insert(character, libraryPattern);
         }
+
+        m_maxHeight = std::max(m_maxHeight, libraryPattern->height());
     }
 
-    return libraryPattern;
+    m_indexValid = true;
 }
 
 
@@ -185,6 +217,31 @@ LibraryPattern *LibraryTreeWidgetItem::next()
 void LibraryTreeWidgetItem::addPath(const QString &path)
 {
     m_libraryFiles.append(new LibraryFile(path));
+    m_indexValid = false;
+}
+
+
+// add a library file read in the background, replacing the one for the same path if it has no
+// changes waiting to be written, returning false if the library file was not used and was deleted
+bool LibraryTreeWidgetItem::addLibraryFile(LibraryFile *libraryFile)
+{
+    m_indexValid = false;
+
+    for (int i = 0 ; i < m_libraryFiles.count() ; ++i) {
+        if (m_libraryFiles.at(i)->path() == libraryFile->path()) {
+            if (m_libraryFiles.at(i)->hasChanged()) {
+                delete libraryFile;
+                return false;
+            }
+
+            delete m_libraryFiles.at(i);
+            m_libraryFiles[i] = libraryFile;
+            return true;
+        }
+    }
+
+    m_libraryFiles.append(libraryFile);
+    return true;
 }
 
 
@@ -207,6 +264,12 @@ QStringList LibraryTreeWidgetItem::paths()
 }
 
 
+QList<LibraryFile *> LibraryTreeWidgetItem::libraryFiles()
+{
+    return m_libraryFiles;
+}
+
+
 LibraryFile *LibraryTreeWidgetItem::writablePath()
 {
     LibraryFile *libraryFile = nullptr;
@@ -232,6 +295,16 @@ LibraryFile *LibraryTreeWidgetItem::writablePath()
 void LibraryTreeWidgetItem::addPattern(LibraryPattern *libraryPattern)
 {
     writablePath()->addPattern(libraryPattern);
+
+    if (m_indexValid) {
+        qint64 character = characterKey(libraryPattern->key(), libraryPattern->modifiers());
+
+        if (!m_characters.contains(character)) {
+            m_characters.insert(character, libraryPattern);
+        }
+
+        m_maxHeight = std::max(m_maxHeight, libraryPattern->height());
+    }
 }
 
 
@@ -248,4 +321,7 @@ void LibraryTreeWidgetItem::deletePattern(LibraryPattern *libraryPattern)
             }
         }
     }
+
+    // another pattern may have the same key or the deleted one may have been the highest
+    m_indexValid = false;
 }
@@ -13,6 +13,7 @@
 #define LibraryTreeWidgetItem_H
 
 
+#include <QHash>
 #include <QList>
 #include <QString>
 #include <QStringList>
@@ -38,16 +39,25 @@ public:
     LibraryPattern *next();
 
     void addPath(const QString &);
+    bool addLibraryFile(LibraryFile *);
     QString path();
     QStringList paths();
+    QList<LibraryFile *> libraryFiles();
     void addPattern(LibraryPattern *);
     void deletePattern(LibraryPattern *);
+    void invalidateIndex();
 
 private:
     LibraryFile *writablePath();
+    void updateIndex();
 
     int         m_libraryFilesIndex;
     QList<LibraryFile *>    m_libraryFiles;
+
+    // the patterns by key and modifiers and the maximum height, rebuilt when first used after the patterns change
+    bool        m_indexValid;
+    int         m_maxHeight;
+    QHash<qint64, LibraryPattern *> m_characters;
 };
 
 
@@ -58,14 +58,21 @@
     */
 
 
+#include <cstring>
+
 #include <QApplication>
 #include <QCommandLineParser>
+#include <QDir>
+#include <QMap>
+#include <QThreadPool>
 #include <QUrl>
 
 #include <KAboutData>
 #include <KLocalizedString>
 
+#include "BatchConverter.h"
 #include "configuration.h"
+#include "Journal.h"
 #include "MainWindow.h"
 
 
@@ -79,12 +86,26 @@
     Alternatively a QCommandLineParser object is created to manage any arguments passed on the command
     line.  For each of the arguments provided, a new MainWindow is created using the arguments url.
     This MainWindow is then shown on the desktop.  If no arguments are provided a new MainWindow is
-    created using an empty QUrl, creating a new document, which is then shown on the desktop.
+    created using an empty QUrl, creating a new document, which is then shown on the desktop. A MainWindow
+    is also created for each journal of an unsaved document left by an earlier instance, offering to
+    recover the changes. With the --read-only option the documents are opened for viewing, the
+    stitches being decoded as they are drawn.
 
     The KApplication instance is then executed which begins the event loop allowing user interaction.
+
+    With the --batch option no windows are created, the files given are converted by a BatchConverter
+    and the application exits when they have all been converted. Unless another platform has been
+    chosen the offscreen platform is used so a display is not required.
     */
 int main(int argc, char *argv[])
 {
+    // the platform has to be chosen before the application is created
+    for (int i = 1 ; i < argc ; ++i) {
+        if ((std::strcmp(argv[i], "--batch") == 0) && qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+            qputenv("QT_QPA_PLATFORM", "offscreen");
+        }
+    }
+
     QApplication app(argc, argv);
     KLocalizedString::setApplicationDomain("kxstitch");
 
@@ -119,10 +140,50 @@ int main(int argc, char *argv[])
 
     parser.addPositionalArgument(QStringLiteral("urls"), i18n("Document to open."), QStringLiteral("[urls...]"));
 
+    QCommandLineOption batchOption(QStringLiteral("batch"), i18n("Convert the files given without opening any windows."));
+    QCommandLineOption formatOption(QStringLiteral("format"), i18n("The format of the converted files, kxs, pdf, png or svg."), QStringLiteral("format"), QStringLiteral("kxs"));
+    QCommandLineOption resolutionOption(QStringLiteral("dpi"), i18n("The resolution of png and svg images in dots per inch."), QStringLiteral("dpi"), QStringLiteral("300"));
+    QCommandLineOption outputOption(QStringLiteral("output"), i18n("The directory for the converted files, by default the directory of each file."), QStringLiteral("directory"));
+    QCommandLineOption jobsOption(QStringLiteral("jobs"), i18n("The number of files converted at the same time, by default the number of processors."), QStringLiteral("count"));
+    QCommandLineOption readOnlyOption(QStringLiteral("read-only"), i18n("Open the documents for viewing, editing can be enabled from the File menu."));
+    parser.addOption(batchOption);
+    parser.addOption(formatOption);
+    parser.addOption(resolutionOption);
+    parser.addOption(outputOption);
+    parser.addOption(jobsOption);
+    parser.addOption(readOnlyOption);
+
     parser.process(app);
 
     aboutData.processCommandLine(&parser);
 
+    if (parser.isSet(batchOption)) {
+        QMap<QString, BatchConverter::Format> formats;
+        formats.insert(QStringLiteral("kxs"), BatchConverter::Pattern);
+        formats.insert(QStringLiteral("pdf"), BatchConverter::Chart);
+        formats.insert(QStringLiteral("png"), BatchConverter::PNGImage);
+        formats.insert(QStringLiteral("svg"), BatchConverter::SVGImage);
+
+        QString format = parser.value(formatOption);
+
+        if (!formats.contains(format)) {
+            qCritical("%s", qPrintable(i18n("The format %1 is not supported.", format)));
+            return 1;
+        }
+
+        if (parser.isSet(jobsOption) && (parser.value(jobsOption).toInt() > 0)) {
+            QThreadPool::globalInstance()->setMaxThreadCount(parser.value(jobsOption).toInt());
+        }
+
+        BatchConverter converter(formats.value(format), parser.value(outputOption));
+
+        if (parser.value(resolutionOption).toInt() > 0) {
+            converter.setResolution(parser.value(resolutionOption).toInt());
+        }
+
+        return converter.run(parser.positionalArguments());
+    }
+
     MainWindow *mainWindow;
 
     QStringList urls = parser.positionalArguments();
@@ -132,11 +193,23 @@ int main(int argc, char *argv[])
         mainWindow->show();
     } else {
         foreach (const QString &url, urls) {
-            mainWindow = new MainWindow(url);
+            if (parser.isSet(readOnlyOption)) {
+                mainWindow = new MainWindow(QUrl::fromUserInput(url, QDir::currentPath()), true);
+            } else {
+                mainWindow = new MainWindow(url);
+            }
+
             mainWindow->show();
         }
     }
 
+    // offer to recover unsaved documents left by an earlier instance
+    foreach (const QString &journal, Journal::orphans()) {
+        mainWindow = new MainWindow(QUrl());
+        mainWindow->show();
+        mainWindow->recoverJournal(journal);
+    }
+
 #if 0
     if (app.isSessionRestored()) {
         kRestoreMainWindows<MainWindow>();
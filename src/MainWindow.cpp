@@ -11,13 +11,18 @@
 
 #include "MainWindow.h"
 
+#include <algorithm>
+
 #include <QAction>
 #include <QActionGroup>
 #include <QClipboard>
 #include <QDataStream>
 #include <QDockWidget>
 #include <QFileDialog>
+#include <QFutureInterface>
+#include <QFutureWatcher>
 #include <QGridLayout>
+#include <QInputDialog>
 #include <QMenu>
 #include <QMimeData>
 #include <QPainter>
@@ -32,6 +37,7 @@
 #include <QTemporaryFile>
 #include <QUndoView>
 #include <QUrl>
+#include <QtConcurrent>
 
 #include <KActionCollection>
 #include <KConfigDialog>
@@ -44,7 +50,9 @@
 #include <KXMLGUIFactory>
 
 #include "BackgroundImage.h"
+#include "ChartExporter.h"
 #include "configuration.h"
+#include "ConfettiFilter.h"
 #include "ConfigurationDialogs.h"
 #include "Commands.h"
 #include "Document.h"
@@ -53,7 +61,9 @@
 #include "FilePropertiesDlg.h"
 #include "Floss.h"
 #include "FlossScheme.h"
+#include "ImageConverter.h"
 #include "ImportImageDlg.h"
+#include "Journal.h"
 #include "Palette.h"
 #include "PaletteManagerDlg.h"
 #include "PaperSizes.h"
@@ -68,14 +78,18 @@
 
 
 MainWindow::MainWindow()
-    :   m_printer(nullptr)
+    :   m_printer(nullptr),
+        m_savePending(false),
+        m_readOnly(false)
 {
     setupActions();
 }
 
 
-MainWindow::MainWindow(const QUrl &url)
-    :   m_printer(nullptr)
+MainWindow::MainWindow(const QUrl &url, bool readOnly)
+    :   m_printer(nullptr),
+        m_savePending(false),
+        m_readOnly(readOnly)
 {
     setupMainWindow();
     setupLayout();
@@ -85,15 +99,17 @@ MainWindow::MainWindow(const QUrl &url)
     setupConnections();
     setupActionDefaults();
     loadSettings();
-    fileOpen(url);
+    open(url, readOnly);
     setupActionsFromDocument();
-    setCaption(m_document->url().fileName(), !m_document->undoStack().isClean());
+    documentModified(m_document->undoStack().isClean());
     this->findChild<QDockWidget *>(QStringLiteral("ImportedImage#"))->hide();
 }
 
 
 MainWindow::MainWindow(const QString &source)
-    :   m_printer(nullptr)
+    :   m_printer(nullptr),
+        m_savePending(false),
+        m_readOnly(false)
 {
     setupMainWindow();
     setupLayout();
@@ -156,6 +172,8 @@ void MainWindow::setupDocument()
     m_document->addView(m_editor);
     m_document->addView(m_preview);
     m_document->addView(m_palette);
+
+    m_journal = new Journal(m_document, this);
 }
 
 
@@ -163,6 +181,13 @@ void MainWindow::setupConnections()
 {
     KActionCollection *actions = actionCollection();
 
+    connect(&m_saveWatcher, &QFutureWatcherBase::finished, this, &MainWindow::fileSaved);
+    connect(&m_saveWatcher, &QFutureWatcherBase::progressValueChanged, this, &MainWindow::saveProgress);
+    connect(&m_loadWatcher, &QFutureWatcherBase::resultReadyAt, this, &MainWindow::chunkLoaded);
+    connect(&m_loadWatcher, &QFutureWatcherBase::finished, this, &MainWindow::loadFinished);
+    connect(&m_loadTimer, &QTimer::timeout, this, &MainWindow::drawLoaded);
+    connect(&(m_document->undoStack()), &QUndoStack::indexChanged, m_journal, &Journal::schedule);
+
     connect(&(m_document->undoStack()), &QUndoStack::canUndoChanged, actions->action(QStringLiteral("edit_undo")), &QAction::setEnabled);
     connect(&(m_document->undoStack()), &QUndoStack::canUndoChanged, actions->action(QStringLiteral("file_revert")), &QAction::setEnabled);
     connect(&(m_document->undoStack()), &QUndoStack::canRedoChanged, actions->action(QStringLiteral("edit_redo")), &QAction::setEnabled);
@@ -186,6 +211,7 @@ void MainWindow::setupConnections()
     connect(m_palette, &Palette::signalStateChanged, this, static_cast<void (KXmlGuiWindow::*)(const QString &, bool)>(&KXmlGuiWindow::slotStateChanged));
     connect(m_palette, &Palette::customContextMenuRequested, this, &MainWindow::paletteContextMenu);
     connect(m_editor,  &Editor::changedVisibleCells, m_preview, &Preview::setVisibleCells);
+    connect(m_editor,  &Editor::cellsLoaded, this, &MainWindow::cellsLoaded, Qt::QueuedConnection);
     connect(m_preview, static_cast<void (Preview::*)(QPoint)>(&Preview::clicked), m_editor, static_cast<void (Editor::*)(const QPoint &)>(&Editor::previewClicked));
     connect(m_preview, static_cast<void (Preview::*)(QRect)>(&Preview::clicked), m_editor, static_cast<void (Editor::*)(const QRect &)>(&Editor::previewClicked));
 }
@@ -205,11 +231,16 @@ void MainWindow::setupActionDefaults()
     actions->action(QStringLiteral("toolPaint"))->trigger();    // Select paint tool
 
     clipboardDataChanged();
+
+    setReadOnly(m_readOnly);
 }
 
 
 MainWindow::~MainWindow()
 {
+    m_saveWatcher.waitForFinished();
+    m_loadWatcher.cancel();
+    m_loadWatcher.waitForFinished();
     delete m_printer;
 }
 
@@ -234,6 +265,8 @@ Palette *MainWindow::palette()
 
 bool MainWindow::queryClose()
 {
+    waitForSave();
+
     if (m_document->undoStack().isClean()) {
         return true;
     }
@@ -244,6 +277,7 @@ bool MainWindow::queryClose()
         switch (messageBoxResult) {
         case KMessageBox::Yes :
             fileSave();
+            waitForSave();
 
             if (m_document->undoStack().isClean()) {
                 return true;
@@ -289,76 +323,172 @@ void MainWindow::fileOpen()
 
 
 void MainWindow::fileOpen(const QUrl &url)
+{
+    open(url, false);
+}
+
+
+void MainWindow::fileOpenReadOnly()
+{
+    open(QFileDialog::getOpenFileUrl(this, i18n("Open file read only"), QUrl::fromLocalFile(QDir::homePath()), i18n("KXStitch Patterns (*.kxs);;PC Stitch Patterns (*.pat);;All Files (*)")), true);
+}
+
+
+// switch from viewing a file to editing it, the remaining stitches are decoded in the
+// background and changes are recorded in the journal from now on
+void MainWindow::fileEnableEditing()
+{
+    setReadOnly(false);
+    documentModified(m_document->undoStack().isClean());
+
+    if (Journal::isRecoverable(Journal::path(m_document->url()))) {
+        recoverJournal(Journal::path(m_document->url()));
+    } else {
+        m_journal->reset();
+    }
+
+    loadInBackground();
+}
+
+
+void MainWindow::open(const QUrl &url, bool readOnly)
 {
     MainWindow *window;
     bool docEmpty = (m_document->undoStack().isClean() && (m_document->url().toString() == i18n("Untitled")));
 
     if (url.isValid()) {
         if (docEmpty) {
-            QTemporaryFile tmpFile;
-
-            if (tmpFile.open()) {
-                tmpFile.close();
-
-                KIO::FileCopyJob *job = KIO::file_copy(url, QUrl::fromLocalFile(tmpFile.fileName()), -1, KIO::Overwrite);
-
-                if (job->exec()) {
-                    /* In earlier versions of KDE/Qt creating a QDataStream on tmpFile allowed reading the data from the copied file.
-                     * Somewhere after KDE 5.55.0/Qt 5.9.7 this no longer possible as tmpFile size() is reported with a length of 0
-                     * whereas previously tmpFile size() was reported as the size of the copied file.
-                     * Therefore open a new QFile on the temporary file after downloading to allow reading.
-                     */
-                    QFile reader(tmpFile.fileName());
-                    if (reader.open(QIODevice::ReadOnly)) {
-                        QDataStream stream(&reader);
-
-                        try {
-                            m_document->readKXStitch(stream);
-                            m_document->setUrl(url);
-                            KRecentFilesAction *action = static_cast<KRecentFilesAction *>(actionCollection()->action(QStringLiteral("file_open_recent")));
-                            action->addUrl(url);
-                            action->saveEntries(KConfigGroup(KSharedConfig::openConfig(), QStringLiteral("RecentFiles")));
-                        } catch (const InvalidFile &e) {
-                            stream.device()->seek(0);
-
-                            try {
-                                m_document->readPCStitch(stream);
-                            } catch (const InvalidFile &e) {
-                                KMessageBox::error(nullptr, i18n("The file does not appear to be a recognized cross stitch file."));
-                            }
-                        } catch (const InvalidFileVersion &e) {
-                            KMessageBox::error(nullptr, i18n("This version of the file is not supported.\n%1", e.version));
-                        } catch (const FailedReadFile &e) {
-                            KMessageBox::error(nullptr, i18n("Failed to read the file.\n%1.", e.status));
-                            m_document->initialiseNew();
-                        }
-
-                        setupActionsFromDocument();
-                        m_editor->readDocumentSettings();
-                        m_preview->readDocumentSettings();
-                        m_palette->update();
-                        documentModified(true); // this is the clean value true
-
-                        reader.close();
+            setReadOnly(readOnly);
+
+            if (readOnly && url.isLocalFile()) {
+                // files that are only viewed are read in place rather than copied first
+                read(url, url.toLocalFile());
+            } else {
+                QTemporaryFile tmpFile;
+
+                if (tmpFile.open()) {
+                    tmpFile.close();
+
+                    KIO::FileCopyJob *job = KIO::file_copy(url, QUrl::fromLocalFile(tmpFile.fileName()), -1, KIO::Overwrite);
+
+                    if (job->exec()) {
+                        read(url, tmpFile.fileName());
                     } else {
-                        KMessageBox::error(nullptr, reader.errorString());
+                        KMessageBox::error(nullptr, job->errorString());
                     }
+
+                    tmpFile.close();
                 } else {
-                    KMessageBox::error(nullptr, job->errorString());
+                    KMessageBox::error(nullptr, tmpFile.errorString());
                 }
-
-                tmpFile.close();
-            } else {
-                KMessageBox::error(nullptr, tmpFile.errorString());
             }
         } else {
-            window = new MainWindow(url);
+            window = new MainWindow(url, readOnly);
             window->show();
         }
     }
 }
 
 
+// read the document from a local file, the url itself or a copy of it
+void MainWindow::read(const QUrl &url, const QString &path)
+{
+    /* In earlier versions of KDE/Qt creating a QDataStream on tmpFile allowed reading the data from the copied file.
+     * Somewhere after KDE 5.55.0/Qt 5.9.7 this no longer possible as tmpFile size() is reported with a length of 0
+     * whereas previously tmpFile size() was reported as the size of the copied file.
+     * Therefore open a new QFile on the temporary file after downloading to allow reading.
+     */
+    QFile reader(path);
+    if (reader.open(QIODevice::ReadOnly)) {
+        QDataStream stream(&reader);
+
+        try {
+            m_document->readKXStitch(stream, true);
+            m_document->setUrl(url);
+            KRecentFilesAction *action = static_cast<KRecentFilesAction *>(actionCollection()->action(QStringLiteral("file_open_recent")));
+            action->addUrl(url);
+            action->saveEntries(KConfigGroup(KSharedConfig::openConfig(), QStringLiteral("RecentFiles")));
+        } catch (const InvalidFile &e) {
+            stream.device()->seek(0);
+
+            try {
+                m_document->readPCStitch(stream);
+            } catch (const InvalidFile &e) {
+                KMessageBox::error(nullptr, i18n("The file does not appear to be a recognized cross stitch file."));
+            }
+        } catch (const InvalidFileVersion &e) {
+            KMessageBox::error(nullptr, i18n("This version of the file is not supported.\n%1", e.version));
+        } catch (const FailedReadFile &e) {
+            KMessageBox::error(nullptr, i18n("Failed to read the file.\n%1.", e.status));
+            m_document->initialiseNew();
+        }
+
+        reader.close();
+
+        // the stitches are decoded from here on, drawing the window only uses the rows
+        // that have been decoded and the rest are drawn as they become available
+        loadInBackground();
+
+        setupActionsFromDocument();
+        m_editor->readDocumentSettings();
+        m_preview->readDocumentSettings();
+        m_palette->update();
+        documentModified(true); // this is the clean value true
+
+        // a file that is only viewed is not changed, so there is nothing to journal
+        if (!m_readOnly) {
+            if (Journal::isRecoverable(Journal::path(m_document->url()))) {
+                recoverJournal(Journal::path(m_document->url()));
+            } else {
+                m_journal->reset();
+            }
+        }
+    } else {
+        KMessageBox::error(nullptr, reader.errorString());
+    }
+}
+
+
+// in read only mode the tools and the actions that change the document are disabled
+void MainWindow::setReadOnly(bool readOnly)
+{
+    m_readOnly = readOnly;
+    m_editor->setReadOnly(readOnly);
+    slotStateChanged(QStringLiteral("read_only"), (readOnly) ? KXMLGUIClient::StateNoReverse : KXMLGUIClient::StateReverse);
+
+    // reversing the state enables the tools, the palette disables them again if it is empty
+    m_palette->update();
+    updateBackgroundImageActionLists();
+}
+
+
+// write a snapshot of a document on a worker thread, returning an error message if it fails,
+// the progress of writing the stitches is reported to saving
+static QString saveSnapshot(const DocumentSnapshot &snapshot, const QString &fileName, QFutureInterface<QString> *saving)
+{
+    QSaveFile file(fileName);
+
+    if (!file.open(QIODevice::WriteOnly)) {
+        return QString(i18n("Failed to open the file.\n%1", file.errorString()));
+    }
+
+    QDataStream stream(&file);
+
+    try {
+        snapshot.write(stream, saving);
+
+        if (!file.commit()) {
+            throw FailedWriteFile(stream.status());
+        }
+    } catch (const FailedWriteFile &e) {
+        file.cancelWriting();
+        return QString(i18n("Failed to save the file.\n%1", file.errorString()));
+    }
+
+    return QString();
+}
+
+
 void MainWindow::fileSave()
 {
     QUrl url = m_document->url();
@@ -366,29 +496,187 @@ void MainWindow::fileSave()
     if (url.toString() == i18n("Untitled")) {
         fileSaveAs();
     } else {
-        // ### Why use QUrl everywhere if this only supports local files?
-        QSaveFile file(url.toLocalFile());
+        // only one save at a time, the previous one is normally finished already
+        waitForSave();
+
+        // the journal keeps the changes until the save has finished
+        m_journal->flush();
+
+        try {
+            // the snapshot is written on a worker thread so editing can continue, the
+            // document is clean at the point the snapshot was taken
+            DocumentSnapshot snapshot = m_document->snapshot();
+            m_document->undoStack().setClean();
+            m_savePending = true;
+            setCaption(i18nc("%1 is the file name", "%1 (saving)", url.fileName()), false);
+
+            // ### Why use QUrl everywhere if this only supports local files?
+            QString fileName = url.toLocalFile();
+            QFutureInterface<QString> saving;
+            saving.reportStarted();
+            m_saveWatcher.setFuture(saving.future());
+
+            QtConcurrent::run([saving, snapshot, fileName]() mutable {
+                saving.reportResult(saveSnapshot(snapshot, fileName, &saving));
+                saving.reportFinished();
+            });
+        } catch (const FailedWriteFile &e) {
+            KMessageBox::error(nullptr, QString(i18n("Failed to save the file.\n%1", e.statusMessage())));
+        }
+    }
+}
 
-        if (file.open(QIODevice::WriteOnly)) {
-            QDataStream stream(&file);
 
-            try {
-                m_document->write(stream);
+void MainWindow::saveProgress(int progress)
+{
+    if (m_savePending && m_saveWatcher.progressMaximum()) {
+        setCaption(i18nc("%1 is the file name, %2 the percentage of the stitches written", "%1 (saving %2%)", m_document->url().fileName(), progress * 100 / m_saveWatcher.progressMaximum()), false);
+    }
+}
 
-                if (!file.commit()) {
-                    throw FailedWriteFile(stream.status());
-                }
 
-                m_document->undoStack().setClean();
-            } catch (const FailedWriteFile &e) {
-                KMessageBox::error(nullptr, QString(i18n("Failed to save the file.\n%1", file.errorString())));
-                file.cancelWriting();
-            }
-        } else {
-            KMessageBox::error(nullptr, QString(i18n("Failed to open the file.\n%1", file.errorString())));
+void MainWindow::fileSaved()
+{
+    if (!m_savePending) {
+        return;
+    }
+
+    m_savePending = false;
+    QString error = m_saveWatcher.result();
+
+    if (!error.isEmpty()) {
+        m_document->undoStack().resetClean();
+        KMessageBox::error(nullptr, error);
+    }
+
+    // the changes are either saved or checkpointed in a new journal, there is no journal when viewing
+    if (!m_readOnly) {
+        m_journal->reset();
+    }
+
+    setCaption(m_document->url().fileName(), !m_document->undoStack().isClean());
+}
+
+
+void MainWindow::waitForSave()
+{
+    m_saveWatcher.waitForFinished();
+    fileSaved();
+}
+
+
+// start decoding the stitches and background images that were not decoded when the
+// file was read, the window is redrawn as they become available
+void MainWindow::loadInBackground()
+{
+    m_loadedCells = QRect();
+
+    // when viewing a file the stitches are decoded by the editor as they are drawn
+    if (!m_readOnly) {
+        m_loadWatcher.setFuture(m_document->pattern()->stitches().loadInBackground());
+    }
+
+    auto backgroundImages = m_document->backgroundImages().backgroundImages();
+
+    while (backgroundImages.hasNext()) {
+        QSharedPointer<BackgroundImage> backgroundImage = backgroundImages.next();
+
+        if (!backgroundImage->isDecoded()) {
+            QFutureWatcher<QImage> *watcher = new QFutureWatcher<QImage>(this);
+            connect(watcher, &QFutureWatcherBase::finished, this, [=]() {
+                m_editor->drawContents();
+                updateBackgroundImageActionLists();
+                watcher->deleteLater();
+            });
+            watcher->setFuture(backgroundImage->decoding());
+        }
+    }
+}
+
+
+void MainWindow::chunkLoaded(int chunk)
+{
+    QRect cells = m_document->pattern()->stitches().loadChunk(chunk);
+
+    if (cells.isValid()) {
+        m_loadedCells |= cells;
+
+        if (!m_loadTimer.isActive()) {
+            m_loadTimer.start(250);
         }
     }
+}
 
+
+void MainWindow::drawLoaded()
+{
+    m_loadTimer.stop();
+
+    if (m_loadedCells.isValid()) {
+        m_editor->drawContents(m_loadedCells);
+        m_preview->drawContents();
+        m_loadedCells = QRect();
+    }
+}
+
+
+// when viewing a file the preview only shows the rows the editor has decoded, so it
+// is redrawn as more are decoded rather than decoding the whole pattern itself
+void MainWindow::cellsLoaded()
+{
+    m_preview->drawContents();
+
+    if (m_document->pattern()->stitches().takeLoadFailure()) {
+        KMessageBox::error(nullptr, i18n("Failed to read the stitch data of the file, some stitches may be missing."));
+    }
+}
+
+
+void MainWindow::loadFinished()
+{
+    // chunks decoded on demand are not reported by the watcher
+    loadStitches();
+    m_loadedCells = QRect();
+    m_loadTimer.stop();
+    m_editor->drawContents();
+    m_preview->drawContents();
+    m_palette->update();
+}
+
+
+// decode the stitches that have not been decoded yet, the stitches that could be decoded
+// are still used when a chunk of the file is damaged
+void MainWindow::loadStitches()
+{
+    try {
+        m_document->pattern()->stitches().load();
+    } catch (const FailedReadFile &e) {
+        KMessageBox::error(nullptr, i18n("Failed to read the stitch data of the file, some stitches may be missing."));
+    }
+}
+
+
+void MainWindow::recoverJournal(const QString &path)
+{
+    if (KMessageBox::questionYesNo(this, i18n("Changes to this document were not saved when KXStitch last closed.\nDo you want to recover them?"), i18n("Recover Changes")) == KMessageBox::Yes) {
+        try {
+            m_journal->recover(path);
+        } catch (const InvalidFileVersion &e) {
+            KMessageBox::error(nullptr, i18n("This version of the recovery file is not supported.\n%1", e.version));
+        } catch (const FailedReadFile &e) {
+            KMessageBox::error(nullptr, i18n("Failed to read the recovery file.\n%1.", e.status));
+        }
+
+        setupActionsFromDocument();
+        m_editor->readDocumentSettings();
+        m_preview->readDocumentSettings();
+        m_palette->update();
+        documentModified(m_document->undoStack().isClean());
+    } else {
+        QFile::remove(path);
+    }
+
+    m_journal->reset();
 }
 
 
@@ -426,6 +714,8 @@ void MainWindow::fileRevert()
 
 void MainWindow::filePrintSetup()
 {
+    loadStitches();
+
     if (m_printer == nullptr) {
         m_printer = new QPrinter();
     }
@@ -466,6 +756,8 @@ void MainWindow::filePrint()
 
 void MainWindow::printPages()
 {
+    loadStitches();
+
     QList<Page *> pages = m_document->printerConfiguration().pages();
 
     int fromPage = 1;
@@ -542,53 +834,47 @@ void MainWindow::fileImportImage()
 
 void MainWindow::convertImage(const QString &source)
 {
-    Magick::Image image(source.toStdString());
+    QSize sourceSize;
+    Magick::Image image = ImageConverter::load(source, Configuration::import_MaximumImageSize(), sourceSize);
 
-    QMap<int, QColor> documentFlosses;
-    QList<qint16> symbolIndexes = SymbolManager::library(Configuration::palette_DefaultSymbolLibrary())->indexes();
-
-    QPointer<ImportImageDlg> importImageDlg = new ImportImageDlg(this, image);
+    QPointer<ImportImageDlg> importImageDlg = new ImportImageDlg(this, image, sourceSize);
 
     if (importImageDlg->exec()) {
-        Magick::Image convertedImage = importImageDlg->convertedImage();
+        QImage pixels = ImageConverter::pixels(importImageDlg->convertedImage(), importImageDlg->ignoreColor(), importImageDlg->ignoreColorValue());
 
-        int imageWidth = convertedImage.columns();
-        int imageHeight = convertedImage.rows();
-        int documentWidth = imageWidth;
+        int imageHeight = pixels.height();
+        int documentWidth = pixels.width();
         int documentHeight = imageHeight;
 
         bool useFractionals = importImageDlg->useFractionals();
 
-/*
- * ImageMagick prior to V7 used matte (opacity) to determine if an image has transparency.
- * 0.0 for transparent to 1.0 for opaque
- *
- * ImageMagick V7 now uses alpha (transparency).
- * 1.0 for transparent to 0.0 for opaque
- *
- * Access to pixels has changed too, V7 can use pixelColor to access the color of a particular
- * pixel, but although this was available in V6, it doesn't appear to produce the same result
- * and has resulted in black images when importing.
- */
-#if MagickLibVersion < 0x700
-        bool hasTransparency = convertedImage.matte();
-        double transparent = 1.0;
-        const Magick::PixelPacket *pixels = convertedImage.getConstPixels(0, 0, imageWidth, imageHeight);
-#else
-        bool hasTransparency = convertedImage.alpha();
-        double transparent = 0.0;
-#endif
-
-        bool ignoreColor = importImageDlg->ignoreColor();
-        Magick::Color ignoreColorValue = importImageDlg->ignoreColorValue();
-
-        int pixelCount = imageWidth * imageHeight;
-
         if (useFractionals) {
             documentWidth /= 2;
             documentHeight /= 2;
         }
 
+        // the rows are converted to runs of colors on the thread pool, the progress dialog
+        // follows the conversion through the watcher and closes when it is finished
+        QFutureWatcher<ImageConverter::Runs> watcher;
+        QProgressDialog progress(i18n("Converting to stitches"), i18n("Cancel"), 0, imageHeight, this);
+        progress.setWindowModality(Qt::WindowModal);
+        connect(&watcher, &QFutureWatcherBase::progressRangeChanged, &progress, &QProgressDialog::setRange);
+        connect(&watcher, &QFutureWatcherBase::progressValueChanged, &progress, &QProgressDialog::setValue);
+        connect(&watcher, &QFutureWatcherBase::finished, &progress, &QProgressDialog::reset);
+        connect(&progress, &QProgressDialog::canceled, &watcher, &QFutureWatcherBase::cancel);
+        watcher.setFuture(ImageConverter::convert(pixels));
+
+        if (!watcher.isFinished()) {
+            progress.exec();
+        }
+
+        watcher.waitForFinished();
+
+        if (watcher.isCanceled()) {
+            delete importImageDlg;
+            return;
+        }
+
         QString schemeName = importImageDlg->flossScheme();
         FlossScheme *flossScheme = SchemeManager::scheme(schemeName);
 
@@ -596,80 +882,73 @@ void MainWindow::convertImage(const QString &source)
         new ResizeDocumentCommand(m_document, documentWidth, documentHeight, importImageCommand);
         new ChangeSchemeCommand(m_document, schemeName, importImageCommand);
 
-        QProgressDialog progress(i18n("Converting to stitches"), i18n("Cancel"), 0, pixelCount, this);
-        progress.setWindowModality(Qt::WindowModal);
+        QList<DocumentFloss *> flosses;
+        QVector<QPoint> cells;
+        QVector<StitchQueue *> cellQueues;
 
-        for (int dy = 0 ; dy < imageHeight ; dy++) {
-            progress.setValue(dy * imageWidth);
-            QApplication::processEvents();
+        ImageConverter::createStitches(watcher.future().results(), pixels.width(), useFractionals, flossScheme, flosses, cells, cellQueues);
 
-            if (progress.wasCanceled()) {
-                delete importImageDlg;
-                delete importImageCommand;
-                return;
-            }
-
-            for (int dx = 0 ; dx < imageWidth ; dx++) {
-#if MagickLibVersion < 0x700
-                Magick::ColorRGB rgb = Magick::Color(*pixels++);
-#else
-                Magick::ColorRGB rgb = convertedImage.pixelColor(dx, dy);
-#endif
-
-                if (hasTransparency && (rgb.alpha() == transparent)) {
-                    // ignore this pixel as it is transparent
-                } else {
-                    if (!(ignoreColor && (rgb == ignoreColorValue))) {
-                        int flossIndex;
-                        QColor color((int)(255*rgb.red()), (int)(255*rgb.green()), (int)(255*rgb.blue()));
-
-                        for (flossIndex = 0 ; flossIndex < documentFlosses.count() ; ++flossIndex) {
-                            if (documentFlosses[flossIndex] == color) {
-                                break;
-                            }
-                        }
-
-                        if (flossIndex == documentFlosses.count()) { // reached the end of the list
-                            qint16 stitchSymbol = symbolIndexes.takeFirst();
-                            Qt::PenStyle backstitchSymbol(Qt::SolidLine);
-                            Floss *floss = flossScheme->find(color);
-
-                            DocumentFloss *documentFloss = new DocumentFloss(floss->name(), stitchSymbol, backstitchSymbol, Configuration::palette_StitchStrands(), Configuration::palette_BackstitchStrands());
-                            documentFloss->setFlossColor(floss->color());
-                            new AddDocumentFlossCommand(m_document, flossIndex, documentFloss, importImageCommand);
-                            documentFlosses.insert(flossIndex, color);
-                        }
-
-                        // at this point
-                        //   flossIndex will be the index for the found color
-                        if (useFractionals) {
-                            int zone = (dy % 2) * 2 + (dx % 2);
-                            new AddStitchCommand(m_document, QPoint(dx / 2, dy / 2), stitchMap[0][zone], flossIndex, importImageCommand);
-                        } else {
-                            new AddStitchCommand(m_document, QPoint(dx, dy), Stitch::Full, flossIndex, importImageCommand);
-                        }
-                    }
-                }
-            }
+        for (int flossIndex = 0 ; flossIndex < flosses.count() ; ++flossIndex) {
+            new AddDocumentFlossCommand(m_document, flossIndex, flosses.at(flossIndex), importImageCommand);
         }
 
+        new ReplaceStitchQueuesCommand(m_document, i18n("Add Stitches"), cells, cellQueues, importImageCommand);
         new SetPropertyCommand(m_document, QStringLiteral("horizontalClothCount"), importImageDlg->horizontalClothCount(), importImageCommand);
         new SetPropertyCommand(m_document, QStringLiteral("verticalClothCount"), importImageDlg->verticalClothCount(), importImageCommand);
         m_document->undoStack().push(importImageCommand);
 
-        convertPreview(source, importImageDlg->croppedArea());
+        QRect croppedArea = importImageDlg->croppedArea();
+        image.crop(Magick::Geometry(croppedArea.width(), croppedArea.height(), croppedArea.left(), croppedArea.top()));
+        convertPreview(ImageConverter::pixels(image, false, Magick::ColorRGB()));
     }
 
     delete importImageDlg;
 }
 
 
-void MainWindow::convertPreview(const QString &source, const QRect &croppedArea)
+void MainWindow::convertPreview(const QImage &image)
 {
-    QPixmap pixmap;
-    pixmap.load(source);
-    pixmap = pixmap.copy(croppedArea);
-    m_imageLabel->setPixmap(pixmap);
+    m_imageLabel->setPixmap(QPixmap::fromImage(image));
+}
+
+
+void MainWindow::fileExportChart()
+{
+    QString fileName = QFileDialog::getSaveFileName(this, i18n("Export Chart"), QDir::homePath(), i18n("PNG Images (*.png);;SVG Images (*.svg)"));
+
+    if (fileName.isEmpty()) {
+        return;
+    }
+
+    bool ok;
+    int resolution = QInputDialog::getInt(this, i18n("Export Chart"), i18n("Resolution in dots per inch"), 300, 10, 4800, 10, &ok);
+
+    if (!ok) {
+        return;
+    }
+
+    // the stitches are loaded here as the chart is rendered on a worker thread
+    loadStitches();
+
+    ChartExporter exporter(m_document, resolution);
+    exporter.setRenderer(m_editor->renderer());
+
+    // the dialog prevents the document being changed whilst it is exported
+    QFutureWatcher<QString> watcher;
+    QProgressDialog progress(i18n("Exporting chart"), QString(), 0, 0, this);
+    progress.setWindowModality(Qt::WindowModal);
+    connect(&watcher, &QFutureWatcherBase::finished, &progress, &QProgressDialog::reset);
+    watcher.setFuture(QtConcurrent::run(&exporter, &ChartExporter::write, fileName));
+
+    if (!watcher.isFinished()) {
+        progress.exec();
+    }
+
+    watcher.waitForFinished();
+
+    if (!watcher.result().isEmpty()) {
+        KMessageBox::error(nullptr, watcher.result());
+    }
 }
 
 
@@ -937,6 +1216,27 @@ void MainWindow::patternCropToSelection()
 }
 
 
+void MainWindow::patternRemoveConfetti()
+{
+    StitchData &stitches = m_document->pattern()->stitches();
+    QRect area = m_editor->selectionArea();
+
+    if (!area.isValid()) {
+        area = QRect(0, 0, stitches.width(), stitches.height());
+    }
+
+    QVector<QPoint> cells;
+    QVector<StitchQueue *> queues;
+    ConfettiFilter::filter(stitches, area, Configuration::import_ConfettiSize(), cells, queues);
+
+    if (!cells.isEmpty()) {
+        QUndoCommand *removeConfettiCommand = new RemoveConfettiCommand(m_document);
+        new ReplaceStitchQueuesCommand(m_document, i18n("Remove Confetti"), cells, queues, removeConfettiCommand);
+        m_document->undoStack().push(removeConfettiCommand);
+    }
+}
+
+
 void MainWindow::insertColumns()
 {
     m_document->undoStack().push(new InsertColumnsCommand(m_document, m_editor->selectionArea()));
@@ -1108,7 +1408,11 @@ void MainWindow::loadSettings()
 
 void MainWindow::documentModified(bool clean)
 {
-    setCaption(m_document->url().fileName(), !clean);
+    if (m_readOnly) {
+        setCaption(i18nc("%1 is the file name", "%1 (read only)", m_document->url().fileName()), false);
+    } else {
+        setCaption(m_document->url().fileName(), !clean);
+    }
 }
 
 
@@ -1123,6 +1427,19 @@ void MainWindow::setupActions()
     KStandardAction::openNew(this, &MainWindow::fileNew, actions);
     KStandardAction::open(this, static_cast<void (MainWindow::*)()>(&MainWindow::fileOpen), actions);
     KStandardAction::openRecent(this, static_cast<void (MainWindow::*)(const QUrl &)>(&MainWindow::fileOpen), actions)->loadEntries(KConfigGroup(KSharedConfig::openConfig(), QStringLiteral("RecentFiles")));
+
+    action = new QAction(this);
+    action->setText(i18n("Open Read Only..."));
+    action->setIcon(QIcon::fromTheme(QStringLiteral("document-preview")));
+    connect(action, &QAction::triggered, this, &MainWindow::fileOpenReadOnly);
+    actions->addAction(QStringLiteral("fileOpenReadOnly"), action);
+
+    action = new QAction(this);
+    action->setText(i18n("Enable Editing"));
+    action->setIcon(QIcon::fromTheme(QStringLiteral("document-edit")));
+    connect(action, &QAction::triggered, this, &MainWindow::fileEnableEditing);
+    actions->addAction(QStringLiteral("fileEnableEditing"), action);
+
     KStandardAction::save(this, &MainWindow::fileSave, actions);
     KStandardAction::saveAs(this, &MainWindow::fileSaveAs, actions);
     KStandardAction::revert(this, &MainWindow::fileRevert, actions);
@@ -1139,6 +1456,11 @@ void MainWindow::setupActions()
     connect(action, &QAction::triggered, this, &MainWindow::fileImportImage);
     actions->addAction(QStringLiteral("fileImportImage"), action);
 
+    action = new QAction(this);
+    action->setText(i18n("Export Chart..."));
+    connect(action, &QAction::triggered, this, &MainWindow::fileExportChart);
+    actions->addAction(QStringLiteral("fileExportChart"), action);
+
     action = new QAction(this);
     action->setText(i18n("File Properties"));
     connect(action, &QAction::triggered, this, &MainWindow::fileProperties);
@@ -1473,6 +1795,11 @@ void MainWindow::setupActions()
     action->setEnabled(false);
     actions->addAction(QStringLiteral("patternCropToSelection"), action);
 
+    action = new QAction(this);
+    action->setText(i18n("Remove Confetti"));
+    connect(action, &QAction::triggered, this, &MainWindow::patternRemoveConfetti);
+    actions->addAction(QStringLiteral("patternRemoveConfetti"), action);
+
     action = new QAction(this);
     action->setText(i18n("Insert Rows"));
     connect(action, &QAction::triggered, this, &MainWindow::insertRows);
@@ -1675,11 +2002,15 @@ void MainWindow::updateBackgroundImageActionLists()
     while (backgroundImages.hasNext()) {
         QSharedPointer<BackgroundImage> backgroundImage = backgroundImages.next();
 
-        QAction *action = new QAction(backgroundImage->url().fileName(), this);
-        action->setData(QVariant::fromValue(backgroundImage));
-        action->setIcon(backgroundImage->icon());
-        connect(action, &QAction::triggered, this, &MainWindow::fileRemoveBackgroundImage);
-        removeBackgroundImageActions.append(action);
+        QAction *action;
+
+        if (!m_readOnly) {
+            action = new QAction(backgroundImage->url().fileName(), this);
+            action->setData(QVariant::fromValue(backgroundImage));
+            action->setIcon(backgroundImage->icon());
+            connect(action, &QAction::triggered, this, &MainWindow::fileRemoveBackgroundImage);
+            removeBackgroundImageActions.append(action);
+        }
 
         action = new QAction(backgroundImage->url().fileName(), this);
         action->setData(QVariant::fromValue(backgroundImage));
@@ -13,9 +13,15 @@
 #define MainWindow_H
 
 
+#include <QFutureWatcher>
+#include <QRect>
+#include <QTimer>
+#include <QVector>
+
 #include <KXmlGuiWindow>
 
 
+class QImage;
 class QPrinter;
 class QString;
 class QUndoView;
@@ -23,11 +29,13 @@ class QUrl;
 
 class Document;
 class Editor;
+class Journal;
 class Palette;
 class Preview;
 class Scale;
 class ScaledPixmapLabel;
 class SchemeManager;
+class StitchQueue;
 
 
 class MainWindow : public KXmlGuiWindow
@@ -36,7 +44,7 @@ class MainWindow : public KXmlGuiWindow
 
 public:
     MainWindow();
-    explicit MainWindow(const QUrl &);
+    explicit MainWindow(const QUrl &, bool readOnly = false);
     explicit MainWindow(const QString &);
     virtual ~MainWindow();
 
@@ -48,6 +56,8 @@ public:
 
     void updateBackgroundImageActionLists();
 
+    void recoverJournal(const QString &);
+
 protected:
     virtual bool queryClose() Q_DECL_OVERRIDE;
 
@@ -56,6 +66,8 @@ protected slots:
     void fileNew();
     void fileOpen();
     void fileOpen(const QUrl &);
+    void fileOpenReadOnly();
+    void fileEnableEditing();
     void fileSave();
     void fileSaveAs();
     void fileRevert();
@@ -63,6 +75,7 @@ protected slots:
     void filePrint();
     void printPages();
     void fileImportImage();
+    void fileExportChart();
     void fileProperties();
     void fileAddBackgroundImage();
     void fileRemoveBackgroundImage();
@@ -97,6 +110,7 @@ protected slots:
     void patternCentre();
     void patternCrop();
     void patternCropToSelection();
+    void patternRemoveConfetti();
     void insertColumns();
     void insertRows();
 
@@ -108,6 +122,12 @@ protected slots:
 
 private slots:
     void paletteContextMenu(const QPoint &);
+    void fileSaved();
+    void saveProgress(int);
+    void chunkLoaded(int);
+    void drawLoaded();
+    void cellsLoaded();
+    void loadFinished();
 
 private:
     void setupMainWindow();
@@ -118,11 +138,18 @@ private:
     void setupConnections();
     void setupActionDefaults();
     void setupActionsFromDocument();
+    void open(const QUrl &, bool);
+    void read(const QUrl &, const QString &);
+    void setReadOnly(bool);
     void convertImage(const QString &);
-    void convertPreview(const QString &, const QRect &);
+    void convertPreview(const QImage &);
+    void waitForSave();
+    void loadInBackground();
+    void loadStitches();
     QPrinter *printer();
 
     Document    *m_document;
+    Journal     *m_journal;
     Editor      *m_editor;
     Palette     *m_palette;
     Preview     *m_preview;
@@ -134,6 +161,15 @@ private:
     Scale       *m_verticalScale;
 
     QPrinter    *m_printer;
+
+    QFutureWatcher<QString> m_saveWatcher;
+    bool        m_savePending;
+
+    bool        m_readOnly;     // viewing an archived file, stitches are decoded as they are drawn
+
+    QFutureWatcher<QVector<StitchQueue *> > m_loadWatcher;
+    QTimer      m_loadTimer;    // limits redrawing while the stitches are loaded
+    QRect       m_loadedCells;  // cells loaded since they were last drawn
 };
 
 
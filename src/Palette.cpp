@@ -348,7 +348,7 @@ void Palette::paintEvent(QPaintEvent *)
                 QTransform transform = scale * QTransform::fromTranslate(x, y);
                 painter.setTransform(transform);
 
-                Symbol symbol = library->symbol(palette[m_paletteIndex[flossIndex]]->stitchSymbol());
+                const Symbol &symbol = library->symbol(palette[m_paletteIndex[flossIndex]]->stitchSymbol());
                 QPen pen = symbol.pen();
                 QBrush brush = symbol.brush();
 
@@ -156,7 +156,7 @@ void PaletteManagerDlg::on_CurrentList_currentRowChanged(int currentRow)
         const DocumentFloss *floss = m_dialogPalette.flosses().value(i);
         ui.StitchStrands->setCurrentIndex(floss->stitchStrands() - 1);
         ui.BackstitchStrands->setCurrentIndex(floss->backstitchStrands() - 1);
-        Symbol symbol = SymbolManager::library(m_dialogPalette.symbolLibrary())->symbol(m_dialogPalette.flosses().value(i)->stitchSymbol());
+        const Symbol &symbol = SymbolManager::library(m_dialogPalette.symbolLibrary())->symbol(m_dialogPalette.flosses().value(i)->stitchSymbol());
         ui.StitchSymbol->setIcon(SymbolListWidget::createIcon(symbol, 22));
         ui.BackstitchSymbol->setCurrentIndex(mapStyleToIndex(floss->backstitchSymbol()));
         ui.StitchStrands->setEnabled(true);
@@ -269,6 +269,41 @@ void Pattern::paste(Pattern *pattern, const QPoint &cell, bool merge)
 }
 
 
+PatternSnapshot Pattern::snapshot() const
+{
+    PatternSnapshot snapshot;
+
+    snapshot.m_version = version;
+
+    // streamed in the version documents are written with, so the document keeps its
+    // floss objects, which undo commands refer to, instead of sharing them
+    QDataStream palette(&snapshot.m_documentPalette, QIODevice::WriteOnly);
+    palette.setVersion(QDataStream::Qt_4_0);
+    palette << m_documentPalette;
+
+    snapshot.m_stitchData = m_stitchData.snapshot();
+
+    return snapshot;
+}
+
+
+void PatternSnapshot::write(QDataStream &stream, QFutureInterfaceBase *progress) const
+{
+    stream << m_version;
+
+    stream.writeRawData(m_documentPalette.constData(), m_documentPalette.size());
+    m_stitchData.write(stream, progress);
+}
+
+
+QDataStream &operator<<(QDataStream &stream, const PatternSnapshot &snapshot)
+{
+    snapshot.write(stream, nullptr);
+
+    return stream;
+}
+
+
 QDataStream &operator<<(QDataStream &stream, const Pattern &pattern)
 {
     stream << qint32(pattern.version);
@@ -13,6 +13,8 @@
 #define Pattern_H
 
 
+#include <QByteArray>
+
 #include "DocumentPalette.h"
 #include "StitchData.h"
 
@@ -20,6 +22,22 @@
 class Document;
 
 
+class PatternSnapshot
+{
+public:
+    void write(QDataStream &, QFutureInterfaceBase *) const;
+
+    friend QDataStream &operator<<(QDataStream &, const PatternSnapshot &);
+
+private:
+    friend class Pattern;
+
+    qint32              m_version;
+    QByteArray          m_documentPalette;  // streamed when the snapshot is taken, sharing the palette would share its flosses
+    StitchDataSnapshot  m_stitchData;
+};
+
+
 class Pattern
 {
 public:
@@ -35,6 +53,8 @@ public:
     Pattern *copy(const QRect &area, int colorMask, const QList<Stitch::Type> &stitchMask, bool excludeBackstitches, bool excludeKnots);
     void paste(Pattern *pattern, const QPoint &cell, bool merge);
 
+    PatternSnapshot snapshot() const;
+
     friend QDataStream &operator<<(QDataStream &stream, const Pattern &pattern);
     friend QDataStream &operator>>(QDataStream &stream, Pattern &pattern);
 
@@ -49,6 +69,7 @@ private:
 };
 
 
+QDataStream &operator<<(QDataStream &, const PatternSnapshot &);
 QDataStream &operator<<(QDataStream &, const Pattern &);
 QDataStream &operator>>(QDataStream &, Pattern &);
 
@@ -316,6 +316,12 @@ void Renderer::render(QPainter *painter,
         QTransform transform = painter->transform();
 
         for (int y = patternTop ; y <= patternBottom ; ++y) {
+            // rows that have not been decoded are rendered when they are available, the
+            // renderer never decodes them itself as the preview would decode the whole pattern
+            if (!pattern->stitches().isLoaded(y)) {
+                continue;
+            }
+
             for (int x = patternLeft ; x <= patternRight ; ++x) {
                 if (StitchQueue *queue = pattern->stitches().stitchQueueAt(QPoint(x, y))) {
                     painter->translate(x, y);
@@ -326,11 +332,19 @@ void Renderer::render(QPainter *painter,
         }
     }
 
+    // backstitches and knots are in snap coordinates, those outside the cells are not rendered
+    // allowing a cell around them for the width of the lines and the size of the knots
+    QRect snapArea(patternLeft * 2 - 2, patternTop * 2 - 2, patternWidth * 2 + 4, patternHeight * 2 + 4);
+
     if (renderBackstitches) {
         QList<Backstitch*> backstitches = pattern->stitches().backstitches();
 
         for (int i = 0 ; i < backstitches.count() ; ++i) {
-            (this->*renderBackstitchCallPointers[d->m_renderBackstitchesAs])(backstitches.at(i));
+            Backstitch *backstitch = backstitches.at(i);
+
+            if (QRect(backstitch->start, backstitch->end).normalized().intersects(snapArea)) {
+                (this->*renderBackstitchCallPointers[d->m_renderBackstitchesAs])(backstitch);
+            }
         }
     }
 
@@ -338,7 +352,9 @@ void Renderer::render(QPainter *painter,
         QList<Knot*> knots = pattern->stitches().knots();
 
         for (int i = 0 ; i < knots.count() ; ++i) {
-            (this->*renderKnotCallPointers[d->m_renderKnotsAs])(knots.at(i));
+            if (snapArea.contains(knots.at(i)->position)) {
+                (this->*renderKnotCallPointers[d->m_renderKnotsAs])(knots.at(i));
+            }
         }
     }
 
@@ -469,7 +485,7 @@ void Renderer::renderStitchesAsBlackWhiteSymbols(StitchQueue *stitchQueue)
     while (i) {
         Stitch *stitch = stitchQueue->at(--i);
         DocumentFloss *documentFloss = d->m_pattern->palette().flosses().value(stitch->colorIndex);
-        Symbol symbol = d->m_symbolLibrary->symbol(documentFloss->stitchSymbol());
+        const Symbol &symbol = d->m_symbolLibrary->symbol(documentFloss->stitchSymbol());
 
         QPen symbolPen = symbol.pen();
         QBrush symbolBrush = symbol.brush();
@@ -500,7 +516,7 @@ void Renderer::renderStitchesAsColorSymbols(StitchQueue *stitchQueue)
     while (i) {
         Stitch *stitch = stitchQueue->at(--i);
         DocumentFloss *documentFloss = d->m_pattern->palette().flosses().value(stitch->colorIndex);
-        Symbol symbol = d->m_symbolLibrary->symbol(documentFloss->stitchSymbol());
+        const Symbol &symbol = d->m_symbolLibrary->symbol(documentFloss->stitchSymbol());
 
         QPen symbolPen = symbol.pen();
         QBrush symbolBrush = symbol.brush();
@@ -644,7 +660,7 @@ void Renderer::renderStitchesAsColorBlocksSymbols(StitchQueue *stitchQueue)
     while (i) {
         Stitch *stitch = stitchQueue->at(--i);
         DocumentFloss *documentFloss = d->m_pattern->palette().flosses().value(stitch->colorIndex);
-        Symbol symbol = d->m_symbolLibrary->symbol(documentFloss->stitchSymbol());
+        const Symbol &symbol = d->m_symbolLibrary->symbol(documentFloss->stitchSymbol());
 
         QPen symbolPen = symbol.pen();
         QBrush symbolBrush = symbol.brush();
@@ -929,7 +945,7 @@ void Renderer::renderKnotsAsColorBlocks(Knot *knot)
 void Renderer::renderKnotsAsColorBlocksSymbols(Knot *knot)
 {
     DocumentFloss *documentFloss = d->m_pattern->palette().floss(knot->colorIndex);
-    Symbol symbol = d->m_symbolLibrary->symbol(documentFloss->stitchSymbol());
+    const Symbol &symbol = d->m_symbolLibrary->symbol(documentFloss->stitchSymbol());
 
     QPen symbolPen = symbol.pen();
     QBrush symbolBrush = symbol.brush();
@@ -964,7 +980,7 @@ void Renderer::renderKnotsAsColorBlocksSymbols(Knot *knot)
 void Renderer::renderKnotsAsColorSymbols(Knot *knot)
 {
     DocumentFloss *documentFloss = d->m_pattern->palette().floss(knot->colorIndex);
-    Symbol symbol = d->m_symbolLibrary->symbol(documentFloss->stitchSymbol());
+    const Symbol &symbol = d->m_symbolLibrary->symbol(documentFloss->stitchSymbol());
 
     QPen outlinePen(Qt::lightGray, 0);
 
@@ -998,7 +1014,7 @@ void Renderer::renderKnotsAsColorSymbols(Knot *knot)
 void Renderer::renderKnotsAsBlackWhiteSymbols(Knot *knot)
 {
     DocumentFloss *documentFloss = d->m_pattern->palette().floss(knot->colorIndex);
-    Symbol symbol = d->m_symbolLibrary->symbol(documentFloss->stitchSymbol());
+    const Symbol &symbol = d->m_symbolLibrary->symbol(documentFloss->stitchSymbol());
 
     QPen outlinePen(Qt::lightGray, 0);
 
@@ -11,18 +11,28 @@
 
 #include "SchemeManager.h"
 
+#include <QCoreApplication>
+#include <QDataStream>
+#include <QDateTime>
 #include <QDir>
 #include <QDirIterator>
 #include <QFile>
 #include <QFileInfo>
+#include <QMutexLocker>
+#include <QSaveFile>
 #include <QStandardPaths>
+#include <QThread>
+#include <QVector>
 #include <QUrl>
 #include <QXmlInputSource>
 #include <QXmlSimpleReader>
+#include <QtDebug>
 
 #include <KLocalizedString>
 #include <KMessageBox>
 
+#include <string.h>
+
 #include "Floss.h"
 #include "FlossScheme.h"
 #include "SchemeParser.h"
@@ -30,13 +40,33 @@
 
 SchemeManager *SchemeManager::schemeManager = nullptr;
 
+
 /**
-    Accessor for the static object
+    Report an error reading a scheme, a message box is only shown on the user interface thread.
+    @param message the error message.
+    */
+static void reportError(const QString &message)
+{
+    if (QCoreApplication::instance() && (QThread::currentThread() == QCoreApplication::instance()->thread())) {
+        KMessageBox::error(nullptr, message, i18n("Error reading floss scheme."));
+    } else {
+        qWarning() << message;
+    }
+}
+
+
+/**
+    Accessor for the static object, this may be first used on a worker thread.
     */
 SchemeManager &SchemeManager::self()
 {
+    static QMutex mutex;
+    QMutexLocker locker(&mutex);
+
     if (schemeManager == nullptr) {
         schemeManager = new SchemeManager();
+        locker.unlock();
+        schemeManager->reportErrors();
     }
 
     return *schemeManager;
@@ -47,7 +77,8 @@ SchemeManager &SchemeManager::self()
     Constructor.
     */
 SchemeManager::SchemeManager()
-    :   QObject()
+    :   QObject(),
+        m_cacheData(nullptr)
 {
     /** Refresh the list of floss schemes. */
     refresh();
@@ -59,7 +90,9 @@ SchemeManager::SchemeManager()
     */
 SchemeManager::~SchemeManager()
 {
-    qDeleteAll(m_flossSchemes);
+    foreach (const SchemeFile &schemeFile, m_schemeFiles) {
+        delete schemeFile.flossScheme;
+    }
 }
 
 
@@ -76,7 +109,8 @@ FlossScheme *SchemeManager::createScheme(QString schemeName)
     if (scheme(schemeName) == nullptr) {
         if ((flossScheme = new FlossScheme)) {
             flossScheme->setSchemeName(schemeName);
-            self().m_flossSchemes.append(flossScheme);
+            QMutexLocker locker(&self().m_mutex);
+            self().addSchemeFile(SchemeFile{schemeName, QString(), -1, -1, -1, flossScheme, false});
         }
     }
 
@@ -85,17 +119,20 @@ FlossScheme *SchemeManager::createScheme(QString schemeName)
 
 
 /**
-    Get a list of the FlossSchemes available.
+    Get a list of the FlossSchemes available, this does not read the schemes.
+    A scheme hidden by an earlier one of the same name is not listed.
     @return QStringList of scheme names.
     */
 QStringList SchemeManager::schemes()
 {
     QStringList schemeNames;
+    QMutexLocker locker(&self().m_mutex);
+    const QList<SchemeFile> &schemeFiles = self().m_schemeFiles;
 
-    QListIterator<FlossScheme *> i(self().m_flossSchemes);
-
-    while (i.hasNext()) {
-        schemeNames.append(i.next()->schemeName());
+    for (int i = 0 ; i < schemeFiles.count() ; ++i) {
+        if (self().m_schemeIndexes.value(schemeFiles.at(i).name) == i) {
+            schemeNames.append(schemeFiles.at(i).name);
+        }
     }
 
     return schemeNames;
@@ -103,25 +140,27 @@ QStringList SchemeManager::schemes()
 
 
 /**
-    Get a pointer to a scheme by name
+    Get a pointer to a scheme by name, reading it if this is the first time it has been used.
     @param name of the scheme required.
     @return pointer to the FlossScheme instance, returns null if no scheme found.
     */
 FlossScheme *SchemeManager::scheme(QString name)
 {
-    FlossScheme *flossScheme;
-
-    QListIterator<FlossScheme *> i(self().m_flossSchemes);
+    SchemeManager &schemeManager = self();
+    FlossScheme *flossScheme = nullptr;
 
-    while (i.hasNext()) {
-        flossScheme = i.next();
+    {
+        QMutexLocker locker(&schemeManager.m_mutex);
+        int i = schemeManager.m_schemeIndexes.value(name, -1);
 
-        if (flossScheme->schemeName() == name) {
-            return flossScheme;
+        if (i != -1) {
+            flossScheme = schemeManager.load(schemeManager.m_schemeFiles[i]);
         }
     }
 
-    return nullptr;
+    schemeManager.reportErrors();
+
+    return flossScheme;
 }
 
 
@@ -131,32 +170,67 @@ FlossScheme *SchemeManager::scheme(QString name)
     @return pointer to the FlossScheme instance created.
     */
 FlossScheme *SchemeManager::readScheme(QString name)
+{
+    QString error;
+    FlossScheme *flossScheme = parseScheme(name, error);
+
+    if (!error.isEmpty()) {
+        reportError(error);
+    }
+
+    return flossScheme;
+}
+
+
+/**
+    Parse a scheme without reporting errors, this may be called on any thread.
+    @param path path to the xml file to be read.
+    @param error a reference to a QString set to the error message if the scheme could not be read.
+    @return pointer to the FlossScheme instance created, null if it could not be read.
+    */
+FlossScheme *SchemeManager::parseScheme(const QString &path, QString &error)
 {
     SchemeParser handler;
-    QFile xmlFile(name);
+    QFile xmlFile(path);
     QXmlInputSource source(&xmlFile);
     QXmlSimpleReader reader;
     reader.setContentHandler(&handler);
 
     bool success = reader.parse(source);
 
-    if (!success) {
-        KMessageBox::error(nullptr, i18n("Error reading scheme %1\n%2.", name, handler.errorString()), i18n("Error reading floss scheme."));
-    }
-
     FlossScheme *flossScheme = handler.flossScheme();
 
     if (!success) {
+        error = i18n("Error reading scheme %1\n%2.", path, handler.errorString());
         delete flossScheme;
         flossScheme = nullptr;
     } else {
-        flossScheme->setPath(name);
+        flossScheme->setPath(path);
     }
 
     return flossScheme;
 }
 
 
+/**
+    Report the errors from reading schemes, called when the mutex is not held as the message boxes
+    run an event loop that may use the schemes.
+    */
+void SchemeManager::reportErrors()
+{
+    QStringList errors;
+
+    {
+        QMutexLocker locker(&m_mutex);
+        errors.swap(m_errors);
+    }
+
+    foreach (const QString &error, errors) {
+        reportError(error);
+    }
+}
+
+
 /**
     Save a modified scheme to a writable location.
     @param name of the scheme to be saved.
@@ -217,34 +291,272 @@ bool SchemeManager::writeScheme(QString name)
 
 
 /**
-    Get a list of files that contain xml schemes, iterating each one to create a new FlossScheme instance
-    and read the scheme.  Each path found is added to the KDirWatch instance to allow automatic reload of scheme
-    data if it is changed outside of KXStitch.
+    Get a list of files that contain xml schemes. The names of the schemes are taken from the cache if
+    their file has not changed since it was written, and the schemes are read from it when they are
+    first used. Other files are parsed now and the cache is written again.
     Assumes that local resources are given before global ones and should take priority.
     */
 void SchemeManager::refresh()
 {
+    QHash<QString, SchemeFile> cachedFiles = mapCache();
+    bool cacheChanged = false;
+
     const QStringList dirs = QStandardPaths::locateAll(QStandardPaths::DataLocation, QStringLiteral("schemes"), QStandardPaths::LocateDirectory);
 
     Q_FOREACH (const QString &dir, dirs) {
         QDirIterator it(dir, QStringList() << QLatin1String("*.xml"));
 
         while (it.hasNext()) {
-            FlossScheme *flossScheme = readScheme(it.next());
-
-            if (flossScheme) {
-                for (int i = 0 ; i < m_flossSchemes.count() ; ++i) {
-                    if (m_flossSchemes.at(i)->schemeName() == flossScheme->schemeName()) {
-                        delete flossScheme;
-                        flossScheme = nullptr;
-                        break;
-                    }
-                }
+            QString path = it.next();
+            QFileInfo fileInfo(it.fileInfo());
+            SchemeFile schemeFile{QString(), path, fileInfo.size(), fileInfo.lastModified().toMSecsSinceEpoch(), -1, nullptr, false};
+
+            if (cachedFiles.contains(path) && cachedFiles.value(path).size == schemeFile.size && cachedFiles.value(path).modified == schemeFile.modified) {
+                schemeFile = cachedFiles.take(path);
+            } else {
+                cachedFiles.remove(path);
 
-                if (flossScheme) {
-                    m_flossSchemes.append(flossScheme);
+                QString error;
+
+                if ((schemeFile.flossScheme = parseScheme(path, error)) == nullptr) {
+                    m_errors.append(error);
+                    continue;
                 }
+
+                schemeFile.name = schemeFile.flossScheme->schemeName();
+                cacheChanged = true;
             }
+
+            addSchemeFile(schemeFile);
         }
     }
+
+    // files that have been removed are dropped from the cache
+    if (cacheChanged || !cachedFiles.isEmpty()) {
+        writeCache();
+    }
+}
+
+
+/**
+    Add a scheme file to the list, indexing it by name if it is the first scheme with its name.
+    @param schemeFile a const reference to the SchemeFile.
+    */
+void SchemeManager::addSchemeFile(const SchemeFile &schemeFile)
+{
+    if (!m_schemeIndexes.contains(schemeFile.name)) {
+        m_schemeIndexes.insert(schemeFile.name, m_schemeFiles.count());
+    }
+
+    m_schemeFiles.append(schemeFile);
+}
+
+
+/**
+    Read a scheme that has not been used before, from the cache if it holds the scheme or from the xml file.
+    This is called with the mutex held, errors are added to m_errors to be reported when it is released.
+    @param schemeFile a reference to the SchemeFile.
+    @return pointer to the FlossScheme instance, null if it could not be read.
+    */
+FlossScheme *SchemeManager::load(SchemeFile &schemeFile)
+{
+    if ((schemeFile.flossScheme == nullptr) && !schemeFile.failed) {
+        if (schemeFile.cacheOffset != -1) {
+            schemeFile.flossScheme = readCachedScheme(schemeFile);
+        }
+
+        if (schemeFile.flossScheme == nullptr) {
+            QString error;
+            schemeFile.flossScheme = parseScheme(schemeFile.path, error);
+
+            if (schemeFile.flossScheme == nullptr) {
+                schemeFile.failed = true;
+                m_errors.append(error);
+            }
+        }
+    }
+
+    return schemeFile.flossScheme;
+}
+
+
+QString SchemeManager::cacheFile()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + QLatin1String("/schemes.cache");
+}
+
+
+/**
+    Map the cache into memory and read its table of schemes. The file is kept mapped so the flosses of
+    a scheme can be read when it is first used.
+    @return a QHash of the SchemeFile by the path of the xml file, empty if the cache could not be read.
+    */
+QHash<QString, SchemeManager::SchemeFile> SchemeManager::mapCache()
+{
+    QHash<QString, SchemeFile> cachedFiles;
+    m_cacheFile.setFileName(cacheFile());
+
+    if (!m_cacheFile.open(QIODevice::ReadOnly) || (m_cacheData = m_cacheFile.map(0, m_cacheFile.size())) == nullptr) {
+        return cachedFiles;
+    }
+
+    QByteArray data = QByteArray::fromRawData(reinterpret_cast<const char *>(m_cacheData), m_cacheFile.size());
+    QDataStream stream(data);
+
+    char header[11];
+    qint16 version;
+    qint32 count;
+
+    if ((stream.readRawData(header, 11) != 11) || (strncmp(header, "KXStitchSch", 11) != 0)) {
+        return cachedFiles;
+    }
+
+    stream >> version;
+    stream >> count;
+
+    if (version != cacheVersion) {
+        return cachedFiles;
+    }
+
+    while (count-- && (stream.status() == QDataStream::Ok)) {
+        SchemeFile schemeFile{QString(), QString(), -1, -1, -1, nullptr, false};
+
+        stream >> schemeFile.path;
+        stream >> schemeFile.size;
+        stream >> schemeFile.modified;
+        stream >> schemeFile.name;
+        stream >> schemeFile.cacheOffset;
+
+        cachedFiles.insert(schemeFile.path, schemeFile);
+    }
+
+    if (stream.status() != QDataStream::Ok) {
+        cachedFiles.clear();
+    }
+
+    return cachedFiles;
+}
+
+
+/**
+    Read the flosses of a scheme from the mapped cache.
+    @param schemeFile a const reference to the SchemeFile.
+    @return pointer to the FlossScheme instance created, null if it could not be read.
+    */
+FlossScheme *SchemeManager::readCachedScheme(const SchemeFile &schemeFile) const
+{
+    if (m_cacheData == nullptr) {
+        return nullptr;
+    }
+
+    QByteArray data = QByteArray::fromRawData(reinterpret_cast<const char *>(m_cacheData), m_cacheFile.size());
+    QDataStream stream(data);
+    QVector<QString> names;
+    QVector<QString> descriptions;
+    QVector<quint32> colors;
+
+    stream.device()->seek(schemeFile.cacheOffset);
+    stream >> names;
+    stream >> descriptions;
+    stream >> colors;
+
+    if ((stream.status() != QDataStream::Ok) || (names.count() != descriptions.count()) || (names.count() != colors.count())) {
+        return nullptr;
+    }
+
+    FlossScheme *flossScheme = new FlossScheme;
+    flossScheme->setSchemeName(schemeFile.name);
+    flossScheme->setPath(schemeFile.path);
+
+    for (int i = 0 ; i < names.count() ; ++i) {
+        flossScheme->addFloss(new Floss(names.at(i), descriptions.at(i), QColor(QRgb(colors.at(i)))));
+    }
+
+    return flossScheme;
+}
+
+
+/**
+    Write the cache of the scheme files found, which reads any schemes that have not been used. A table of
+    the files, giving the offset of the flosses of each scheme, is followed by the flosses of each scheme
+    as arrays of the names, descriptions and colors. The cache is only an optimisation, so failing to write
+    it is ignored.
+    */
+void SchemeManager::writeCache()
+{
+    QByteArray table;
+    QByteArray flosses;
+    QDataStream tableStream(&table, QIODevice::WriteOnly);
+    QDataStream flossesStream(&flosses, QIODevice::WriteOnly);
+    QList<qint64> offsets;
+    int count = 0;
+
+    for (int i = 0 ; i < m_schemeFiles.count() ; ++i) {
+        SchemeFile &schemeFile = m_schemeFiles[i];
+
+        if (schemeFile.path.isEmpty() || load(schemeFile) == nullptr) {
+            continue;
+        }
+
+        QVector<QString> names;
+        QVector<QString> descriptions;
+        QVector<quint32> colors;
+
+        foreach (const Floss *floss, schemeFile.flossScheme->flosses()) {
+            names.append(floss->name());
+            descriptions.append(floss->description());
+            colors.append(floss->color().rgb());
+        }
+
+        offsets.append(flosses.size());
+        flossesStream << names;
+        flossesStream << descriptions;
+        flossesStream << colors;
+
+        // the offset is a fixed size so the table can be written before the offsets are known
+        tableStream << schemeFile.path;
+        tableStream << schemeFile.size;
+        tableStream << schemeFile.modified;
+        tableStream << schemeFile.name;
+        tableStream << qint64(0);
+        ++count;
+    }
+
+    // every scheme has been read, so the old cache is no longer needed
+    m_cacheFile.close();
+    m_cacheData = nullptr;
+
+    QByteArray header;
+    QDataStream headerStream(&header, QIODevice::WriteOnly);
+    headerStream.writeRawData("KXStitchSch", 11);
+    headerStream << qint16(cacheVersion);
+    headerStream << qint32(count);
+
+    // the table is written again with the offsets from the start of the file, its size is unchanged
+    qint64 base = header.size() + table.size();
+    QByteArray offsetTable;
+    QDataStream offsetTableStream(&offsetTable, QIODevice::WriteOnly);
+    count = 0;
+
+    foreach (const SchemeFile &schemeFile, m_schemeFiles) {
+        if (schemeFile.path.isEmpty() || schemeFile.flossScheme == nullptr) {
+            continue;
+        }
+
+        offsetTableStream << schemeFile.path;
+        offsetTableStream << schemeFile.size;
+        offsetTableStream << schemeFile.modified;
+        offsetTableStream << schemeFile.name;
+        offsetTableStream << qint64(base + offsets.at(count++));
+    }
+
+    QDir().mkpath(QFileInfo(cacheFile()).path());
+    QSaveFile file(cacheFile());
+
+    if (file.open(QIODevice::WriteOnly)) {
+        file.write(header);
+        file.write(offsetTable);
+        file.write(flosses);
+        file.commit();
+    }
 }
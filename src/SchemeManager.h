@@ -14,7 +14,10 @@
 
 
 #include <QColor>
+#include <QFile>
+#include <QHash>
 #include <QList>
+#include <QMutex>
 #include <QStringList>
 
 #include <KDirWatch>
@@ -41,11 +44,45 @@ private:
     static SchemeManager &self();
     SchemeManager();
 
+    /**
+        A scheme file found, the scheme is read when it is first used, from the cache if the file has not
+        changed since the cache was written.
+        */
+    struct SchemeFile {
+        QString     name;
+        QString     path;
+        qint64      size;
+        qint64      modified;
+        qint64      cacheOffset;    // the offset of the flosses in the cache, -1 if they are not cached
+        FlossScheme *flossScheme;   // nullptr until the scheme is first used
+        bool        failed;         // true if the scheme could not be read, so it is not tried again
+    };
+
     void refresh();
+    void addSchemeFile(const SchemeFile &schemeFile);
+    FlossScheme *load(SchemeFile &schemeFile);
+    void reportErrors();
+
+    static FlossScheme *parseScheme(const QString &path, QString &error);
+
+    static QString cacheFile();
+    QHash<QString, SchemeFile> mapCache();
+    FlossScheme *readCachedScheme(const SchemeFile &schemeFile) const;
+    void writeCache();
+
+    static const int cacheVersion = 101;
 
     static SchemeManager            *schemeManager;
     typedef QMap<QString, QColor>   CalibratedColor;
-    QList<FlossScheme *>            m_flossSchemes;
+    QList<SchemeFile>               m_schemeFiles;
+    QHash<QString, int>             m_schemeIndexes;    // the index in m_schemeFiles of the first scheme with each name
+
+    // schemes are read when first used, which may be on a worker thread, the errors are reported when the mutex is released
+    QMutex                          m_mutex;
+    QStringList                     m_errors;
+
+    QFile                           m_cacheFile;
+    uchar                           *m_cacheData;   // the cache mapped into memory, nullptr if it could not be
 };
 
 
@@ -11,6 +11,13 @@
 
 #include "StitchData.h"
 
+#include <algorithm>
+#include <numeric>
+
+#include <QByteArray>
+#include <QFutureInterface>
+#include <QtConcurrent>
+
 #include <KLocalizedString>
 
 #include "Exceptions.h"
@@ -59,9 +66,21 @@ int FlossUsage::stitchCount() const
 }
 
 
+/**
+ * The number of rows of stitches encoded and compressed together in a chunk.
+ */
+static const int rowsPerChunk = 64;
+
+
 StitchData::StitchData()
     :   m_width(0),
-        m_height(0)
+        m_height(0),
+        m_modifiedAll(true),
+        m_modifiedLines(false),
+        m_loadOnDemand(false),
+        m_chunksPending(0),
+        m_loadingInBackground(false),
+        m_loadFailed(false)
 {
 }
 
@@ -74,6 +93,10 @@ StitchData::~StitchData()
 
 void StitchData::clear()
 {
+    setModified();
+    finishLoading();
+    m_loadFailed = false;
+
     qDeleteAll(m_stitches);
     m_stitches.fill(nullptr);
 
@@ -99,6 +122,9 @@ int StitchData::height() const
 
 void StitchData::resize(int width, int height)
 {
+    setModified();
+    loadChunks();
+
     QVector<StitchQueue *> newVector(width * height);
     QRect extentsRect = extents();
 
@@ -198,6 +224,8 @@ void StitchData::insertRows(int startRow, int rows)
 
 void StitchData::removeColumns(int startColumn, int columns)
 {
+    loadChunks();
+
     for (int y = 0 ; y < m_height ; ++y) {
         for (int destinationColumn = startColumn, sourceColumn = startColumn + columns ; sourceColumn < m_width ; ++destinationColumn, ++sourceColumn) {
             m_stitches[index(destinationColumn, y)] = takeStitchQueueAt(sourceColumn, y);
@@ -237,6 +265,8 @@ void StitchData::removeColumns(int startColumn, int columns)
 
 void StitchData::removeRows(int startRow, int rows)
 {
+    loadChunks();
+
     for (int destinationRow = startRow, sourceRow = startRow + rows ; sourceRow < m_height ; ++destinationRow, ++sourceRow) {
         for (int x = 0 ; x < m_width ; ++x) {
             m_stitches[index(x, destinationRow)] = takeStitchQueueAt(x, sourceRow);
@@ -276,6 +306,9 @@ void StitchData::removeRows(int startRow, int rows)
 
 QRect StitchData::extents() const
 {
+    // loading the remaining rows does not change the contents
+    const_cast<StitchData *>(this)->loadChunks();
+
     QRect extentsRect;
 
     for (int y = 0 ; y < m_height ; ++y) {
@@ -312,6 +345,9 @@ QRect StitchData::extents() const
 
 void StitchData::movePattern(int dx, int dy)
 {
+    setModified();
+    loadChunks();
+
     QRect extentsRect = extents();
 
     QVector<StitchQueue *> newVector(m_width * m_height);
@@ -343,6 +379,9 @@ void StitchData::movePattern(int dx, int dy)
 
 void StitchData::mirror(Qt::Orientation orientation)
 {
+    setModified();
+    loadChunks();
+
     int rows = m_height;
     int cols = m_width;
 
@@ -410,6 +449,9 @@ void StitchData::mirror(Qt::Orientation orientation)
 
 void StitchData::rotate(Rotation rotation)
 {
+    setModified();
+    loadChunks();
+
     int rows = m_height;
     int cols = m_width;
 
@@ -646,10 +688,122 @@ bool StitchData::isValid(int x, int y) const
 }
 
 
+void StitchData::cellModified(int i)
+{
+    int chunk = i / m_width / rowsPerChunk;
+
+    if (chunk < m_encodedChunks.count()) {
+        m_encodedChunks[chunk].data.clear();
+    }
+
+    if (m_modifiedAll) {
+        return;
+    }
+
+    // once a large part of the pattern has changed it is cheaper to treat it all as changed
+    if (m_modifiedCells.count() > m_stitches.count() / 4) {
+        m_modifiedAll = true;
+        m_modifiedLines = true;
+        m_modifiedCells.clear();
+        m_lineChanges.clear();
+    } else {
+        m_modifiedCells.append(i);
+    }
+}
+
+
+// the lines have changed in a way that is not described by a LineChange
+void StitchData::linesModified()
+{
+    m_modifiedLines = true;
+    m_lineChanges.clear();
+    m_encodedLines.clear();
+}
+
+
+void StitchData::lineChanged(LineChange::Type type, const Backstitch *backstitch, const Knot *knot)
+{
+    m_encodedLines.clear();
+
+    if (m_modifiedLines) {
+        return;
+    }
+
+    // once there are more changes than lines it is cheaper to journal all the lines
+    if (m_lineChanges.count() > m_backstitches.count() + m_knots.count()) {
+        linesModified();
+        return;
+    }
+
+    LineChange change;
+    change.type = type;
+
+    if (backstitch) {
+        change.backstitch = *backstitch;
+    }
+
+    if (knot) {
+        change.knot = *knot;
+    }
+
+    m_lineChanges.append(change);
+}
+
+
+void StitchData::setModified()
+{
+    m_modifiedAll = true;
+    m_modifiedCells.clear();
+    m_encodedChunks.clear();
+    linesModified();
+}
+
+
+// lines is set if all the lines need to be journaled, otherwise lineChanges has the lines added and removed
+bool StitchData::takeModifications(QVector<QPoint> &cells, bool &lines, QVector<LineChange> &lineChanges)
+{
+    bool partial = !m_modifiedAll;
+
+    cells.clear();
+
+    if (partial) {
+        std::sort(m_modifiedCells.begin(), m_modifiedCells.end());
+        m_modifiedCells.erase(std::unique(m_modifiedCells.begin(), m_modifiedCells.end()), m_modifiedCells.end());
+
+        for (int i : m_modifiedCells) {
+            cells.append(QPoint(i % m_width, i / m_width));
+        }
+    }
+
+    lines = m_modifiedLines;
+    lineChanges = m_lineChanges;
+
+    m_modifiedCells.clear();
+    m_modifiedAll = false;
+    m_modifiedLines = false;
+    m_lineChanges.clear();
+
+    return partial;
+}
+
+
+void StitchData::replaceLines(const QList<Backstitch *> &backstitches, const QList<Knot *> &knots)
+{
+    qDeleteAll(m_backstitches);
+    m_backstitches = backstitches;
+    qDeleteAll(m_knots);
+    m_knots = knots;
+    linesModified();
+}
+
+
 void StitchData::addStitch(const QPoint &position, Stitch::Type type, int colorIndex)
 {
+    loadRow(position.y());
+
     int i = index(position);
     StitchQueue *stitchQueue = m_stitches.at(i);
+    cellModified(i);
 
     if (stitchQueue == nullptr) {
         stitchQueue = new StitchQueue;
@@ -660,6 +814,37 @@ void StitchData::addStitch(const QPoint &position, Stitch::Type type, int colorI
 }
 
 
+// add a run of identical stitches, used by the file readers where runs are common
+void StitchData::addStitches(const QPoint &position, int count, Qt::Orientation orientation, Stitch::Type type, int colorIndex)
+{
+    if (!isValid(position.x(), position.y())) {
+        return;
+    }
+
+    int stride = 1;
+
+    loadChunks();
+
+    if (orientation == Qt::Horizontal) {
+        count = std::min(count, m_width - position.x());
+    } else {
+        count = std::min(count, m_height - position.y());
+        stride = m_width;
+    }
+
+    StitchQueue **stitchQueues = m_stitches.data();
+
+    for (int i = index(position) ; count-- > 0 ; i += stride) {
+        if (stitchQueues[i] == nullptr) {
+            stitchQueues[i] = new StitchQueue;
+        }
+
+        stitchQueues[i]->add(type, colorIndex);
+        cellModified(i);
+    }
+}
+
+
 Stitch *StitchData::findStitch(const QPoint &cell, Stitch::Type type, int colorIndex)
 {
     StitchQueue *stitchQueue = stitchQueueAt(cell);
@@ -677,8 +862,11 @@ Stitch *StitchData::findStitch(const QPoint &cell, Stitch::Type type, int colorI
 
 void StitchData::deleteStitch(const QPoint &position, Stitch::Type type, int colorIndex)
 {
+    loadRow(position.y());
+
     int i = index(position);
     StitchQueue *stitchQueue = m_stitches.at(i);
+    cellModified(i);
 
     if (stitchQueue) {
         if (stitchQueue->remove(type, colorIndex) == 0) {
@@ -694,6 +882,7 @@ StitchQueue *StitchData::stitchQueueAt(int x, int y)
     StitchQueue *stitchQueue = nullptr;
 
     if (isValid(x, y)) {
+        loadRow(y);
         stitchQueue = m_stitches.at(index(x, y));
     }
 
@@ -711,8 +900,9 @@ StitchQueue *StitchData::takeStitchQueueAt(int x, int y)
 {
     StitchQueue *stitchQueue = stitchQueueAt(x, y);
 
-    if (stitchQueue) {
+    if (isValid(x, y)) {
         m_stitches[index(x, y)] = nullptr;
+        cellModified(index(x, y));
     }
 
     return stitchQueue;
@@ -745,13 +935,14 @@ StitchQueue *StitchData::replaceStitchQueueAt(const QPoint &position, StitchQueu
 
 void StitchData::addBackstitch(const QPoint &start, const QPoint &end, int colorIndex)
 {
-    m_backstitches.append(new Backstitch(start, end, colorIndex));
+    addBackstitch(new Backstitch(start, end, colorIndex));
 }
 
 
 void StitchData::addBackstitch(Backstitch *backstitch)
 {
     m_backstitches.append(backstitch);
+    lineChanged(LineChange::AddBackstitch, backstitch, nullptr);
 }
 
 
@@ -772,10 +963,7 @@ Backstitch *StitchData::findBackstitch(const QPoint &start, const QPoint &end, i
 
 Backstitch *StitchData::takeBackstitch(const QPoint &start, const QPoint &end, int colorIndex)
 {
-    Backstitch *removed = findBackstitch(start, end, colorIndex);
-    m_backstitches.removeOne(removed);
-
-    return removed;
+    return takeBackstitch(findBackstitch(start, end, colorIndex));
 }
 
 
@@ -785,6 +973,7 @@ Backstitch *StitchData::takeBackstitch(Backstitch *backstitch)
 
     if (m_backstitches.removeOne(backstitch)) {
         removed = backstitch;
+        lineChanged(LineChange::RemoveBackstitch, backstitch, nullptr);
     }
 
     return removed;
@@ -793,13 +982,14 @@ Backstitch *StitchData::takeBackstitch(Backstitch *backstitch)
 
 void StitchData::addFrenchKnot(const QPoint &position, int colorIndex)
 {
-    m_knots.append(new Knot(position, colorIndex));
+    addFrenchKnot(new Knot(position, colorIndex));
 }
 
 
 void StitchData::addFrenchKnot(Knot *knot)
 {
     m_knots.append(knot);
+    lineChanged(LineChange::AddKnot, nullptr, knot);
 }
 
 
@@ -820,13 +1010,7 @@ Knot *StitchData::findKnot(const QPoint &position, int colorIndex)
 
 Knot *StitchData::takeFrenchKnot(const QPoint &position, int colorIndex)
 {
-    Knot *removed = findKnot(position, colorIndex);
-
-    if (removed) {
-        m_knots.removeOne(removed);
-    }
-
-    return removed;
+    return takeFrenchKnot(findKnot(position, colorIndex));
 }
 
 
@@ -836,6 +1020,7 @@ Knot *StitchData::takeFrenchKnot(Knot *knot)
 
     if (m_knots.removeOne(knot)) {
         removed = knot;
+        lineChanged(LineChange::RemoveKnot, nullptr, knot);
     }
 
     return removed;
@@ -862,6 +1047,7 @@ QListIterator<Backstitch *> StitchData::backstitchIterator()
 
 QMutableListIterator<Backstitch *> StitchData::mutableBackstitchIterator()
 {
+    linesModified();
     return QMutableListIterator<Backstitch *>(m_backstitches);
 }
 
@@ -874,6 +1060,7 @@ QListIterator<Knot *> StitchData::knotIterator()
 
 QMutableListIterator<Knot *> StitchData::mutableKnotIterator()
 {
+    linesModified();
     return QMutableListIterator<Knot *>(m_knots);
 }
 
@@ -907,6 +1094,8 @@ QMap<int, FlossUsage> StitchData::flossUsage()
         lengths.insert(Stitch::FrenchKnot, 2.0);
     }
 
+    loadChunks();
+
     QVectorIterator<StitchQueue *> stitchesIterator(m_stitches);
 
     while (stitchesIterator.hasNext()) {
@@ -944,63 +1133,474 @@ QMap<int, FlossUsage> StitchData::flossUsage()
 }
 
 
-QDataStream &operator<<(QDataStream &stream, const StitchData &stitchData)
+/**
+ * Append an unsigned value to a buffer using seven bits per byte, the high bit
+ * of each byte being set if more bytes follow.
+ */
+static void writeVarint(QByteArray &buffer, quint32 value)
+{
+    while (value > 0x7f) {
+        buffer.append(char((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+
+    buffer.append(char(value));
+}
+
+
+/**
+ * Read an unsigned value written by writeVarint, advancing data past it.
+ */
+static quint32 readVarint(const char *&data, const char *end)
 {
-    stream << qint32(stitchData.version);
-    stream << qint32(stitchData.m_width);
-    stream << qint32(stitchData.m_height);
+    quint32 value = 0;
 
-    QVectorIterator<StitchQueue *> stitchesIterator(stitchData.m_stitches);
-    int queues = 0;
+    for (int shift = 0 ; shift < 35 ; shift += 7) {
+        if (data == end) {
+            break;
+        }
 
-    while (stitchesIterator.hasNext()) {
-        if (stitchesIterator.next()) {
-            ++queues;
+        uchar byte = uchar(*data++);
+        value |= quint32(byte & 0x7f) << shift;
+
+        if ((byte & 0x80) == 0) {
+            return value;
         }
     }
 
-    stream << qint32(queues);
+    throw FailedReadFile(QString(i18n("Failed reading stitch data")));
+}
+
+
+static bool sameStitches(const StitchQueue *first, const StitchQueue *second)
+{
+    if (first == second) {
+        return true;
+    }
+
+    if ((first == nullptr) || (second == nullptr) || (first->count() != second->count())) {
+        return false;
+    }
+
+    for (int i = 0 ; i < first->count() ; ++i) {
+        if ((first->at(i)->type != second->at(i)->type) || (first->at(i)->colorIndex != second->at(i)->colorIndex)) {
+            return false;
+        }
+    }
 
-    for (int row = 0 ; row < stitchData.m_height ; ++row) {
-        for (int column = 0 ; column < stitchData.m_width ; ++column) {
-            if (StitchQueue *stitchQueue = stitchData.m_stitches[stitchData.index(column, row)]) {
-                stream << qint32(column);
-                stream << qint32(row);
-                stream << *stitchQueue;
+    return true;
+}
+
+
+/**
+ * Encode the cells of a range of rows. Each row is a sequence of runs of identical
+ * cells, a run being its length followed by the number of stitches in the cells and
+ * the type and color index of each stitch, an empty cell having no stitches.
+ */
+static QByteArray encodeRows(const QVector<StitchQueue *> &stitches, int width, int firstRow, int rows)
+{
+    QByteArray buffer;
+
+    for (int row = firstRow ; row < firstRow + rows ; ++row) {
+        const StitchQueue *const *cell = stitches.constData() + row * width;
+        int column = 0;
+
+        while (column < width) {
+            const StitchQueue *stitchQueue = cell[column];
+            int length = 1;
+
+            while ((column + length < width) && sameStitches(stitchQueue, cell[column + length])) {
+                ++length;
             }
+
+            writeVarint(buffer, length);
+
+            if (stitchQueue) {
+                writeVarint(buffer, stitchQueue->count());
+
+                foreach (const Stitch *stitch, *stitchQueue) {
+                    buffer.append(char(stitch->type));
+                    writeVarint(buffer, stitch->colorIndex);
+                }
+            } else {
+                writeVarint(buffer, 0);
+            }
+
+            column += length;
         }
     }
 
-    QListIterator<Backstitch *> backstitchIterator(stitchData.m_backstitches);
-    stream << qint32(stitchData.m_backstitches.count());
+    return buffer;
+}
 
-    while (backstitchIterator.hasNext()) {
-        stream << *(backstitchIterator.next());
 
-        if (stream.status() != QDataStream::Ok) {
-            throw FailedWriteFile(stream.status());
+/**
+ * Test if a byte read from an encoded chunk is one of the stitch types.
+ */
+static bool isStitchType(uchar type)
+{
+    switch (type) {
+    case Stitch::Delete:
+    case Stitch::TLQtr:
+    case Stitch::TRQtr:
+    case Stitch::BLQtr:
+    case Stitch::BTHalf:
+    case Stitch::TL3Qtr:
+    case Stitch::BRQtr:
+    case Stitch::TBHalf:
+    case Stitch::TR3Qtr:
+    case Stitch::BL3Qtr:
+    case Stitch::BR3Qtr:
+    case Stitch::Full:
+    case Stitch::TLSmallHalf:
+    case Stitch::TRSmallHalf:
+    case Stitch::BLSmallHalf:
+    case Stitch::BRSmallHalf:
+    case Stitch::TLSmallFull:
+    case Stitch::TRSmallFull:
+    case Stitch::BLSmallFull:
+    case Stitch::BRSmallFull:
+    case Stitch::FrenchKnot:
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+
+/**
+ * Decode a compressed chunk of rows encoded by encodeRows into new stitch queues,
+ * the queues for the cells of the rows being returned in order. An empty vector
+ * is returned if the data is not valid.
+ */
+static QVector<StitchQueue *> decodeChunk(const QByteArray &compressed, int width, int rows)
+{
+    QByteArray buffer = qUncompress(compressed);
+    const char *data = buffer.constData();
+    const char *end = data + buffer.size();
+    QVector<StitchQueue *> cells(width * rows);
+
+    try {
+        for (int row = 0 ; row < rows ; ++row) {
+            StitchQueue **cell = cells.data() + row * width;
+            int column = 0;
+
+            while (column < width) {
+                quint32 length = readVarint(data, end);
+                quint32 count = readVarint(data, end);
+
+                if ((length == 0) || (length > quint32(width - column)) || (count > quint32(end - data))) {
+                    throw FailedReadFile(QString(i18n("Failed reading stitch data")));
+                }
+
+                QVector<Stitch> cellStitches;
+                cellStitches.reserve(count);
+
+                while (count--) {
+                    if ((data == end) || !isStitchType(uchar(*data))) {
+                        throw FailedReadFile(QString(i18n("Failed reading stitch data")));
+                    }
+
+                    Stitch::Type type = static_cast<Stitch::Type>(uchar(*data++));
+                    cellStitches.append(Stitch(type, readVarint(data, end)));
+                }
+
+                if (cellStitches.isEmpty()) {
+                    column += length;
+                    continue;
+                }
+
+                while (length--) {
+                    StitchQueue *stitchQueue = new StitchQueue;
+
+                    foreach (const Stitch &stitch, cellStitches) {
+                        stitchQueue->enqueue(new Stitch(stitch.type, stitch.colorIndex));
+                    }
+
+                    cell[column++] = stitchQueue;
+                }
+            }
         }
+    } catch (const FailedReadFile &e) {
+        qDeleteAll(cells);
+        return QVector<StitchQueue *>();
     }
 
-    QListIterator<Knot *> knotIterator(stitchData.m_knots);
-    stream << qint32(stitchData.m_knots.count());
+    return cells;
+}
 
-    while (knotIterator.hasNext()) {
-        stream << *(knotIterator.next());
 
-        if (stream.status() != QDataStream::Ok) {
-            throw FailedWriteFile(stream.status());
+/**
+ * Function object used by QtConcurrent::mapped to decode the chunks of a file in the
+ * background, QtConcurrent requires the result_type to be defined.
+ */
+class ChunkDecoder
+{
+public:
+    typedef QVector<StitchQueue *> result_type;
+
+    ChunkDecoder(const QVector<QByteArray> &chunks, int width, int height)
+        :   m_chunks(chunks),
+            m_width(width),
+            m_height(height)
+    {
+    }
+
+    result_type operator()(int chunk) const
+    {
+        return decodeChunk(m_chunks.at(chunk), m_width, std::min(rowsPerChunk, m_height - chunk * rowsPerChunk));
+    }
+
+private:
+    QVector<QByteArray> m_chunks;
+    int                 m_width;
+    int                 m_height;
+};
+
+
+// stitch data read from a stream is decoded before the stream operator returns unless the
+// next read is loaded on demand, the chunks are then decoded by loadInBackground or as they
+// are used, stitch data streamed in after that is decoded at once again
+void StitchData::setLoadOnDemand(bool loadOnDemand)
+{
+    m_loadOnDemand = loadOnDemand;
+}
+
+
+// rows of a chunk that has not been decoded yet are not available, testing this does
+// not decode the chunk so it can be used while drawing
+bool StitchData::isLoaded(int row) const
+{
+    return m_chunkStates.value(row / rowsPerChunk, ChunkTaken) != ChunkPending;
+}
+
+
+// a chunk that could not be decoded is reported once
+bool StitchData::takeLoadFailure()
+{
+    bool loadFailed = m_loadFailed;
+    m_loadFailed = false;
+
+    return loadFailed;
+}
+
+
+QFuture<QVector<StitchQueue *> > StitchData::loadInBackground()
+{
+    if (m_chunksPending && !m_loadingInBackground) {
+        QVector<int> chunks(m_chunkStates.count());
+        std::iota(chunks.begin(), chunks.end(), 0);
+
+        m_loading = QtConcurrent::mapped(chunks, ChunkDecoder(m_pendingChunks, m_width, m_height));
+        m_loadingInBackground = true;
+    }
+
+    return m_loading;
+}
+
+
+QRect StitchData::loadChunk(int chunk)
+{
+    if ((chunk < 0) || (chunk >= m_chunkStates.count()) || (m_chunkStates.at(chunk) != ChunkPending)) {
+        return QRect();
+    }
+
+    int firstRow = chunk * rowsPerChunk;
+    int rows = std::min(rowsPerChunk, m_height - firstRow);
+    QVector<StitchQueue *> cells;
+
+    // use the background result if it is ready, otherwise decode it now as it is needed
+    if (m_loadingInBackground && m_loading.isResultReadyAt(chunk)) {
+        cells = m_loading.resultAt(chunk);
+        m_chunkStates[chunk] = ChunkTaken;
+    } else {
+        cells = decodeChunk(m_pendingChunks.at(chunk), m_width, rows);
+        m_chunkStates[chunk] = ChunkDecoded;
+    }
+
+    m_pendingChunks[chunk] = QByteArray();
+
+    if (cells.count() == m_width * rows) {
+        std::copy(cells.constBegin(), cells.constEnd(), m_stitches.begin() + firstRow * m_width);
+    } else {
+        m_loadFailed = true;
+    }
+
+    if (--m_chunksPending == 0) {
+        finishLoading();
+    }
+
+    return QRect(0, firstRow, m_width, rows);
+}
+
+
+// a chunk that cannot be decoded leaves its rows empty, this does not throw as it is used
+// while drawing so the failure is kept for takeLoadFailure or the next load, the cells of
+// the chunks decoded by this call are returned
+QRect StitchData::loadRows(int firstRow, int lastRow)
+{
+    QRect cells;
+
+    if (m_chunksPending) {
+        for (int chunk = std::max(firstRow, 0) / rowsPerChunk ; chunk <= std::min(lastRow, m_height - 1) / rowsPerChunk ; ++chunk) {
+            cells |= loadChunk(chunk);
+        }
+    }
+
+    return cells;
+}
+
+
+// throws FailedReadFile if a chunk could not be decoded and that has not been reported yet,
+// the rows of that chunk are left empty and the rest of the stitches are still available
+void StitchData::load()
+{
+    loadChunks();
+
+    if (takeLoadFailure()) {
+        throw FailedReadFile(QString(i18n("Failed reading stitch data")));
+    }
+}
+
+
+// used before changes to the whole pattern, a chunk that cannot be decoded is left to be
+// reported by load or takeLoadFailure
+void StitchData::loadChunks()
+{
+    for (int chunk = 0 ; chunk < m_chunkStates.count() ; ++chunk) {
+        loadChunk(chunk);
+    }
+}
+
+
+void StitchData::loadRow(int row)
+{
+    if (m_chunksPending) {
+        loadChunk(row / rowsPerChunk);
+    }
+}
+
+
+void StitchData::finishLoading()
+{
+    if (m_loadingInBackground) {
+        m_loading.cancel();
+        m_loading.waitForFinished();
+
+        // results that were decoded again because they were needed before they were ready
+        for (int chunk = 0 ; chunk < m_chunkStates.count() ; ++chunk) {
+            if ((m_chunkStates.at(chunk) != ChunkTaken) && m_loading.isResultReadyAt(chunk)) {
+                qDeleteAll(m_loading.resultAt(chunk));
+            }
+        }
+    }
+
+    m_loading = QFuture<QVector<StitchQueue *> >();
+    m_loadingInBackground = false;
+    m_pendingChunks.clear();
+    m_chunkStates.clear();
+    m_chunksPending = 0;
+}
+
+
+// the snapshot shares the encoded chunks and lines, only the chunks and lines changed since
+// the last snapshot are encoded here, so taking it does not depend on the size of the pattern
+StitchDataSnapshot StitchData::snapshot() const
+{
+    int chunks = (m_height + rowsPerChunk - 1) / rowsPerChunk;
+
+    m_encodedChunks.resize(chunks);
+
+    for (int chunk = 0 ; chunk < chunks ; ++chunk) {
+        StitchDataSnapshot::EncodedChunk &encodedChunk = m_encodedChunks[chunk];
+
+        if (encodedChunk.data.isEmpty()) {
+            // the chunks read from a file keep their data until they change, this only
+            // decodes one if the whole pattern was marked as changed before it was used
+            const_cast<StitchData *>(this)->loadChunk(chunk);
+
+            int firstRow = chunk * rowsPerChunk;
+            encodedChunk.data = encodeRows(m_stitches, m_width, firstRow, std::min(rowsPerChunk, m_height - firstRow));
+            encodedChunk.compressed = false;
+        }
+    }
+
+    if (m_encodedLines.isEmpty()) {
+        QDataStream stream(&m_encodedLines, QIODevice::WriteOnly);
+        stream.setVersion(QDataStream::Qt_4_0);
+
+        stream << qint32(m_backstitches.count());
+
+        foreach (const Backstitch *backstitch, m_backstitches) {
+            stream << *backstitch;
+        }
+
+        stream << qint32(m_knots.count());
+
+        foreach (const Knot *knot, m_knots) {
+            stream << *knot;
         }
     }
 
+    StitchDataSnapshot snapshot;
+
+    snapshot.m_version = version;
+    snapshot.m_width = m_width;
+    snapshot.m_height = m_height;
+    snapshot.m_chunks = m_encodedChunks;
+    snapshot.m_lines = m_encodedLines;
+
+    return snapshot;
+}
+
+
+// this may be called on a worker thread, the progress of compressing the chunks is reported
+// to progress if it is not nullptr
+void StitchDataSnapshot::write(QDataStream &stream, QFutureInterfaceBase *progress) const
+{
+    stream << m_version;
+    stream << m_width;
+    stream << m_height;
+
+    // the rows are written in chunks, each compressed independently of the others
+    stream << qint32(m_chunks.count());
+
+    if (progress) {
+        progress->setProgressRange(0, m_chunks.count());
+    }
+
+    for (int chunk = 0 ; chunk < m_chunks.count() ; ++chunk) {
+        const EncodedChunk &encodedChunk = m_chunks.at(chunk);
+        stream << ((encodedChunk.compressed) ? encodedChunk.data : qCompress(encodedChunk.data));
+
+        if (progress) {
+            progress->setProgressValue(chunk + 1);
+        }
+    }
+
+    stream.writeRawData(m_lines.constData(), m_lines.size());
+
     if (stream.status() != QDataStream::Ok) {
         throw FailedWriteFile(stream.status());
     }
+}
+
+
+QDataStream &operator<<(QDataStream &stream, const StitchDataSnapshot &snapshot)
+{
+    snapshot.write(stream, nullptr);
 
     return stream;
 }
 
 
+QDataStream &operator<<(QDataStream &stream, const StitchData &stitchData)
+{
+    return stream << stitchData.snapshot();
+}
+
+
 QDataStream &operator>>(QDataStream &stream, StitchData &stitchData)
 {
     qint32 version;
@@ -1011,12 +1611,60 @@ QDataStream &operator>>(QDataStream &stream, StitchData &stitchData)
     qint32 rows;
     qint32 count;
     QHash<int, QHash<int, StitchQueue *> > stitches;
+    bool loadOnDemand = stitchData.m_loadOnDemand;
 
     stitchData.clear();
+    stitchData.m_loadOnDemand = false;
 
     stream >> version;
 
     switch (version) {
+    case 104:
+        stream >> width;
+        stream >> height;
+        stitchData.resize(width, height);
+        stream >> count;
+
+        if (count != (height + rowsPerChunk - 1) / rowsPerChunk) {
+            throw FailedReadFile(QString(i18n("Failed reading stitch data")));
+        }
+
+        // the chunks are decoded at the end unless they are loaded on demand, the compressed
+        // data is kept to be written again until the rows change
+        stitchData.m_pendingChunks.resize(count);
+        stitchData.m_encodedChunks.resize(count);
+
+        for (int chunk = 0 ; chunk < count ; ++chunk) {
+            stream >> stitchData.m_pendingChunks[chunk];
+            stitchData.m_encodedChunks[chunk].data = stitchData.m_pendingChunks.at(chunk);
+            stitchData.m_encodedChunks[chunk].compressed = true;
+        }
+
+        stitchData.m_chunkStates.fill(StitchData::ChunkPending, count);
+        stitchData.m_chunksPending = count;
+
+        stream >> count;
+
+        while (count--) {
+            Backstitch *backstitch = new Backstitch;
+            stream >> *(backstitch);
+            stitchData.addBackstitch(backstitch);
+        }
+
+        stream >> count;
+
+        while (count--) {
+            Knot *knot = new Knot;
+            stream >> *knot;
+            stitchData.addFrenchKnot(knot);
+        }
+
+        if (!loadOnDemand) {
+            stitchData.load();
+        }
+
+        break;
+
     case 103:
         stream >> width;
         stream >> height;
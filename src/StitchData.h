@@ -13,6 +13,8 @@
 #define StitchData_H
 
 
+#include <QByteArray>
+#include <QFuture>
 #include <QList>
 #include <QListIterator>
 #include <QMap>
@@ -41,6 +43,35 @@ public:
 };
 
 
+class QFutureInterfaceBase;
+
+
+class StitchDataSnapshot
+{
+public:
+    /**
+     * A chunk of rows encoded by encodeRows, chunks read from a file are kept compressed.
+     */
+    struct EncodedChunk {
+        QByteArray  data;           /**< empty if the rows have changed since they were encoded */
+        bool        compressed;
+    };
+
+    void write(QDataStream &, QFutureInterfaceBase *) const;
+
+    friend QDataStream &operator<<(QDataStream &, const StitchDataSnapshot &);
+
+private:
+    friend class StitchData;
+
+    qint32                  m_version;
+    qint32                  m_width;
+    qint32                  m_height;
+    QVector<EncodedChunk>   m_chunks;       // shared with the stitch data, compressed when written if they are not already
+    QByteArray              m_lines;        // the streamed backstitches and knots, shared with the stitch data
+};
+
+
 class StitchData
 {
 public:
@@ -50,6 +81,22 @@ public:
         Rotate270
     };
 
+    /**
+     * A backstitch or knot added or removed since takeModifications was last called.
+     */
+    struct LineChange {
+        enum Type {
+            AddBackstitch,
+            RemoveBackstitch,
+            AddKnot,
+            RemoveKnot
+        };
+
+        Type        type;
+        Backstitch  backstitch;     /**< the backstitch for AddBackstitch and RemoveBackstitch */
+        Knot        knot;           /**< the knot for AddKnot and RemoveKnot */
+    };
+
     StitchData();
     ~StitchData();
 
@@ -70,6 +117,7 @@ public:
     void rotate(Rotation);
 
     void addStitch(const QPoint &, Stitch::Type, int);
+    void addStitches(const QPoint &, int, Qt::Orientation, Stitch::Type, int);
     Stitch *findStitch(const QPoint &, Stitch::Type, int);
     void deleteStitch(const QPoint &, Stitch::Type, int);
 
@@ -102,6 +150,20 @@ public:
 
     QMap<int, FlossUsage> flossUsage();
 
+    StitchDataSnapshot snapshot() const;
+
+    void setModified();
+    bool takeModifications(QVector<QPoint> &, bool &, QVector<LineChange> &);
+    void replaceLines(const QList<Backstitch *> &, const QList<Knot *> &);
+
+    void setLoadOnDemand(bool);
+    bool isLoaded(int) const;
+    bool takeLoadFailure();
+    QFuture<QVector<StitchQueue *> > loadInBackground();
+    QRect loadChunk(int);
+    QRect loadRows(int, int);
+    void load();
+
     friend QDataStream &operator<<(QDataStream &, const StitchData &);
     friend QDataStream &operator>>(QDataStream &, StitchData &);
 
@@ -112,8 +174,20 @@ private:
     int     index(int, int) const;
     int     index(const QPoint &) const;
     bool    isValid(int x, int y) const;
+    void    cellModified(int);
+    void    linesModified();
+    void    lineChanged(LineChange::Type, const Backstitch *, const Knot *);
+    void    loadRow(int);
+    void    loadChunks();
+    void    finishLoading();
+
+    enum ChunkState {
+        ChunkPending,
+        ChunkTaken,
+        ChunkDecoded
+    };
 
-    static const int version = 103;
+    static const int version = 104;
 
     int m_width;
     int m_height;
@@ -121,9 +195,29 @@ private:
     QVector<StitchQueue *>                  m_stitches;
     QList<Backstitch *>                     m_backstitches;
     QList<Knot *>                           m_knots;
+
+    // changes since takeModifications was last called, used by the journal
+    QVector<int>                            m_modifiedCells;
+    bool                                    m_modifiedAll;
+    bool                                    m_modifiedLines;    // the lines must be journaled in full
+    QVector<LineChange>                     m_lineChanges;      // otherwise the changes in the order they were made
+
+    // the rows and lines as they were last encoded, shared with the snapshots until they change
+    mutable QVector<StitchDataSnapshot::EncodedChunk>   m_encodedChunks;
+    mutable QByteArray                                  m_encodedLines;
+
+    // chunks of rows read from a file but not yet decoded, see loadInBackground
+    bool                                    m_loadOnDemand;
+    QVector<QByteArray>                     m_pendingChunks;
+    QVector<ChunkState>                     m_chunkStates;
+    int                                     m_chunksPending;
+    QFuture<QVector<StitchQueue *> >        m_loading;
+    bool                                    m_loadingInBackground;
+    bool                                    m_loadFailed;
 };
 
 
+QDataStream &operator<<(QDataStream &, const StitchDataSnapshot &);
 QDataStream &operator<<(QDataStream &, const StitchData &);
 QDataStream &operator>>(QDataStream &, StitchData &);
 
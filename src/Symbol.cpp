@@ -53,88 +53,64 @@ Symbol::Symbol()
 /**
  * Get the QPainterPath for the symbol. The path also incorporates the path fill mode.
  *
- * @return a QPainterPath
+ * @return a const reference to a QPainterPath
  */
-QPainterPath Symbol::path() const
+const QPainterPath &Symbol::path() const
 {
-    return m_paths.value(Stitch::Full);
+    return path(Stitch::Full);
 }
 
 
 /**
  * Get a version of the symbol based on the stitch type to be rendered.
- * The scaled versions are generated and cached within the symbol as required.
+ * The scaled versions are generated when the path is set.
  *
  * @param type a Stitch::Type identifying the type of stitch.
  *
- * @return a scaled QPainterPath
+ * @return a const reference to a scaled QPainterPath
  */
-QPainterPath Symbol::path(Stitch::Type type)
+const QPainterPath &Symbol::path(Stitch::Type type) const
 {
-    if (!m_paths.contains(type)) {
-        double twoThirds = 2.0 / 3.0;
-        double oneThird = 1.0 / 3.0;
-        QTransform transform;
-
-        switch (type) {
-        case Stitch::Full:
-            // nothing else to do
-            break;
-
-        case Stitch::TLQtr:
-        case Stitch::TLSmallHalf:
-        case Stitch::TLSmallFull:
-            transform = QTransform::fromScale(0.5, 0.5);
-            break;
+    static const QPainterPath empty;
 
-        case Stitch::TRQtr:
-        case Stitch::TRSmallHalf:
-        case Stitch::TRSmallFull:
-            transform = QTransform::fromScale(0.5, 0.5) * QTransform::fromTranslate(0.5, 0.0);
-            break;
-
-        case Stitch::BLQtr:
-        case Stitch::BLSmallHalf:
-        case Stitch::BLSmallFull:
-            transform = QTransform::fromScale(0.5, 0.5) * QTransform::fromTranslate(0.0, 0.5);
-            break;
-
-        case Stitch::BRQtr:
-        case Stitch::BRSmallHalf:
-        case Stitch::BRSmallFull:
-            transform = QTransform::fromScale(0.5, 0.5) * QTransform::fromTranslate(0.5, 0.5);
-            break;
-
-        case Stitch::TBHalf:
-        case Stitch::BTHalf:
-        case Stitch::FrenchKnot:
-            transform = QTransform::fromScale(twoThirds, twoThirds) * QTransform::fromTranslate(oneThird / 2.0, oneThird / 2.0);
-            break;
-
-        case Stitch::TL3Qtr:
-            transform = QTransform::fromScale(twoThirds, twoThirds);
-            break;
-
-        case Stitch::TR3Qtr:
-            transform = QTransform::fromScale(twoThirds, twoThirds) * QTransform::fromTranslate(oneThird, 0.0);
-            break;
-
-        case Stitch::BL3Qtr:
-            transform = QTransform::fromScale(twoThirds, twoThirds) * QTransform::fromTranslate(0.0, oneThird);
-            break;
+    return m_paths.isEmpty() ? empty : m_paths.at(slot(type));
+}
 
-        case Stitch::BR3Qtr:
-            transform = QTransform::fromScale(twoThirds, twoThirds) * QTransform::fromTranslate(oneThird, oneThird);
-            break;
 
-        case Stitch::Delete:
-            break;
-        }
-
-        m_paths.insert(type, transform.map(m_paths.value(Stitch::Full)));
+/**
+ * Get the index in m_paths of the path for a stitch type.
+ *
+ * @param type a Stitch::Type identifying the type of stitch.
+ *
+ * @return an index in m_paths
+ */
+int Symbol::slot(Stitch::Type type)
+{
+    switch (type) {
+    case Stitch::Delete:        return 0;
+    case Stitch::TLQtr:         return 1;
+    case Stitch::TRQtr:         return 2;
+    case Stitch::BLQtr:         return 3;
+    case Stitch::BTHalf:        return 4;
+    case Stitch::TL3Qtr:        return 5;
+    case Stitch::BRQtr:         return 6;
+    case Stitch::TBHalf:        return 7;
+    case Stitch::TR3Qtr:        return 8;
+    case Stitch::BL3Qtr:        return 9;
+    case Stitch::BR3Qtr:        return 10;
+    case Stitch::Full:          return 11;
+    case Stitch::TLSmallHalf:   return 12;
+    case Stitch::TRSmallHalf:   return 13;
+    case Stitch::BLSmallHalf:   return 14;
+    case Stitch::BRSmallHalf:   return 15;
+    case Stitch::TLSmallFull:   return 16;
+    case Stitch::TRSmallFull:   return 17;
+    case Stitch::BLSmallFull:   return 18;
+    case Stitch::BRSmallFull:   return 19;
+    case Stitch::FrenchKnot:    return 20;
     }
 
-    return m_paths.value(type);
+    return 0;
 }
 
 
@@ -183,14 +159,86 @@ Qt::PenJoinStyle Symbol::joinStyle() const
 
 
 /**
- * Set the QPainterPath for the symbol.
+ * Set the QPainterPath for the symbol, generating the scaled versions for each of the
+ * stitch types.
  *
  * @param path a const reference to a QPainterPath
  */
 void Symbol::setPath(const QPainterPath &path)
 {
-    m_paths.clear();
-    m_paths.insert(Stitch::Full, path);
+    static const Stitch::Type types[] = {
+        Stitch::Delete, Stitch::TLQtr, Stitch::TRQtr, Stitch::BLQtr, Stitch::BTHalf, Stitch::TL3Qtr, Stitch::BRQtr,
+        Stitch::TBHalf, Stitch::TR3Qtr, Stitch::BL3Qtr, Stitch::BR3Qtr, Stitch::Full, Stitch::TLSmallHalf,
+        Stitch::TRSmallHalf, Stitch::BLSmallHalf, Stitch::BRSmallHalf, Stitch::TLSmallFull, Stitch::TRSmallFull,
+        Stitch::BLSmallFull, Stitch::BRSmallFull, Stitch::FrenchKnot
+    };
+
+    double twoThirds = 2.0 / 3.0;
+    double oneThird = 1.0 / 3.0;
+
+    m_paths.resize(sizeof(types) / sizeof(types[0]));
+
+    for (Stitch::Type type : types) {
+        QTransform transform;
+
+        switch (type) {
+        case Stitch::Full:
+            // nothing else to do
+            break;
+
+        case Stitch::TLQtr:
+        case Stitch::TLSmallHalf:
+        case Stitch::TLSmallFull:
+            transform = QTransform::fromScale(0.5, 0.5);
+            break;
+
+        case Stitch::TRQtr:
+        case Stitch::TRSmallHalf:
+        case Stitch::TRSmallFull:
+            transform = QTransform::fromScale(0.5, 0.5) * QTransform::fromTranslate(0.5, 0.0);
+            break;
+
+        case Stitch::BLQtr:
+        case Stitch::BLSmallHalf:
+        case Stitch::BLSmallFull:
+            transform = QTransform::fromScale(0.5, 0.5) * QTransform::fromTranslate(0.0, 0.5);
+            break;
+
+        case Stitch::BRQtr:
+        case Stitch::BRSmallHalf:
+        case Stitch::BRSmallFull:
+            transform = QTransform::fromScale(0.5, 0.5) * QTransform::fromTranslate(0.5, 0.5);
+            break;
+
+        case Stitch::TBHalf:
+        case Stitch::BTHalf:
+        case Stitch::FrenchKnot:
+            transform = QTransform::fromScale(twoThirds, twoThirds) * QTransform::fromTranslate(oneThird / 2.0, oneThird / 2.0);
+            break;
+
+        case Stitch::TL3Qtr:
+            transform = QTransform::fromScale(twoThirds, twoThirds);
+            break;
+
+        case Stitch::TR3Qtr:
+            transform = QTransform::fromScale(twoThirds, twoThirds) * QTransform::fromTranslate(oneThird, 0.0);
+            break;
+
+        case Stitch::BL3Qtr:
+            transform = QTransform::fromScale(twoThirds, twoThirds) * QTransform::fromTranslate(0.0, oneThird);
+            break;
+
+        case Stitch::BR3Qtr:
+            transform = QTransform::fromScale(twoThirds, twoThirds) * QTransform::fromTranslate(oneThird, oneThird);
+            break;
+
+        case Stitch::Delete:
+            break;
+        }
+
+        // the identity transform shares the original path
+        m_paths[slot(type)] = transform.isIdentity() ? path : transform.map(path);
+    }
 }
 
 
@@ -280,7 +328,7 @@ QBrush Symbol::brush() const
  */
 QDataStream &operator<<(QDataStream &stream, const Symbol &symbol)
 {
-    stream << symbol.version << symbol.m_paths.value(Stitch::Full) << symbol.m_filled << symbol.m_lineWidth << static_cast<qint32>(symbol.m_capStyle) << static_cast<qint32>(symbol.m_joinStyle);
+    stream << symbol.version << symbol.path() << symbol.m_filled << symbol.m_lineWidth << static_cast<qint32>(symbol.m_capStyle) << static_cast<qint32>(symbol.m_joinStyle);
 
     if (stream.status() != QDataStream::Ok) {
         throw FailedWriteFile(stream.status());
@@ -311,7 +359,7 @@ QDataStream &operator>>(QDataStream &stream, Symbol &symbol)
         stream >> path >> symbol.m_filled >> symbol.m_lineWidth >> capStyle >> joinStyle;
         symbol.m_capStyle = static_cast<Qt::PenCapStyle>(capStyle);
         symbol.m_joinStyle = static_cast<Qt::PenJoinStyle>(joinStyle);
-        symbol.m_paths.insert(Stitch::Full, path);
+        symbol.setPath(path);
         break;
 
     default:
@@ -19,8 +19,8 @@
 #define Symbol_H
 
 
-#include <QMap>
 #include <QPainterPath>
+#include <QVector>
 
 #include "Stitch.h"
 
@@ -32,14 +32,18 @@
  * it should be drawn. Originally the path was drawn filled, the implementation of this
  * Symbol class allows a fill attribute and a pen width attribute for outline paths. In
  * addition the line end style and line join style can be changed.
+ *
+ * The paths for each of the stitch types are generated when the path is set, so a const
+ * Symbol, or a copy of one, does not need to generate them again. The paths are implicitly
+ * shared so copying a Symbol does not copy them.
  */
 class Symbol
 {
 public:
     Symbol();
 
-    QPainterPath path(Stitch::Type type);
-    QPainterPath path() const;
+    const QPainterPath &path(Stitch::Type type) const;
+    const QPainterPath &path() const;
     bool filled() const;
     qreal lineWidth() const;
     Qt::PenCapStyle capStyle() const;
@@ -58,9 +62,11 @@ public:
     friend QDataStream &operator>>(QDataStream &stream, Symbol &symbol);
 
 private:
+    static int slot(Stitch::Type type);
+
     static const qint32 version = 100;              /**< version of the stream object */
 
-    QMap<Stitch::Type, QPainterPath>    m_paths;    /**< the symbols paths, cached by type, incorporates fill method if m_filled is true */
+    QVector<QPainterPath>   m_paths;                /**< the symbols paths for each stitch type indexed by slot(), empty if no path has been set */
 
     bool                m_filled;                   /**< true if the path is filled, false if an outline path */
     qreal               m_lineWidth;                /**< width of the pen, this is scaled with the painter */
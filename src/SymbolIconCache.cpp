@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2010-2022 by Stephen Allewell
+ * steve.allewell@gmail.com
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+
+/** @file
+ * This file implements the cache of the icons shown for symbols.
+ */
+
+
+#include "SymbolIconCache.h"
+
+#include <QBrush>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QPainter>
+#include <QPen>
+
+#include "Symbol.h"
+
+
+// the size of the icons kept in memory in kB
+static const int memoryCost = 16384;
+
+
+SymbolIconCache *SymbolIconCache::symbolIconCache = nullptr;
+
+
+SymbolIconCache &SymbolIconCache::self()
+{
+    if (symbolIconCache == nullptr) {
+        symbolIconCache = new SymbolIconCache();
+    }
+
+    return *symbolIconCache;
+}
+
+
+SymbolIconCache::SymbolIconCache()
+    :   QObject(),
+        m_icons(memoryCost)
+{
+    connect(&m_icons, &AsyncPixmapCache::pixmapReady, this, &SymbolIconCache::iconReady);
+}
+
+
+QByteArray SymbolIconCache::hash(const Symbol &symbol)
+{
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream << symbol;
+
+    return QCryptographicHash::hash(data, QCryptographicHash::Sha1);
+}
+
+
+QPixmap SymbolIconCache::icon(const Symbol &symbol, const QByteArray &hash, int size, const QColor &color)
+{
+    QString iconKey = QStringLiteral("%1/%2/%3").arg(QString::fromLatin1(hash.toHex())).arg(size).arg(color.rgba(), 8, 16, QLatin1Char('0'));
+
+    return m_icons.pixmap(iconKey, [symbol, size, color]() {
+        return render(symbol, size, color);
+    });
+}
+
+
+// painting on a QImage is safe on a worker thread, the symbol paths are implicitly shared and not modified
+QImage SymbolIconCache::render(const Symbol &symbol, int size, const QColor &color)
+{
+    QImage icon(size, size, QImage::Format_ARGB32_Premultiplied);
+    icon.fill(Qt::transparent);
+
+    QPainter painter(&icon);
+    painter.setRenderHint(QPainter::Antialiasing, true);
+    painter.setWindow(0, 0, 1, 1);
+
+    QBrush brush = symbol.brush();
+    QPen pen = symbol.pen();
+
+    brush.setColor(color);
+    pen.setColor(color);
+
+    painter.setBrush(brush);
+    painter.setPen(pen);
+    painter.drawPath(symbol.path());
+    painter.end();
+
+    return icon;
+}
@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2010-2022 by Stephen Allewell
+ * steve.allewell@gmail.com
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+
+/** @file
+ * This file defines the cache of the icons shown for symbols.
+ */
+
+
+#ifndef SymbolIconCache_H
+#define SymbolIconCache_H
+
+
+#include <QByteArray>
+#include <QColor>
+#include <QImage>
+#include <QObject>
+#include <QPixmap>
+#include <QString>
+
+#include "AsyncPixmapCache.h"
+
+
+class Symbol;
+
+
+/**
+ * Provides the icons of symbols for the symbol list widgets without painting
+ * them on the user interface thread.
+ *
+ * Icons are identified by a hash of the symbol, the size and the color they
+ * are painted in, so the icons are shared by all the symbol list widgets and
+ * a library that is shown again, or a symbol that is in more than one library,
+ * is not painted again. The most recently used icons are kept in memory.
+ *
+ * An icon that is not in memory is painted into a QImage on the global thread
+ * pool by an AsyncPixmapCache and iconReady() is emitted when it is available, so a list of symbols
+ * is shown at once and its icons fill in as they are painted.
+ *
+ * The cache is a singleton accessible via self().
+ */
+class SymbolIconCache : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * Get the cache.
+     *
+     * @return a reference to the SymbolIconCache
+     */
+    static SymbolIconCache &self();
+
+    /**
+     * Get the hash identifying a symbol.
+     *
+     * @param symbol is a const reference to the Symbol
+     *
+     * @return a QByteArray of the hash
+     */
+    static QByteArray hash(const Symbol &symbol);
+
+    /**
+     * Get the icon of a symbol. If it is not in memory, it is painted in the
+     * background and a null QPixmap is returned.
+     *
+     * @param symbol is a const reference to the Symbol
+     * @param hash is the hash of the symbol from hash()
+     * @param size is the width and height of the icon in pixels
+     * @param color is the color to paint the symbol in
+     *
+     * @return a QPixmap of the icon
+     */
+    QPixmap icon(const Symbol &symbol, const QByteArray &hash, int size, const QColor &color);
+
+    /**
+     * Paint the icon of a symbol, this may be called on any thread.
+     *
+     * @param symbol is a const reference to the Symbol
+     * @param size is the width and height of the icon in pixels
+     * @param color is the color to paint the symbol in
+     *
+     * @return a QImage of the icon
+     */
+    static QImage render(const Symbol &symbol, int size, const QColor &color);
+
+signals:
+    /**
+     * Emitted when an icon painted in the background is available.
+     */
+    void iconReady();
+
+private:
+    SymbolIconCache();
+
+    static SymbolIconCache  *symbolIconCache;
+
+    AsyncPixmapCache    m_icons;
+};
+
+
+#endif // SymbolIconCache_H
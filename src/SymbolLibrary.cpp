@@ -48,6 +48,7 @@
 #include "SymbolLibrary.h"
 
 #include <QDataStream>
+#include <QMap>
 #include <QListWidget>
 #include <QListWidgetItem>
 #include <QPainter>
@@ -97,6 +98,7 @@ void SymbolLibrary::clear()
     }
 
     m_symbols.clear();
+    m_indexes.clear();
     m_nextIndex = 1;
     m_url = QUrl(i18n("Untitled"));
 }
@@ -108,11 +110,13 @@ void SymbolLibrary::clear()
  *
  * @param index a qint16 representing the index to find
  *
- * @return a Symbol
+ * @return a const reference to a Symbol, this is valid until the library is changed
  */
-Symbol SymbolLibrary::symbol(qint16 index) const
+const Symbol &SymbolLibrary::symbol(qint16 index) const
 {
-    return (m_symbols.contains(index) ? m_symbols.value(index) : Symbol());
+    static const Symbol empty;
+
+    return ((index >= 0) && (index < m_symbols.count())) ? m_symbols.at(index) : empty;
 }
 
 
@@ -129,9 +133,12 @@ Symbol SymbolLibrary::symbol(qint16 index) const
 Symbol SymbolLibrary::takeSymbol(qint16 index)
 {
     Symbol symbol;
+    QList<qint16>::iterator i = std::lower_bound(m_indexes.begin(), m_indexes.end(), index);
 
-    if (m_symbols.contains(index)) {
-        symbol = m_symbols.take(index);
+    if ((i != m_indexes.end()) && (*i == index)) {
+        m_indexes.erase(i);
+        symbol = m_symbols.at(index);
+        m_symbols[index] = Symbol();
 
         if (m_listWidget) {
             m_listWidget->removeSymbol(index);
@@ -160,7 +167,20 @@ qint16 SymbolLibrary::setSymbol(qint16 index, const Symbol &symbol)
         index = m_nextIndex++;
     }
 
-    m_symbols.insert(index, symbol);
+    if (index < 0) {
+        return index;
+    }
+
+    if (index >= m_symbols.count()) {
+        m_symbols.resize(index + 1);
+    }
+
+    m_symbols[index] = symbol;
+    QList<qint16>::iterator i = std::lower_bound(m_indexes.begin(), m_indexes.end(), index);
+
+    if ((i == m_indexes.end()) || (*i != index)) {
+        m_indexes.insert(i, index);
+    }
 
     if (m_listWidget) {
         m_listWidget->addSymbol(index, symbol);
@@ -220,9 +240,7 @@ void SymbolLibrary::setName(const QString &name)
  */
 QList<qint16> SymbolLibrary::indexes() const
 {
-    QList<qint16> keys = m_symbols.keys();
-    std::sort(keys.begin(), keys.end());
-    return keys;
+    return m_indexes;
 }
 
 
@@ -241,8 +259,7 @@ QUndoStack *SymbolLibrary::undoStack()
  * Generate all the items in the library.
  * This will be called when a library file is loaded to generate all the new
  * QListWidgetItems for the symbols in the library and generate an icon for it.
- * A list of sorted QMap keys is retrieved to allow adding items in the correct
- * order.
+ * The sorted list of indexes allows adding items in the correct order.
  */
 void SymbolLibrary::generateItems()
 {
@@ -250,8 +267,8 @@ void SymbolLibrary::generateItems()
         return;
     }
 
-    foreach (qint16 index, indexes()) {
-        m_listWidget->addSymbol(index, m_symbols[index]);
+    foreach (qint16 index, m_indexes) {
+        m_listWidget->addSymbol(index, m_symbols.at(index));
     }
 }
 
@@ -278,7 +295,14 @@ QDataStream &operator<<(QDataStream &stream, const SymbolLibrary &library)
         throw FailedWriteFile(stream.status());
     }
 
-    stream << library.m_symbols;
+    // the file holds a map of the symbols by index
+    QMap<qint16, Symbol> symbols;
+
+    foreach (qint16 index, library.m_indexes) {
+        symbols.insert(index, library.m_symbols.at(index));
+    }
+
+    stream << symbols;
     return stream;
 }
 
@@ -310,6 +334,7 @@ QDataStream &operator>>(QDataStream &stream, SymbolLibrary &library)
         qint32 version;
         QMap<qint16, QPainterPath> paths_v100;
         QList<qint16> paths_v100_keys;
+        QMap<qint16, Symbol> symbols;
         stream >> version;
 
         switch (version) {
@@ -320,7 +345,18 @@ QDataStream &operator>>(QDataStream &stream, SymbolLibrary &library)
                 throw FailedReadFile(QString(i18n("Stream error")));
             }
 
-            stream >> library.m_symbols;
+            stream >> symbols;
+
+            // the list widget is updated once all the symbols have been read
+            library.m_symbols.resize(symbols.isEmpty() ? 0 : std::max(0, symbols.lastKey() + 1));
+
+            for (QMap<qint16, Symbol>::const_iterator i = symbols.constBegin() ; i != symbols.constEnd() ; ++i) {
+                if (i.key() >= 0) {
+                    library.m_symbols[i.key()] = i.value();
+                    library.m_indexes.append(i.key());
+                }
+            }
+
             library.generateItems();
             break;
 
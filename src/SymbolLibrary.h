@@ -19,10 +19,11 @@
 #define SymbolLibrary_H
 
 
-#include <QMap>
+#include <QList>
 #include <QPainterPath>
 #include <QUndoStack>
 #include <QUrl>
+#include <QVector>
 
 #include "Symbol.h"
 
@@ -41,6 +42,9 @@ class SymbolListWidget;
  * When a SymbolListWidget is assigned to the SymbolLibrary each of the symbols is added to
  * the SymbolListWidget which will create a QListWidgetItem which is assigned the QIcon that
  * is generated from the QPainterPath associated with the index.
+ *
+ * The symbols are held in an array indexed by their index, so the renderer can look up the
+ * symbol of each stitch without searching and without copying it.
  */
 class SymbolLibrary
 {
@@ -50,7 +54,7 @@ public:
 
     void clear();
 
-    Symbol symbol(qint16 index) const;
+    const Symbol &symbol(qint16 index) const;
     Symbol takeSymbol(qint16 index);
     qint16 setSymbol(qint16 index, const Symbol &symbol);
 
@@ -81,7 +85,8 @@ private:
     SymbolListWidget *m_listWidget;         /**< pointer to a QListWidget containing the QListWidgetItems for the QIcons, this may be null for an imported file */
 
     qint16                  m_nextIndex;    /**< index for the next symbol added */
-    QMap<qint16, Symbol>    m_symbols;      /**< map of the Symbol to indexes */
+    QVector<Symbol>         m_symbols;      /**< the Symbol for each index, a default constructed Symbol where an index is not used */
+    QList<qint16>           m_indexes;      /**< sorted list of the indexes used */
 };
 
 
@@ -20,7 +20,7 @@
  * This class implements an extension to the QListWidget class that provides population of the widget
  * with the contents of a SymbolLibrary. For each Symbol in the library a QListWidgetItem is created
  * with a data item representing the Symbol identifier in the library and an icon at a given size that
- * is generated from the Symbol path.
+ * is generated from the Symbol path in the background when the item is first displayed.
  *
  * The widget is intended to be used in a dialog or main window and allows selection of a symbol to be
  * used for some purpose in the application.
@@ -32,19 +32,74 @@
 #include "SymbolListWidget.h"
 
 #include <QApplication>
-#include <QPainter>
 #include <QPalette>
-#include <QPen>
 
 #include <KLocalizedString>
 
 #include "Stitch.h"
 #include "Symbol.h"
+#include "SymbolIconCache.h"
 #include "SymbolLibrary.h"
 
 
+/**
+ * A QListWidgetItem holding a Symbol, the icon is requested from the SymbolIconCache the first
+ * time the view asks for it at the icon size of the view, so a library with many symbols does
+ * not create icons for items that are never shown. Until the icon has been painted in the
+ * background the item is shown without one.
+ */
+class SymbolListWidgetItem : public QListWidgetItem
+{
+public:
+    explicit SymbolListWidgetItem(qint16 index)
+    {
+        setData(Qt::UserRole, index);
+    }
+
+    void setSymbol(const Symbol &symbol)
+    {
+        m_symbol = symbol;
+        m_hash.clear();
+        clearIcon();
+    }
+
+    void clearIcon()
+    {
+        m_icon = QIcon();
+        emitDataChanged();
+    }
+
+    virtual QVariant data(int role) const Q_DECL_OVERRIDE
+    {
+        if (role == Qt::DecorationRole) {
+            if (m_icon.isNull() && listWidget()) {
+                if (m_hash.isEmpty()) {
+                    m_hash = SymbolIconCache::hash(m_symbol);
+                }
+
+                QPixmap pixmap = SymbolIconCache::self().icon(m_symbol, m_hash, listWidget()->iconSize().width(), QApplication::palette().color(QPalette::WindowText));
+
+                if (!pixmap.isNull()) {
+                    m_icon = QIcon(pixmap);
+                }
+            }
+
+            return m_icon;
+        }
+
+        return QListWidgetItem::data(role);
+    }
+
+private:
+    Symbol              m_symbol;
+    mutable QByteArray  m_hash;
+    mutable QIcon       m_icon;
+};
+
+
 /**
  * Constructor.
+ * The items have the same size so the view does not need the icon of every item to lay them out.
  */
 SymbolListWidget::SymbolListWidget(QWidget *parent)
     :   QListWidget(parent),
@@ -53,13 +108,17 @@ SymbolListWidget::SymbolListWidget(QWidget *parent)
 {
     setResizeMode(QListView::Adjust);
     setViewMode(QListView::IconMode);
+    setUniformItemSizes(true);
     setIconSize(24);
+
+    connect(&SymbolIconCache::self(), &SymbolIconCache::iconReady, viewport(), static_cast<void (QWidget::*)()>(&QWidget::update));
 }
 
 
 /**
  * Set the size of the icons to be used.
  * The base QListWidget has the icon size and grid size set to this value.
+ * Icons already generated at another size are discarded.
  *
  * @param size the size in pixels
  */
@@ -68,12 +127,13 @@ void SymbolListWidget::setIconSize(int size)
     m_size = size;
     QListWidget::setIconSize(QSize(m_size, m_size));
     setGridSize(QSize(m_size, m_size));
+    updateIcons();
 }
 
 
 /**
  * Populate the QListWidget with the QListWidgetItems for each Symbol in the SymbolLibrary.
- * An icon is created for each Symbol.
+ * The icons are created when the items are displayed.
  *
  * @param library a pointer to the SymbolLibrary containing the Symbols
  */
@@ -93,7 +153,7 @@ void SymbolListWidget::loadFromLibrary(SymbolLibrary *library)
 
 
 /**
- * Add an individual Symbol to the view.
+ * Add an individual Symbol to the view, replacing the Symbol of an existing item for the index.
  *
  * @param index the index of the Symbol
  * @param symbol a const reference to the Symbol to add
@@ -102,7 +162,7 @@ void SymbolListWidget::loadFromLibrary(SymbolLibrary *library)
 QListWidgetItem *SymbolListWidget::addSymbol(qint16 index, const Symbol &symbol)
 {
     QListWidgetItem *item = createItem(index);
-    item->setIcon(createIcon(symbol, m_size));
+    static_cast<SymbolListWidgetItem *>(item)->setSymbol(symbol);
 
     return item;
 }
@@ -166,7 +226,7 @@ void SymbolListWidget::setCurrent(qint16 index)
 /**
  * If an item for the index currently exists return it otherwise create
  * an item to be inserted into the QListWidget.
- * The item created has a data entry added representing the index.
+ * The item created is a SymbolListWidgetItem with a data entry added representing the index.
  * The items are inserted so that the Symbols are sorted by their index.
  *
  * @param index an index in the SymbolLibrary
@@ -179,8 +239,7 @@ QListWidgetItem *SymbolListWidget::createItem(qint16 index)
         return m_items.value(index);
     }
 
-    QListWidgetItem *item = new QListWidgetItem;
-    item->setData(Qt::UserRole, index);
+    QListWidgetItem *item = new SymbolListWidgetItem(index);
     m_items.insert(index, item);
     int i = index;
 
@@ -211,27 +270,7 @@ QListWidgetItem *SymbolListWidget::createItem(qint16 index)
  */
 QIcon SymbolListWidget::createIcon(const Symbol &symbol, int size)
 {
-    QPalette pal = QApplication::palette();
-
-    QPixmap icon(size, size);
-    icon.fill(Qt::transparent);
-
-    QPainter painter(&icon);
-    painter.setRenderHint(QPainter::Antialiasing, true);
-    painter.setWindow(0, 0, 1, 1);
-
-    QBrush brush = symbol.brush();
-    QPen pen = symbol.pen();
-
-    brush.setColor(pal.color(QPalette::WindowText));
-    pen.setColor(pal.color(QPalette::WindowText));
-
-    painter.setBrush(brush);
-    painter.setPen(pen);
-    painter.drawPath(symbol.path());
-    painter.end();
-
-    return QIcon(icon);
+    return QIcon(QPixmap::fromImage(SymbolIconCache::render(symbol, size, QApplication::palette().color(QPalette::WindowText))));
 }
 
 
@@ -256,15 +295,13 @@ bool SymbolListWidget::event(QEvent *e)
 
 
 /**
- * Generate the icons for all the QListWidgetItems stored in m_items.
+ * Discard the icons for all the QListWidgetItems stored in m_items, they are generated
+ * again when they are next displayed.
  */
 void SymbolListWidget::updateIcons()
 {
-    QMapIterator<qint16, QListWidgetItem *> i(m_items);
-
-    while (i.hasNext()) {
-        i.next();
-        i.value()->setIcon(createIcon(m_library->symbol(i.key()), m_size));
+    foreach (QListWidgetItem *item, m_items) {
+        static_cast<SymbolListWidgetItem *>(item)->clearIcon();
     }
 }
 
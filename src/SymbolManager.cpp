@@ -11,8 +11,8 @@
 
 /**
  * @file
- * Implement the SymbolManager class. This loads all symbol libraries from the kxstitch application
- * data folders and allows the selection of a library by name. The manager is implemented as a
+ * Implement the SymbolManager class. This finds the symbol libraries in the kxstitch application
+ * data folders and allows the selection of a library by name, reading it when it is first selected. The manager is implemented as a
  * singleton class accessible from anywhere in the application. Symbols need to be available to the
  * palette manager and from the renderer.
  */
@@ -28,11 +28,16 @@
 
 #include "SymbolManager.h"
 
+#include <QCoreApplication>
 #include <QDir>
 #include <QDirIterator>
 #include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
 #include <QStandardPaths>
+#include <QThread>
 #include <QUrl>
+#include <QtDebug>
 
 #include <KLocalizedString>
 #include <KMessageBox>
@@ -46,10 +51,13 @@ SymbolManager *SymbolManager::symbolManager = nullptr;
 
 
 /**
- * Accessor for the static object
+ * Accessor for the static object, this may be first used on a worker thread.
  */
 SymbolManager &SymbolManager::self()
 {
+    static QMutex mutex;
+    QMutexLocker locker(&mutex);
+
     if (symbolManager == nullptr) {
         symbolManager = new SymbolManager();
     }
@@ -68,27 +76,28 @@ SymbolManager::SymbolManager()
 
 
 /**
- *Destructor. Delete all the symbol libraries.
+ *Destructor. Delete all the symbol libraries that have been read.
  */
 SymbolManager::~SymbolManager()
 {
-    qDeleteAll(m_symbolLibraries);
+    foreach (const SymbolFile &symbolFile, m_symbolFiles) {
+        delete symbolFile.symbolLibrary;
+    }
 }
 
 
 /**
- * Get a list of the symbol libraries available.
+ * Get a list of the symbol libraries available, this does not read the libraries.
  *
  * @return QStringList of symbol library names.
  */
 QStringList SymbolManager::libraries()
 {
     QStringList libraryNames;
+    QMutexLocker locker(&self().m_mutex);
 
-    QListIterator<SymbolLibrary *> i(self().m_symbolLibraries);
-
-    while (i.hasNext()) {
-        libraryNames.append(i.next()->name());
+    foreach (const SymbolFile &symbolFile, self().m_symbolFiles) {
+        libraryNames.append(symbolFile.name);
     }
 
     return libraryNames;
@@ -96,29 +105,50 @@ QStringList SymbolManager::libraries()
 
 
 /**
- * Get a pointer to a symbol library by name
+ * Get a pointer to a symbol library by name, reading it if this is the first time it has been used.
  *
  * @param name of the library required.
  *
- * @return pointer to the SymbolLibrary instance, returns null if no library found.
+ * @return pointer to the SymbolLibrary instance, returns null if no library found or it could not be read.
  */
 SymbolLibrary *SymbolManager::library(const QString &name)
 {
-    for (int i = 0 ; i < self().m_symbolLibraries.count() ; ++i) {
-        SymbolLibrary *symbolLibrary = self().m_symbolLibraries.at(i);
+    SymbolManager &symbolManager = self();
+    SymbolLibrary *symbolLibrary = nullptr;
+    QString error;
+
+    {
+        QMutexLocker locker(&symbolManager.m_mutex);
+        int i = symbolManager.m_symbolIndexes.value(name, -1);
+
+        if (i != -1) {
+            SymbolFile &symbolFile = symbolManager.m_symbolFiles[i];
+
+            if ((symbolFile.symbolLibrary == nullptr) && !symbolFile.failed) {
+                symbolFile.symbolLibrary = readLibrary(symbolFile.path, error);
+                symbolFile.failed = (symbolFile.symbolLibrary == nullptr);
+            }
+
+            symbolLibrary = symbolFile.symbolLibrary;
+        }
+    }
 
-        if (symbolLibrary->name() == name) {
-            return symbolLibrary;
+    // the message box runs an event loop that may use the libraries, so it is shown when the mutex is released
+    if (!error.isEmpty()) {
+        if (QCoreApplication::instance() && (QThread::currentThread() == QCoreApplication::instance()->thread())) {
+            KMessageBox::error(nullptr, error);
+        } else {
+            qWarning() << error;
         }
     }
 
-    return nullptr;
+    return symbolLibrary;
 }
 
 
 /**
- * Get a list of files stored in the symbols path, iterating each one to create a new SymbolLibrary instance
- * and read the library.
+ * Get a list of files stored in the symbols path, the libraries are named by the base name of the file and
+ * are read when they are first used.
  * Assumes that local resources are given before global ones and should take priority.
  */
 void SymbolManager::refresh()
@@ -129,24 +159,28 @@ void SymbolManager::refresh()
         QDirIterator it(dir, QStringList() << QStringLiteral("*.sym"));
 
         while (it.hasNext()) {
-            SymbolLibrary *symbolLibrary = readLibrary(it.next());
+            QString path = it.next();
+            QString name = QFileInfo(path).baseName();
 
-            if (symbolLibrary) {
-                m_symbolLibraries.append(symbolLibrary);
+            if (!m_symbolIndexes.contains(name)) {
+                m_symbolIndexes.insert(name, m_symbolFiles.count());
             }
+
+            m_symbolFiles.append(SymbolFile{name, path, nullptr, false});
         }
     }
 }
 
 
 /**
- * Read a symbol library.
+ * Read a symbol library without reporting errors, this may be called on any thread.
  *
  * @param name path to the symbol file to be read.
+ * @param error a reference to a QString set to the error message if the library could not be read.
  *
- * @return pointer to the SymbolLibrary instance created.
+ * @return pointer to the SymbolLibrary instance created, null if it could not be read.
  */
-SymbolLibrary *SymbolManager::readLibrary(const QString &name)
+SymbolLibrary *SymbolManager::readLibrary(const QString &name, QString &error)
 {
     SymbolLibrary *symbolLibrary = new SymbolLibrary;
 
@@ -159,22 +193,22 @@ SymbolLibrary *SymbolManager::readLibrary(const QString &name)
             stream >> *symbolLibrary;
             symbolLibrary->setName(QFileInfo(name).baseName());
         } catch (const InvalidFile &e) {
-            KMessageBox::error(nullptr, i18n("This does not appear to be a valid symbol file"));
+            error = i18n("This does not appear to be a valid symbol file");
             delete symbolLibrary;
             symbolLibrary = nullptr;
         } catch (const InvalidFileVersion &e) {
-            KMessageBox::error(nullptr, e.version);
+            error = e.version;
             delete symbolLibrary;
             symbolLibrary = nullptr;
         } catch (const FailedReadFile &e) {
-            KMessageBox::error(nullptr, e.status);
+            error = e.status;
             delete symbolLibrary;
             symbolLibrary = nullptr;
         }
 
         file.close();
     } else {
-        KMessageBox::error(nullptr, i18n("Failed to open the file %1", name));
+        error = i18n("Failed to open the file %1", name);
         delete symbolLibrary;
         symbolLibrary = nullptr;
     }
@@ -19,7 +19,9 @@
 #define SymbolManager_H
 
 
+#include <QHash>
 #include <QList>
+#include <QMutex>
 #include <QStringList>
 
 
@@ -47,11 +49,23 @@ private:
     static SymbolManager &self();
     SymbolManager();
 
+    /**
+     * A symbol file found, the library is read when it is first used.
+     */
+    struct SymbolFile {
+        QString         name;                       /**< name of the library, the base name of the file */
+        QString         path;                       /**< path of the file */
+        SymbolLibrary   *symbolLibrary;             /**< pointer to the library, nullptr until it is first used */
+        bool            failed;                     /**< true if the library could not be read, so it is not tried again */
+    };
+
     void refresh();
-    SymbolLibrary *readLibrary(const QString &name);
+    static SymbolLibrary *readLibrary(const QString &name, QString &error);
 
     static SymbolManager    *symbolManager;         /**< pointer to the static symbol manager */
-    QList<SymbolLibrary *>  m_symbolLibraries;      /**< list of the symbol libraries loaded */
+    QList<SymbolFile>       m_symbolFiles;          /**< list of the symbol files found */
+    QHash<QString, int>     m_symbolIndexes;        /**< index in m_symbolFiles of the first library with each name */
+    QMutex                  m_mutex;                /**< guards reading the libraries, which may be first used on a worker thread */
 };
 
 
@@ -0,0 +1,177 @@
+/*
+ * Copyright (C) 2010-2022 by Stephen Allewell
+ * steve.allewell@gmail.com
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+
+/** @file
+ * This file implements the cache of the thumbnails shown for library patterns.
+ */
+
+
+#include "ThumbnailCache.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QPainter>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+#include "Exceptions.h"
+#include "LibraryFile.h"
+#include "LibraryPattern.h"
+#include "Pattern.h"
+#include "Renderer.h"
+#include "StitchData.h"
+
+#include "configuration.h"
+
+
+// the render modes of the thumbnails, these are part of the key so a change to them renders the thumbnails again
+static const Configuration::EnumRenderer_RenderStitchesAs::type stitchesAs = Configuration::EnumRenderer_RenderStitchesAs::Stitches;
+static const Configuration::EnumRenderer_RenderBackstitchesAs::type backstitchesAs = Configuration::EnumRenderer_RenderBackstitchesAs::ColorLines;
+static const Configuration::EnumRenderer_RenderKnotsAs::type knotsAs = Configuration::EnumRenderer_RenderKnotsAs::ColorBlocks;
+
+// the size of the thumbnails kept in memory in kB
+static const int memoryCost = 65536;
+
+// the version of the thumbnails written, version 1 drew v104 patterns without their stitches
+static const int thumbnailFormat = 2;
+
+
+ThumbnailCache::ThumbnailCache(QObject *parent)
+    :   QObject(parent),
+        m_size(256),
+        m_thumbnails(memoryCost)
+{
+    connect(&m_thumbnails, &AsyncPixmapCache::pixmapReady, this, &ThumbnailCache::thumbnailReady);
+}
+
+
+void ThumbnailCache::setSize(int size)
+{
+    m_size = 16;
+
+    while (m_size < size) {
+        m_size *= 2;
+    }
+}
+
+
+QPixmap ThumbnailCache::thumbnail(LibraryPattern *libraryPattern)
+{
+    // patterns are hashed when written to a library file, one that has not been is rendered directly
+    if (libraryPattern->hash().isEmpty()) {
+        return QPixmap::fromImage(render(libraryPattern->pattern(), m_size));
+    }
+
+    QString thumbnailKey = key(libraryPattern->hash());
+    QString thumbnailPath = path(thumbnailKey);
+    QString patternFile = libraryPattern->patternFile();
+    qint64 patternOffset = libraryPattern->patternOffset();
+    qint32 patternSize = libraryPattern->patternSize();
+    qint16 fileVersion = libraryPattern->fileVersion();
+    int size = m_size;
+
+    return m_thumbnails.pixmap(thumbnailKey, [patternFile, patternOffset, patternSize, fileVersion, size, thumbnailPath]() {
+        return generate(patternFile, patternOffset, patternSize, fileVersion, size, thumbnailPath);
+    });
+}
+
+
+// the format is changed when the way thumbnails are rendered changes, so thumbnails written before are not used
+QString ThumbnailCache::key(const QByteArray &hash) const
+{
+    return QStringLiteral("v%1/%2%3%4/%5/%6").arg(thumbnailFormat).arg(int(stitchesAs)).arg(int(backstitchesAs)).arg(int(knotsAs)).arg(m_size).arg(QString::fromLatin1(hash.toHex()));
+}
+
+
+QString ThumbnailCache::path(const QString &key) const
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + QLatin1String("/thumbnails/") + key + QLatin1String(".png");
+}
+
+
+// called on a worker thread, the encoded pattern is only read from the library file if the thumbnail has not been written
+QImage ThumbnailCache::generate(const QString &patternFile, qint64 patternOffset, qint32 patternSize, qint16 fileVersion, int size, const QString &path)
+{
+    QImage image;
+
+    if (QFile::exists(path)) {
+        // a file that cannot be read is removed so the thumbnail is rendered again next time
+        if (image.load(path, "PNG")) {
+            return image;
+        }
+
+        QFile::remove(path);
+    }
+
+    QByteArray data = LibraryFile::readPatternData(patternFile, patternOffset, patternSize);
+
+    if (data.isEmpty()) {
+        return image;
+    }
+
+    // a pattern that cannot be decoded has a null thumbnail
+    try {
+        Pattern *pattern = LibraryPattern::decode(data, fileVersion);
+        image = render(pattern, size);
+        delete pattern;
+    } catch (const FailedReadFile &e) {
+        qWarning() << e.status;
+    }
+
+    if (!image.isNull()) {
+        QDir().mkpath(QFileInfo(path).path());
+        QSaveFile file(path);
+
+        if (file.open(QIODevice::WriteOnly) && image.save(&file, "PNG")) {
+            file.commit();
+        }
+    }
+
+    return image;
+}
+
+
+// render the pattern scaled to fit the size, a QImage is used as it can be painted on a worker thread
+QImage ThumbnailCache::render(Pattern *pattern, int size)
+{
+    StitchData &stitches = pattern->stitches();
+
+    QSize imageSize = QSize(stitches.width(), stitches.height()).scaled(size, size, Qt::KeepAspectRatio);
+
+    if (imageSize.isEmpty()) {
+        return QImage();
+    }
+
+    QImage image(imageSize, QImage::Format_ARGB32_Premultiplied);
+    image.fill(Qt::white);
+
+    Renderer renderer;
+    renderer.setRenderStitchesAs(stitchesAs);
+    renderer.setRenderBackstitchesAs(backstitchesAs);
+    renderer.setRenderKnotsAs(knotsAs);
+
+    QPainter painter(&image);
+    painter.setRenderHint(QPainter::Antialiasing, true);
+    painter.setWindow(0, 0, stitches.width(), stitches.height());
+
+    renderer.render(&painter,
+                    pattern,
+                    painter.window(),
+                    true,       // render grid
+                    true,       // render stitches
+                    true,       // render backstitches
+                    true,       // render knots
+                    -1);        // no color mask
+
+    return image;
+}
@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2010-2022 by Stephen Allewell
+ * steve.allewell@gmail.com
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+
+/** @file
+ * This file defines the cache of the thumbnails shown for library patterns.
+ */
+
+
+#ifndef ThumbnailCache_H
+#define ThumbnailCache_H
+
+
+#include <QByteArray>
+#include <QImage>
+#include <QObject>
+#include <QPixmap>
+#include <QString>
+
+#include "AsyncPixmapCache.h"
+
+
+class LibraryPattern;
+class Pattern;
+
+
+/**
+ * Provides the thumbnails of library patterns for the icon view of the library
+ * manager without rendering them on the user interface thread.
+ *
+ * Thumbnails are identified by the hash of the encoded pattern in the library
+ * file, the size they are rendered at and the render modes used, so a pattern
+ * that has not changed is only rendered once for each size. Rendered
+ * thumbnails are written as PNG files to the cache directory and the most
+ * recently used are kept in memory as pixmaps.
+ *
+ * A thumbnail that is not in memory is read from the cache directory, or
+ * rendered if it has not been written, on the global thread pool by an
+ * AsyncPixmapCache and thumbnailReady() is emitted when it is available, so
+ * the icon view fills progressively as the thumbnails are generated.
+ *
+ * Thumbnails are rendered at the power of two not less than the icon size, so
+ * changing the icon size with the slider only renders the patterns again when
+ * the size passes one of these steps.
+ */
+class ThumbnailCache : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * Constructor.
+     *
+     * @param parent is a pointer to the parent QObject
+     */
+    explicit ThumbnailCache(QObject *parent = nullptr);
+
+    /**
+     * Destructor, thumbnails still being generated are discarded.
+     */
+    virtual ~ThumbnailCache() = default;
+
+    /**
+     * Set the size of the icons the thumbnails are shown at.
+     *
+     * @param size is the width and height of the icons in pixels
+     */
+    void setSize(int size);
+
+    /**
+     * Get the thumbnail of a library pattern. If it is not in memory, it is
+     * generated in the background and a null QPixmap is returned.
+     *
+     * @param libraryPattern is a pointer to the LibraryPattern
+     *
+     * @return a QPixmap of the thumbnail
+     */
+    QPixmap thumbnail(LibraryPattern *libraryPattern);
+
+signals:
+    /**
+     * Emitted when a thumbnail generated in the background is available.
+     */
+    void thumbnailReady();
+
+private:
+    QString key(const QByteArray &hash) const;
+    QString path(const QString &key) const;
+
+    static QImage generate(const QString &patternFile, qint64 patternOffset, qint32 patternSize, qint16 fileVersion, int size, const QString &path);
+    static QImage render(Pattern *pattern, int size);
+
+    int m_size;
+
+    AsyncPixmapCache    m_thumbnails;
+};
+
+
+#endif // ThumbnailCache_H